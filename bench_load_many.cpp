@@ -0,0 +1,51 @@
+// Compares loading a directory of small .npy shards one by one with npy_load against npy_load_many.
+//
+//   bench_load_many [files] [values per file] [threads]
+//
+// The shards are written to the current directory first and removed afterwards. Run it once to warm the page cache,
+// or drop the cache between runs to measure cold reads.
+#include "cnpy.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    size_t nfiles = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    size_t nvalues = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 256;
+    cnpy::LoadManyOptions options;
+    options.threads = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 0;
+
+    std::vector<float> data(nvalues);
+    for (size_t i = 0; i < nvalues; ++i) data[i] = static_cast<float>(i);
+    std::vector<std::string> paths;
+    for (size_t f = 0; f < nfiles; ++f) {
+        paths.push_back("bench_load_many_" + std::to_string(f) + ".npy");
+        cnpy::npy_save(paths.back(), data);
+    }
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    size_t serial_values = 0;
+    for (const std::string& path : paths) serial_values += cnpy::npy_load(path).num_vals;
+    double serial = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    size_t parallel_values = 0;
+    for (const cnpy::LoadResult& result : cnpy::npy_load_many(paths, options))
+        parallel_values += result.ok() ? result.array.num_vals : 0;
+    double parallel = std::chrono::duration<double>(clock::now() - start).count();
+
+    for (const std::string& path : paths) std::remove(path.c_str());
+    if (serial_values != parallel_values) {
+        std::cerr << "npy_load_many loaded " << parallel_values << " values, npy_load " << serial_values << std::endl;
+        return 1;
+    }
+    std::cout << nfiles << " files of " << nvalues << " floats" << std::endl;
+    std::cout << "npy_load loop:  " << serial << " s (" << nfiles / serial << " files/s)" << std::endl;
+    std::cout << "npy_load_many:  " << parallel << " s (" << nfiles / parallel << " files/s, " << serial / parallel
+              << "x)" << std::endl;
+    return 0;
+}
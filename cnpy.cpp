@@ -5,47 +5,114 @@
 
 #include "cnpy.h"
 #include "mmap_util.h"
+#include "npy_io.h"
+#include "npy_kernels.h"
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <complex>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <list>
+#include <mutex>
 #include <regex>
 #include <stdexcept>
+#include <climits>
 #include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
 
 char cnpy::BigEndianTest() {
     int x = 1;
     return (((char*)&x)[0]) ? '<' : '>';
 }
 
-char cnpy::map_type(const std::type_info& t) {
-    if (t == typeid(float)) return 'f';
-    if (t == typeid(double)) return 'f';
-    if (t == typeid(long double)) return 'f';
-
-    if (t == typeid(int)) return 'i';
-    if (t == typeid(char)) return 'i';
-    if (t == typeid(short)) return 'i';
-    if (t == typeid(long)) return 'i';
-    if (t == typeid(long long)) return 'i';
+// out-of-line definitions so that npy_type<T>::kind can be bound to a reference
+#define CNPY_NPY_TYPE_KIND(T, K) const char cnpy::npy_type<T>::kind;
+CNPY_FOR_EACH_TYPE(CNPY_NPY_TYPE_KIND)
+#undef CNPY_NPY_TYPE_KIND
+
+namespace {
+    struct TypeEntry {
+        const std::type_info* type;
+        cnpy::DType dtype;
+    };
+
+#define CNPY_TYPE_ENTRY(T, K) {&typeid(T), cnpy::DType::of<T>()},
+    const TypeEntry type_table[] = {CNPY_FOR_EACH_TYPE(CNPY_TYPE_ENTRY)};
+#undef CNPY_TYPE_ENTRY
+} // namespace
+
+cnpy::DType cnpy::dtype_of(const std::type_info& t) {
+    for (const TypeEntry& entry : type_table)
+        if (*entry.type == t) return entry.dtype;
+    return DType();
+}
 
-    if (t == typeid(unsigned char)) return 'u';
-    if (t == typeid(unsigned short)) return 'u';
-    if (t == typeid(unsigned long)) return 'u';
-    if (t == typeid(unsigned long long)) return 'u';
-    if (t == typeid(unsigned int)) return 'u';
+char cnpy::map_type(const std::type_info& t) { return dtype_of(t).kind; }
+
+cnpy::DType cnpy::DType::structured(const std::vector<Field>& fields, size_t itemsize) {
+    std::vector<Field> sorted(fields);
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Field& a, const Field& b) { return a.offset < b.offset; });
+    size_t end = 0;
+    for (const Field& f : sorted) {
+        if (f.name.empty()) throw std::runtime_error("DType::structured: fields must have a name");
+        if (f.offset < end) throw std::runtime_error("DType::structured: field " + f.name + " overlaps another field");
+        end = f.offset + f.num_bytes();
+    }
+    if (end > itemsize) throw std::runtime_error("DType::structured: fields do not fit in the record size");
+    DType dtype('V', itemsize, '|');
+    dtype.fields = std::make_shared<const std::vector<Field>>(std::move(sorted));
+    return dtype;
+}
 
-    if (t == typeid(bool)) return 'b';
+const cnpy::Field& cnpy::DType::field(const std::string& name) const {
+    if (!fields) throw std::runtime_error("DType: " + str() + " is not a structured dtype");
+    for (const Field& f : *fields)
+        if (f.name == name) return f;
+    throw std::runtime_error("DType: no field named " + name);
+}
 
-    if (t == typeid(std::complex<float>)) return 'c';
-    if (t == typeid(std::complex<double>)) return 'c';
-    if (t == typeid(std::complex<long double>))
-        return 'c';
+cnpy::DType cnpy::DType::native() const {
+    if (is_native()) return *this;
+    if (!fields) return DType(kind, size);
+    std::vector<Field> native_fields(*fields);
+    for (Field& f : native_fields) f.dtype = f.dtype.native();
+    return structured(native_fields, size);
+}
 
-    else
-        return '?';
+std::string cnpy::DType::descr() const {
+    if (!fields) return "'" + str() + "'";
+    // the list form lays fields out back to back, so gaps are written as unnamed void fields like numpy does
+    std::string out = "[";
+    size_t pos = 0;
+    for (const Field& f : *fields) {
+        if (f.offset > pos) out += "('', '|V" + std::to_string(f.offset - pos) + "'), ";
+        out += "('" + f.name + "', " + f.dtype.descr();
+        if (!f.shape.empty()) {
+            out += ", (";
+            for (size_t i = 0; i < f.shape.size(); ++i) out += (i > 0 ? ", " : "") + std::to_string(f.shape[i]);
+            if (f.shape.size() == 1) out += ",";
+            out += ")";
+        }
+        out += "), ";
+        pos = f.offset + f.num_bytes();
+    }
+    if (pos < size) out += "('', '|V" + std::to_string(size - pos) + "'), ";
+    if (out.size() > 1) out.resize(out.size() - 2);
+    return out + "]";
 }
 
 template <> std::vector<char>& cnpy::operator+=(std::vector<char>& lhs, const std::string rhs) {
@@ -63,67 +130,145 @@ template <> std::vector<char>& cnpy::operator+=(std::vector<char>& lhs, const ch
     return lhs;
 }
 
-void cnpy::parse_npy_header(unsigned char* buffer, size_t& word_size, Shape& shape, bool& fortran_order) {
-    std::string magic_string((const char*)buffer, 6);
-    uint8_t major_version = *reinterpret_cast<uint8_t*>(buffer + 6);
-    uint8_t minor_version = *reinterpret_cast<uint8_t*>(buffer + 7);
-    uint16_t header_len = *reinterpret_cast<uint16_t*>(buffer + 8);
-    std::string header(reinterpret_cast<char*>(buffer + 9), header_len);
+std::vector<char> cnpy::create_npy_header(const Shape& shape, const DType& dtype, bool fortran_order) {
+    std::vector<char> dict;
+    dict += "{'descr': ";
+    dict += dtype.descr();
+    dict += ", 'fortran_order': ";
+    dict += fortran_order ? "True" : "False";
+    dict += ", 'shape': (";
+    for (size_t i = 0; i < shape.size(); i++) {
+        if (i > 0) dict += ", ";
+        dict += std::to_string(shape[i]);
+    }
+    if (shape.size() == 1) dict += ",";
+    dict += "), }";
+    // pad with spaces so that preamble+dict is modulo 16 bytes. preamble is 10 bytes. dict needs to end with \n
+    int remainder = 16 - (10 + dict.size()) % 16;
+    dict.insert(dict.end(), remainder, ' ');
+    dict.back() = '\n';
+    if (dict.size() > 0xffff) throw std::runtime_error("create_npy_header: header too long for format version 1.0");
+
+    std::vector<char> header;
+    header += (char)0x93; // magic number
+    header += "NUMPY";    // magic string
+    header += (char)0x01; // major version of numpy format
+    header += (char)0x00; // minor version of numpy format
+    header += (uint16_t)dict.size();
+    header.insert(header.end(), dict.begin(), dict.end());
+
+    return header;
+}
 
-    size_t loc1, loc2;
+// a plain descr string such as "<f8" or "|u1"
+cnpy::DType parse_simple_descr(const std::string& descr) {
+    // byte order code | stands for not applicable (single bytes, strings), = for the writer's native order
+    char byte_order = descr.empty() ? 0 : descr[0];
+    if (byte_order != '<' && byte_order != '>' && byte_order != '|' && byte_order != '=')
+        throw std::runtime_error("parse_npy_header: unknown byte order in descr '" + descr + "'");
+    if (descr.size() < 3) throw std::runtime_error("parse_npy_header: bad descr '" + descr + "'");
+    size_t size = atoi(descr.c_str() + 2);
+    if (descr[1] == 'U') size *= 4; // counted in UCS-4 characters
+    return cnpy::DType(descr[1], size, byte_order == '=' ? cnpy::BigEndianTest() : byte_order);
+}
 
-    // fortran order
-    loc1 = header.find("fortran_order") + 16;
-    fortran_order = (header.substr(loc1, 4) == "True" ? true : false);
+// Reads the python literal after 'descr': in an .npy header: either a quoted plain descr or a list of
+// (name, descr[, shape]) tuples for a structured dtype, where descr may itself be a nested list
+class DescrParser {
+  public:
+    DescrParser(const std::string& text, size_t pos) : text_(text), pos_(pos) {}
 
-    // shape
-    loc1 = header.find("(");
-    loc2 = header.find(")");
+    cnpy::DType parse() {
+        skip_space();
+        if (peek() == '[') return parse_list();
+        return parse_simple_descr(quoted());
+    }
 
-    std::regex num_regex("[0-9][0-9]*");
-    std::smatch sm;
-    shape.clear();
+  private:
+    char peek() const { return pos_ < text_.size() ? text_[pos_] : 0; }
 
-    std::string str_shape = header.substr(loc1 + 1, loc2 - loc1 - 1);
-    while (std::regex_search(str_shape, sm, num_regex)) {
-        shape.push_back(std::stoi(sm[0].str()));
-        str_shape = sm.suffix().str();
+    void skip_space() {
+        while (pos_ < text_.size() && isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
     }
 
-    // endian, word size, data type
-    // byte order code | stands for not applicable.
-    // not sure when this applies except for byte array
-    loc1 = header.find("descr") + 9;
-    bool littleEndian = (header[loc1] == '<' || header[loc1] == '|' ? true : false);
-    assert(littleEndian);
+    bool accept(char c) {
+        skip_space();
+        if (peek() != c) return false;
+        ++pos_;
+        return true;
+    }
 
-    // char type = header[loc1+1];
-    // assert(type == map_type(T));
+    void expect(char c) {
+        if (!accept(c)) throw std::runtime_error(std::string("parse_npy_header: expected '") + c + "' in descr");
+    }
 
-    std::string str_ws = header.substr(loc1 + 2);
-    loc2 = str_ws.find("'");
-    word_size = atoi(str_ws.substr(0, loc2).c_str());
-}
+    std::string quoted() {
+        skip_space();
+        char q = peek();
+        if (q != '\'' && q != '"') throw std::runtime_error("parse_npy_header: expected a string in descr");
+        size_t end = text_.find(q, pos_ + 1);
+        if (end == std::string::npos) throw std::runtime_error("parse_npy_header: unterminated string in descr");
+        std::string out = text_.substr(pos_ + 1, end - pos_ - 1);
+        pos_ = end + 1;
+        return out;
+    }
 
-void cnpy::parse_npy_header(FILE* fp, size_t& word_size, Shape& shape, bool& fortran_order) {
-    char buffer[256];
-    size_t res = fread(buffer, sizeof(char), 11, fp);
-    if (res != 11) throw std::runtime_error("parse_npy_header: failed fread");
-    std::string header = fgets(buffer, 256, fp);
-    assert(header[header.size() - 1] == '\n');
+    size_t number() {
+        skip_space();
+        size_t start = pos_;
+        while (pos_ < text_.size() && isdigit(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+        if (start == pos_) throw std::runtime_error("parse_npy_header: expected a number in descr");
+        return std::stoull(text_.substr(start, pos_ - start));
+    }
+
+    cnpy::DType parse_list() {
+        expect('[');
+        std::vector<cnpy::Field> fields;
+        size_t offset = 0;
+        while (!accept(']')) {
+            expect('(');
+            skip_space();
+            if (peek() == '(') throw std::runtime_error("parse_npy_header: field titles are not supported");
+            std::string name = quoted();
+            expect(',');
+            cnpy::DType dtype = parse();
+            cnpy::Shape shape;
+            if (accept(',') && accept('(')) {
+                while (!accept(')')) {
+                    shape.push_back(number());
+                    accept(',');
+                }
+                accept(',');
+            }
+            expect(')');
+            accept(',');
+            cnpy::Field field(name, dtype, offset, shape);
+            // unnamed void fields are padding
+            if (!name.empty()) fields.push_back(field);
+            offset += field.num_bytes();
+        }
+        return cnpy::DType::structured(fields, offset);
+    }
+
+    const std::string& text_;
+    size_t pos_;
+};
 
+// parse the python dict literal that makes up the body of an .npy header
+void parse_header_dict(const std::string& header, cnpy::DType& dtype, cnpy::Shape& shape, bool& fortran_order) {
     size_t loc1, loc2;
 
     // fortran order
-    loc1 = header.find("fortran_order");
+    loc1 = header.find("'fortran_order':");
     if (loc1 == std::string::npos)
         throw std::runtime_error("parse_npy_header: failed to find header keyword: 'fortran_order'");
     loc1 += 16;
+    while (loc1 < header.size() && header[loc1] == ' ') ++loc1;
     fortran_order = (header.substr(loc1, 4) == "True" ? true : false);
 
     // shape
-    loc1 = header.find("(");
-    loc2 = header.find(")");
+    loc1 = header.find("(", header.find("'shape':"));
+    loc2 = header.find(")", loc1);
     if (loc1 == std::string::npos || loc2 == std::string::npos)
         throw std::runtime_error("parse_npy_header: failed to find header keyword: '(' or ')'");
 
@@ -133,327 +278,3378 @@ void cnpy::parse_npy_header(FILE* fp, size_t& word_size, Shape& shape, bool& for
 
     std::string str_shape = header.substr(loc1 + 1, loc2 - loc1 - 1);
     while (std::regex_search(str_shape, sm, num_regex)) {
-        shape.push_back(std::stoi(sm[0].str()));
+        shape.push_back(std::stoull(sm[0].str()));
         str_shape = sm.suffix().str();
     }
 
     // endian, word size, data type
-    // byte order code | stands for not applicable.
-    // not sure when this applies except for byte array
-    loc1 = header.find("descr");
+    loc1 = header.find("'descr':");
     if (loc1 == std::string::npos) throw std::runtime_error("parse_npy_header: failed to find header keyword: 'descr'");
-    loc1 += 9;
-    bool littleEndian = (header[loc1] == '<' || header[loc1] == '|' ? true : false);
-    assert(littleEndian);
+    dtype = DescrParser(header, loc1 + 8).parse();
+}
 
-    // char type = header[loc1+1];
-    // assert(type == map_type(T));
+void cnpy::parse_npy_header(const unsigned char* buffer, DType& dtype, Shape& shape, bool& fortran_order) {
+    uint16_t header_len = *reinterpret_cast<const uint16_t*>(buffer + 8);
+    std::string header(reinterpret_cast<const char*>(buffer + 10), header_len);
+    parse_header_dict(header, dtype, shape, fortran_order);
+}
 
-    std::string str_ws = header.substr(loc1 + 2);
-    loc2 = str_ws.find("'");
-    word_size = atoi(str_ws.substr(0, loc2).c_str());
+// read the header at the current position of fp, leaving fp at the start of the data
+void cnpy::parse_npy_header(FILE* fp, DType& dtype, Shape& shape, bool& fortran_order) {
+    unsigned char preamble[10];
+    size_t res = fread(preamble, sizeof(char), 10, fp);
+    if (res != 10) throw std::runtime_error("parse_npy_header: failed fread");
+    uint16_t header_len = *reinterpret_cast<uint16_t*>(preamble + 8);
+    std::string header(header_len, ' ');
+    res = fread(&header[0], sizeof(char), header_len, fp);
+    if (res != header_len) throw std::runtime_error("parse_npy_header: failed fread");
+    if (header.empty() || header[header.size() - 1] != '\n')
+        throw std::runtime_error("parse_npy_header: header does not end with a newline");
+    parse_header_dict(header, dtype, shape, fortran_order);
 }
 
-void cnpy::parse_zip_footer(FILE* fp, uint16_t& nrecs, size_t& global_header_size, size_t& global_header_offset) {
-    std::vector<char> footer(22);
-    fseek(fp, -22, SEEK_END);
-    size_t res = fread(&footer[0], sizeof(char), 22, fp);
-    if (res != 22) throw std::runtime_error("parse_zip_footer: failed fread");
-
-    uint16_t disk_no, disk_start, nrecs_on_disk, comment_len;
-    disk_no = *(uint16_t*)&footer[4];
-    disk_start = *(uint16_t*)&footer[6];
-    nrecs_on_disk = *(uint16_t*)&footer[8];
-    nrecs = *(uint16_t*)&footer[10];
-    global_header_size = *(uint32_t*)&footer[12];
-    global_header_offset = *(uint32_t*)&footer[16];
-    comment_len = *(uint16_t*)&footer[20];
-
-    assert(disk_no == 0);
-    assert(disk_start == 0);
-    assert(nrecs_on_disk == nrecs);
-    assert(comment_len == 0);
-}
-
-cnpy::NpyArray load_the_npy_file(FILE* fp) {
-    cnpy::Shape shape;
-    size_t word_size;
-    bool fortran_order;
-    cnpy::parse_npy_header(fp, word_size, shape, fortran_order);
+void cnpy::parse_npy_header(unsigned char* buffer, size_t& word_size, Shape& shape, bool& fortran_order) {
+    DType dtype;
+    parse_npy_header(const_cast<const unsigned char*>(buffer), dtype, shape, fortran_order);
+    word_size = dtype.size;
+}
 
-    cnpy::NpyArray arr(shape, word_size, fortran_order);
-    size_t nread = fread(arr.data<char>(), 1, arr.num_bytes(), fp);
-    if (nread != arr.num_bytes()) throw std::runtime_error("load_the_npy_file: failed fread");
-    return arr;
+void cnpy::parse_npy_header(FILE* fp, size_t& word_size, Shape& shape, bool& fortran_order) {
+    DType dtype;
+    parse_npy_header(fp, dtype, shape, fortran_order);
+    word_size = dtype.size;
 }
 
-cnpy::NpyArray load_the_npz_array(FILE* fp, uint32_t compr_bytes, uint32_t uncompr_bytes) {
+// little-endian fields of zip records, read without alignment assumptions
+uint16_t zip_u16(const unsigned char* p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+}
 
-    std::vector<unsigned char> buffer_compr(compr_bytes);
-    std::vector<unsigned char> buffer_uncompr(uncompr_bytes);
-    size_t nread = fread(&buffer_compr[0], 1, compr_bytes, fp);
-    if (nread != compr_bytes) throw std::runtime_error("load_the_npy_file: failed fread");
+uint32_t zip_u32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
 
-    int err;
-    z_stream d_stream;
+// the offset of the end of central directory record within tail, the last n bytes of an archive (up to 22 + 65535,
+// the longest an archive comment after the record can make it)
+size_t find_zip_footer(const unsigned char* tail, size_t n, const std::string& what) {
+    if (n < 22) throw std::runtime_error(what + ": too small to be a zip archive");
+    for (size_t eocd = n - 22;; --eocd) {
+        if (zip_u32(tail + eocd) == 0x06054b50) return eocd;
+        if (eocd == 0) throw std::runtime_error(what + ": no zip end of central directory record");
+    }
+}
 
-    d_stream.zalloc = Z_NULL;
-    d_stream.zfree = Z_NULL;
-    d_stream.opaque = Z_NULL;
-    d_stream.avail_in = 0;
-    d_stream.next_in = Z_NULL;
-    err = inflateInit2(&d_stream, -MAX_WBITS);
-    if (err != Z_OK) throw std::runtime_error("load_the_npz_array: inflateInit2 failed");
+// the fields of an end of central directory record that locate the central directory
+struct ZipFooter {
+    uint16_t nrecs;
+    size_t global_header_size;
+    size_t global_header_offset;
+};
+
+ZipFooter decode_zip_footer(const unsigned char* eocd, const std::string& what) {
+    uint16_t disk_no = zip_u16(eocd + 4);
+    uint16_t disk_start = zip_u16(eocd + 6);
+    uint16_t nrecs_on_disk = zip_u16(eocd + 8);
+    ZipFooter footer;
+    footer.nrecs = zip_u16(eocd + 10);
+    footer.global_header_size = zip_u32(eocd + 12);
+    footer.global_header_offset = zip_u32(eocd + 16);
+    if (disk_no != 0 || disk_start != 0 || nrecs_on_disk != footer.nrecs)
+        throw std::runtime_error(what + ": zip archives spanning several disks are not supported");
+    return footer;
+}
 
-    d_stream.avail_in = compr_bytes;
-    d_stream.next_in = &buffer_compr[0];
-    d_stream.avail_out = uncompr_bytes;
-    d_stream.next_out = &buffer_uncompr[0];
+// the fixed 30 bytes of a local file header, which the entry's name and extra field follow
+struct ZipLocalHeader {
+    uint16_t compr_method;
+    uint32_t compr_bytes;
+    uint32_t uncompr_bytes;
+    uint16_t name_len;
+    uint16_t extra_len;
+};
+
+// false if p does not hold a local file header, as at the central directory after the last entry
+bool decode_zip_local_header(const unsigned char* p, ZipLocalHeader& header) {
+    if (zip_u32(p) != 0x04034b50) return false;
+    header.compr_method = zip_u16(p + 8);
+    header.compr_bytes = zip_u32(p + 18);
+    header.uncompr_bytes = zip_u32(p + 22);
+    header.name_len = zip_u16(p + 26);
+    header.extra_len = zip_u16(p + 28);
+    return true;
+}
 
-    err = inflate(&d_stream, Z_FINISH);
-    if (err != Z_STREAM_END) throw std::runtime_error("load_the_npz_array: inflate failed");
-    err = inflateEnd(&d_stream);
-    if (err != Z_OK) throw std::runtime_error("load_the_npz_array: inflateEnd failed");
+void cnpy::parse_zip_footer(FILE* fp, uint16_t& nrecs, size_t& global_header_size, size_t& global_header_offset) {
+    if (fseek(fp, 0, SEEK_END) != 0) throw std::runtime_error("parse_zip_footer: failed fseek");
+    long size = ftell(fp);
+    if (size < 22) throw std::runtime_error("parse_zip_footer: too small to be a zip archive");
+    std::vector<unsigned char> tail(std::min<size_t>(size, 22 + 0xffff));
+    fseek(fp, size - static_cast<long>(tail.size()), SEEK_SET);
+    size_t res = fread(&tail[0], sizeof(char), tail.size(), fp);
+    if (res != tail.size()) throw std::runtime_error("parse_zip_footer: failed fread");
+
+    ZipFooter footer =
+        decode_zip_footer(&tail[find_zip_footer(tail.data(), tail.size(), "parse_zip_footer")], "parse_zip_footer");
+    nrecs = footer.nrecs;
+    global_header_size = footer.global_header_size;
+    global_header_offset = footer.global_header_offset;
+}
 
-    cnpy::Shape shape;
-    size_t word_size;
-    bool fortran_order;
-    cnpy::parse_npy_header(&buffer_uncompr[0], word_size, shape, fortran_order);
+// size of the words whose bytes a change of byte order reverses: complex numbers swap each part separately
+size_t swap_unit(const cnpy::DType& dtype) {
+    if (dtype.kind == 'c') return dtype.size / 2;
+    if (dtype.kind == 'U') return 4;
+    return dtype.size;
+}
 
-    cnpy::NpyArray array(shape, word_size, fortran_order);
+// reverse the bytes of every non-native word in nbytes of dtype elements, converting between native and stored order.
+// the fields of structured dtypes are swapped record by record according to their own byte order
+void swap_bytes(char* data, size_t nbytes, const cnpy::DType& dtype) {
+    if (dtype.is_native()) return;
+    if (dtype.is_structured()) {
+        for (const cnpy::Field& f : *dtype.fields) {
+            if (f.dtype.is_native()) continue;
+            for (size_t rec = 0; rec + dtype.size <= nbytes; rec += dtype.size)
+                swap_bytes(data + rec + f.offset, f.num_bytes(), f.dtype);
+        }
+        return;
+    }
+    size_t unit = swap_unit(dtype);
+    cnpy::kernels::byteswap(data, unit, nbytes / unit);
+}
 
-    size_t offset = uncompr_bytes - array.num_bytes();
-    memcpy(array.data<unsigned char>(), &buffer_uncompr[0] + offset, array.num_bytes());
+void pwrite_fully(int fd, const void* src, size_t nbytes, size_t offset) {
+    const char* p = static_cast<const char*>(src);
+    while (nbytes > 0) {
+        ssize_t n = ::pwrite(fd, p, nbytes, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("pwrite_fully: failed pwrite");
+        p += n;
+        offset += n;
+        nbytes -= n;
+    }
+}
 
-    return array;
+// tell the kernel how a file about to be read will be used
+void advise_read(int fd, cnpy::CachePolicy cache) {
+#ifdef __linux__
+    if (cache != cnpy::CachePolicy::Stream) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+#endif
 }
-// Helper to memory-map a .npy array within a .npz file
-cnpy::NpyArray load_the_npy_mmap(FILE* fp) {
-    long data_pos = ftell(fp);
-    auto mmap_file = std::make_shared<cnpy::MMapFile>(fileno(fp), "rw");
-    unsigned char* buffer = reinterpret_cast<unsigned char*>(const_cast<char*>(mmap_file->data()));
-    size_t word_size;
-    cnpy::Shape shape;
-    bool fortran_order;
-    cnpy::parse_npy_header(buffer + data_pos, word_size, shape, fortran_order);
-    uint16_t header_len = *reinterpret_cast<uint16_t*>(buffer + data_pos + 8);
-    size_t data_offset = data_pos + 10 + header_len;
-    return cnpy::NpyArray(shape, word_size, fortran_order, mmap_file, data_offset);
+
+// drop a file that has been read from the page cache
+void release_read(int fd, cnpy::CachePolicy cache) {
+#ifdef __linux__
+    if (cache == cnpy::CachePolicy::Stream) posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
 }
 
-// mmap-enabled overload for npz_save (pointer version) removed (duplicate)
-cnpy::npz_t cnpy::npz_load(std::string fname, bool use_mmap) {
-    FILE* fp = fopen(fname.c_str(), use_mmap ? "rb+" : "rb");
+// Keeps a large write from filling the page cache with dirty pages, for CachePolicy::Stream. Each time another
+// window has been written, writeback of it is started and the window before it, which has had a window's worth of
+// writing to get to the disk, is waited for and dropped from the cache.
+class WritebackThrottle {
+  public:
+    static const size_t window = 8 << 20;
 
-    if (!fp) {
-        throw std::runtime_error("npz_load: Error! Unable to open file " + fname + "!");
+    WritebackThrottle(int fd, size_t start) : fd_(fd), start_(start), done_(start) {}
+
+    // the bytes up to end have been written
+    void wrote(size_t end) {
+        for (; end - done_ >= window; done_ += window) {
+            start_writeback(done_, window);
+            if (done_ - start_ >= window) drop(done_ - window, window);
+        }
     }
 
-    cnpy::npz_t arrays;
+    // write back and drop whatever is left, once the bytes up to end have been written
+    void finish(size_t end) {
+        size_t from = done_ - start_ >= window ? done_ - window : start_;
+        if (end > from) drop(from, end - from);
+        done_ = end;
+    }
 
-    while (1) {
-        std::vector<char> local_header(30);
-        size_t headerres = fread(&local_header[0], sizeof(char), 30, fp);
-        if (headerres != 30) throw std::runtime_error("npz_load: failed fread");
+  private:
+    void start_writeback(size_t offset, size_t nbytes) {
+#ifdef __linux__
+        sync_file_range(fd_, offset, nbytes, SYNC_FILE_RANGE_WRITE);
+#endif
+    }
 
-        // if we've reached the global header, stop reading
-        if (local_header[2] != 0x03 || local_header[3] != 0x04) break;
+    void drop(size_t offset, size_t nbytes) {
+#ifdef __linux__
+        // pages are only dropped once clean, so wait for their writeback first
+        sync_file_range(fd_, offset, nbytes,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(fd_, offset, nbytes, POSIX_FADV_DONTNEED);
+#endif
+    }
 
-        // read in the variable name
-        uint16_t name_len = *(uint16_t*)&local_header[26];
-        std::string varname(name_len, ' ');
-        size_t vname_res = fread(&varname[0], sizeof(char), name_len, fp);
-        if (vname_res != name_len) throw std::runtime_error("npz_load: failed fread");
+    int fd_;
+    size_t start_;
+    size_t done_; // the end of the last window whose writeback was started
+};
 
-        // erase the lagging .npy
-        varname.erase(varname.end() - 4, varname.end());
+// a sink that appends to buffer
+cnpy::ByteSink append_to(std::vector<char>& buffer) {
+    return [&buffer](const void* p, size_t n) {
+        buffer.insert(buffer.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+    };
+}
 
-        // read in the extra field
-        uint16_t extra_field_len = *(uint16_t*)&local_header[28];
-        if (extra_field_len > 0) {
-            std::vector<char> buff(extra_field_len);
-            size_t efield_res = fread(&buff[0], sizeof(char), extra_field_len, fp);
-            if (efield_res != extra_field_len) throw std::runtime_error("npz_load: failed fread");
-        }
+// Writes a stream of (pointer, length) pieces to fd from offset on without copying them: pieces are queued and
+// written with one pwritev per IOV_MAX of them, or fed straight to deflate when compressing. The CRC-32 of the
+// bytes is computed as they go by, for zip headers. Queued pieces must stay valid until flush() or finish().
+class SegmentWriter {
+  public:
+    SegmentWriter(int fd, size_t offset, bool compress)
+        : crc(crc32(0L, Z_NULL, 0)), bytes_in(0), bytes_out(0), fd_(fd), offset_(offset), compress_(compress),
+          queued_(0) {
+        init();
+    }
 
-        uint16_t compr_method = *reinterpret_cast<uint16_t*>(&local_header[0] + 8);
-        uint32_t compr_bytes = *reinterpret_cast<uint32_t*>(&local_header[0] + 18);
-        uint32_t uncompr_bytes = *reinterpret_cast<uint32_t*>(&local_header[0] + 22);
+    // hand the output to sink instead of writing it to a file
+    SegmentWriter(const cnpy::ByteSink& sink, bool compress)
+        : crc(crc32(0L, Z_NULL, 0)), bytes_in(0), bytes_out(0), fd_(-1), offset_(0), sink_(sink),
+          compress_(compress), queued_(0) {
+        init();
+    }
 
-        if (compr_method == 0) {
-            if (use_mmap) {
-                arrays[varname] = load_the_npy_mmap(fp);
-                // skip mmap data to advance file pointer past this entry
-                fseek(fp, uncompr_bytes, SEEK_CUR);
-            } else {
-                arrays[varname] = load_the_npy_file(fp);
+    // collect the output in memory instead of writing it to a file
+    SegmentWriter(std::vector<char>& buffer, bool compress) : SegmentWriter(append_to(buffer), compress) {}
+
+    ~SegmentWriter() {
+        if (compress_) deflateEnd(&strm_);
+    }
+
+    // write in windows with a WritebackThrottle, for CachePolicy::Stream
+    void stream() { throttle_.reset(new WritebackThrottle(fd_, offset_)); }
+
+    void write(const void* data, size_t nbytes) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        bytes_in += nbytes;
+        // zlib lengths are 32-bit
+        for (size_t done = 0; done < nbytes;) {
+            uInt n = static_cast<uInt>(std::min<size_t>(nbytes - done, 1u << 30));
+            crc = crc32(crc, p + done, n);
+            if (compress_) deflate_some(p + done, n, Z_NO_FLUSH);
+            done += n;
+        }
+        if (compress_) return;
+        // when streaming, each pwritev covers at most one window so that the throttle sees every window go out
+        while (nbytes > 0) {
+            size_t n = throttle_ ? std::min(nbytes, WritebackThrottle::window - queued_) : nbytes;
+            struct iovec iov;
+            iov.iov_base = const_cast<unsigned char*>(p);
+            iov.iov_len = n;
+            iov_.push_back(iov);
+            queued_ += n;
+            p += n;
+            nbytes -= n;
+            if (iov_.size() == IOV_MAX || (throttle_ && queued_ == WritebackThrottle::window)) flush();
+        }
+    }
+
+    // write out the queued pieces
+    void flush() {
+        if (sink_) {
+            for (const struct iovec& iov : iov_) {
+                if (iov.iov_len > 0) sink_(iov.iov_base, iov.iov_len);
+                bytes_out += iov.iov_len;
             }
-        } else {
-            if (use_mmap) {
-                std::cerr << "Warning: npz_load: memory map requested but file '" << fname << "' entry '" << varname
-                          << "' is compressed; falling back to memory load" << std::endl;
+            iov_.clear();
+            queued_ = 0;
+            return;
+        }
+        size_t first = 0;
+        while (first < iov_.size()) {
+            ssize_t n = ::pwritev(fd_, &iov_[first], static_cast<int>(iov_.size() - first), offset_ + bytes_out);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) throw std::runtime_error("npy_save: failed pwritev");
+            bytes_out += n;
+            // skip what was written, which may end partway through a piece
+            size_t left = static_cast<size_t>(n);
+            while (first < iov_.size() && left >= iov_[first].iov_len) left -= iov_[first++].iov_len;
+            if (left > 0) {
+                iov_[first].iov_base = static_cast<char*>(iov_[first].iov_base) + left;
+                iov_[first].iov_len -= left;
             }
-            arrays[varname] = load_the_npz_array(fp, compr_bytes, uncompr_bytes);
         }
+        iov_.clear();
+        queued_ = 0;
+        if (throttle_) throttle_->wrote(offset_ + bytes_out);
     }
 
-    fclose(fp);
-    return arrays;
-}
+    void finish() {
+        if (compress_)
+            deflate_some(nullptr, 0, Z_FINISH);
+        else
+            flush();
+        if (throttle_) throttle_->finish(offset_ + bytes_out);
+    }
 
-cnpy::NpyArray cnpy::npz_load(std::string fname, std::string varname, bool use_mmap) {
-    FILE* fp = fopen(fname.c_str(), use_mmap ? "rb+" : "rb");
+    uint32_t crc;
+    size_t bytes_in;
+    size_t bytes_out; // bytes written to fd, compressed or not
+
+  private:
+    void init() {
+        if (compress_) {
+            strm_.zalloc = Z_NULL;
+            strm_.zfree = Z_NULL;
+            strm_.opaque = Z_NULL;
+            if (deflateInit2(&strm_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                throw std::runtime_error("npz_save: deflateInit2 failed");
+            out_.resize(1 << 18);
+        }
+    }
 
-    if (!fp) throw std::runtime_error("npz_load: Unable to open file " + fname);
+    void deflate_some(const unsigned char* p, uInt n, int flush_mode) {
+        strm_.next_in = const_cast<unsigned char*>(p);
+        strm_.avail_in = n;
+        int err;
+        do {
+            strm_.next_out = out_.data();
+            strm_.avail_out = static_cast<uInt>(out_.size());
+            err = deflate(&strm_, flush_mode);
+            if (err == Z_STREAM_ERROR) throw std::runtime_error("npz_save: deflate failed");
+            size_t have = out_.size() - strm_.avail_out;
+            if (have > 0) {
+                struct iovec iov = {out_.data(), have};
+                iov_.assign(1, iov);
+                flush();
+            }
+        } while (strm_.avail_out == 0 || (flush_mode == Z_FINISH && err != Z_STREAM_END));
+    }
 
-    while (1) {
-        std::vector<char> local_header(30);
-        size_t header_res = fread(&local_header[0], sizeof(char), 30, fp);
-        if (header_res != 30) throw std::runtime_error("npz_load: failed fread");
+    int fd_;
+    size_t offset_;
+    cnpy::ByteSink sink_;
+    bool compress_;
+    z_stream strm_;
+    std::vector<unsigned char> out_;
+    std::vector<struct iovec> iov_;
+    size_t queued_; // bytes in iov_
+    std::unique_ptr<WritebackThrottle> throttle_;
+};
+
+// O_DIRECT transfers need the memory address, length and file offset aligned to the device's logical block size.
+// 4096 covers both 512-byte and 4K sector devices
+const size_t direct_align = 4096;
+
+// Writes a stream of pieces to an fd opened with O_DIRECT from an aligned offset. Aligned runs of a piece are written
+// straight from the caller's memory; everything else is copied through an aligned bounce buffer, and the final
+// partial block is padded with zeros and cut off again by finish(). Works unchanged on an fd without O_DIRECT.
+class DirectWriter {
+  public:
+    DirectWriter(int fd, size_t offset) : bytes_out(0), fd_(fd), offset_(offset), bounce_(nullptr), fill_(0) {
+        if (offset % direct_align) throw std::runtime_error("npy_save: unaligned O_DIRECT offset");
+        if (posix_memalign(&bounce_, direct_align, bounce_size) != 0)
+            throw std::runtime_error("npy_save: failed to allocate an aligned buffer");
+    }
 
-        // if we've reached the global header, stop reading
-        if (local_header[2] != 0x03 || local_header[3] != 0x04) break;
+    ~DirectWriter() { free(bounce_); }
+
+    void write(const void* data, size_t nbytes) {
+        const char* p = static_cast<const char*>(data);
+        while (nbytes > 0) {
+            if (fill_ == 0 && reinterpret_cast<uintptr_t>(p) % direct_align == 0 && nbytes >= direct_align) {
+                size_t n = std::min<size_t>(nbytes - nbytes % direct_align, 1 << 30);
+                put(p, n);
+                p += n;
+                nbytes -= n;
+                continue;
+            }
+            size_t n = std::min(nbytes, bounce_size - fill_);
+            memcpy(static_cast<char*>(bounce_) + fill_, p, n);
+            fill_ += n;
+            p += n;
+            nbytes -= n;
+            if (fill_ == bounce_size) {
+                put(bounce_, fill_);
+                fill_ = 0;
+            }
+        }
+    }
 
-        // read in the variable name
-        uint16_t name_len = *(uint16_t*)&local_header[26];
-        std::string vname(name_len, ' ');
-        size_t vname_res = fread(&vname[0], sizeof(char), name_len, fp);
-        if (vname_res != name_len) throw std::runtime_error("npz_load: failed fread");
-        vname.erase(vname.end() - 4, vname.end()); // erase the lagging .npy
+    void flush() {}
 
-        // read in the extra field
-        uint16_t extra_field_len = *(uint16_t*)&local_header[28];
-        fseek(fp, extra_field_len, SEEK_CUR); // skip past the extra field
+    void finish() {
+        if (fill_ == 0) return;
+        size_t padded = (fill_ + direct_align - 1) / direct_align * direct_align;
+        memset(static_cast<char*>(bounce_) + fill_, 0, padded - fill_);
+        put(bounce_, padded);
+        bytes_out -= padded - fill_;
+        fill_ = 0;
+        if (::ftruncate(fd_, offset_ + bytes_out) != 0) throw std::runtime_error("npy_save: failed ftruncate");
+    }
 
-        uint16_t compr_method = *reinterpret_cast<uint16_t*>(&local_header[0] + 8);
-        uint32_t compr_bytes = *reinterpret_cast<uint32_t*>(&local_header[0] + 18);
-        uint32_t uncompr_bytes = *reinterpret_cast<uint32_t*>(&local_header[0] + 22);
+    size_t bytes_out;
 
-        if (vname == varname) {
-            NpyArray array;
-            if (use_mmap && compr_method == 0) {
-                array = load_the_npy_mmap(fp);
-            } else if (compr_method == 0) {
-                array = load_the_npy_file(fp);
-            } else {
-                if (use_mmap) {
-                    std::cerr << "Warning: npz_load: memory map requested but file '" << fname << "' entry '" << varname
-                              << "' is compressed; falling back to memory load" << std::endl;
-                }
-                array = load_the_npz_array(fp, compr_bytes, uncompr_bytes);
+  private:
+    static const size_t bounce_size = 1 << 22;
+
+    void put(const void* src, size_t nbytes) {
+        pwrite_fully(fd_, src, nbytes, offset_ + bytes_out);
+        bytes_out += nbytes;
+    }
+
+    int fd_;
+    size_t offset_;
+    void* bounce_;
+    size_t fill_;
+};
+
+// feed the array data held in segments to w in the byte order of dtype. native data is passed on as it is; other
+// byte orders are swapped through a bounded staging buffer, so segments need not split at element boundaries
+template <typename Writer>
+void write_array_data(Writer& w, const std::vector<cnpy::Segment>& segments, const cnpy::DType& dtype) {
+    if (dtype.is_native()) {
+        for (const cnpy::Segment& seg : segments) w.write(seg.data, seg.size);
+        return;
+    }
+    std::vector<char> buf(std::max<size_t>(1, (1 << 20) / dtype.size) * dtype.size);
+    size_t fill = 0;
+    for (const cnpy::Segment& seg : segments) {
+        const char* p = static_cast<const char*>(seg.data);
+        for (size_t done = 0; done < seg.size;) {
+            size_t n = std::min(seg.size - done, buf.size() - fill);
+            memcpy(buf.data() + fill, p + done, n);
+            fill += n;
+            done += n;
+            if (fill == buf.size()) {
+                swap_bytes(buf.data(), fill, dtype);
+                w.write(buf.data(), fill);
+                w.flush();
+                fill = 0;
             }
-            fclose(fp);
-            return array;
-        } else {
-            // skip past the data
-            uint32_t size = *(uint32_t*)&local_header[22];
-            fseek(fp, size, SEEK_CUR);
         }
     }
+    swap_bytes(buf.data(), fill, dtype);
+    w.write(buf.data(), fill);
+    w.flush();
+}
 
-    fclose(fp);
+// check that segments hold exactly the data of an array of the given shape and dtype
+void check_segments(const std::string& what, const std::vector<cnpy::Segment>& segments, const cnpy::Shape& shape,
+                    const cnpy::DType& dtype) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    size_t total = 0;
+    for (const cnpy::Segment& seg : segments) total += seg.size;
+    if (total != nbytes)
+        throw std::runtime_error(what + ": segments hold " + std::to_string(total) + " bytes but the array needs " +
+                                 std::to_string(nbytes));
+}
 
-    // if we get here, we haven't found the variable in the file
-    throw std::runtime_error("npz_load: Variable name " + varname + " not found in " + fname);
+void cnpy::npy_save(std::string fname, const void* data, const Shape& shape, const DType& dtype, std::string mode) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    npy_save(fname, std::vector<Segment>(1, Segment(data, nbytes)), shape, dtype, mode);
 }
 
-cnpy::NpyArray cnpy::npz_load(std::string fname, const char* varname, bool use_mmap) {
-    return npz_load(fname, std::string(varname), use_mmap);
+// grow the padding of a .npy header so that it is exactly size bytes long
+void pad_npy_header(std::vector<char>& header, size_t size) {
+    if (size < header.size()) throw std::runtime_error("npy_save: new header does not fit in the existing one");
+    if (size - 10 > 0xffff) throw std::runtime_error("npy_save: header too long for format version 1.0");
+    header.insert(header.end() - 1, size - header.size(), ' ');
+    uint16_t dict_len = static_cast<uint16_t>(size - 10);
+    memcpy(&header[8], &dict_len, 2);
 }
 
-cnpy::NpyArray cnpy::npy_load(std::string fname, bool use_mmap) {
+void cnpy::npy_save(std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                    const SaveOptions& options) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    npy_save(fname, std::vector<Segment>(1, Segment(data, nbytes)), shape, dtype, options);
+}
 
-    if (!use_mmap) {
-        FILE* fp = fopen(fname.c_str(), "rb");
+// A file being saved. Atomic saves write to an unnamed O_TMPFILE in the target's directory where the kernel and
+// filesystem allow it, and otherwise to a hidden temporary file next to the target. publish_save_target then renames
+// the finished file over the target, so readers see the old file or the new one but never a partial one, and a crash
+// leaves at most a stray temporary.
+struct SaveTarget {
+    std::string fname;
+    std::string temp; // the temporary name, while there is one
+    int fd;
+    SaveTarget() : fd(-1) {}
+};
+
+// a hidden name in the same directory as fname, which rename can move over fname
+std::string temp_name_for(const std::string& fname) {
+    static std::atomic<unsigned> counter(0);
+    size_t slash = fname.rfind('/');
+    size_t start = slash == std::string::npos ? 0 : slash + 1;
+    return fname.substr(0, start) + "." + fname.substr(start) + ".tmp" + std::to_string(getpid()) + "_" +
+           std::to_string(counter++);
+}
 
-        if (!fp) throw std::runtime_error("npy_load: Unable to open file " + fname);
+std::string directory_of(const std::string& fname) {
+    size_t slash = fname.rfind('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : fname.substr(0, slash);
+}
 
-        NpyArray arr = load_the_npy_file(fp);
+// open fname for writing with flags, or with options.atomic a new temporary file to publish as fname later.
+// options.direct adds O_DIRECT where the filesystem accepts it
+SaveTarget open_save_target(const std::string& what, const std::string& fname, int flags,
+                            const cnpy::SaveOptions& options) {
+    // filesystems without O_DIRECT support (tmpfs, some FUSE mounts) reject it with EINVAL; write buffered there
+    auto open_file = [&options](const std::string& path, int open_flags) {
+        int fd = -1;
+#ifdef O_DIRECT
+        if (options.direct) fd = ::open(path.c_str(), open_flags | O_DIRECT, 0666);
+        if (fd >= 0 || (options.direct && errno != EINVAL)) return fd;
+#endif
+        return ::open(path.c_str(), open_flags, 0666);
+    };
 
-        fclose(fp);
-        return arr;
+    SaveTarget target;
+    target.fname = fname;
+    if (!options.atomic) {
+        target.fd = open_file(fname, flags | O_CLOEXEC);
     } else {
-#ifdef __unix__
-        // Open and memory-map the file (read-write mode)
-        std::shared_ptr<MMapFile> mmap_file = std::make_shared<MMapFile>(fname, "rw");
-        // Obtain raw pointer to the mapped region
-        unsigned char* buffer = reinterpret_cast<unsigned char*>(const_cast<char*>(mmap_file->data()));
-        // Parse the header from the mapped memory
-        size_t word_size;
-        Shape shape;
-        bool fortran_order;
-        cnpy::parse_npy_header(buffer, word_size, shape, fortran_order);
-        // Header length is stored at offset 8 (little-endian uint16)
-        uint16_t header_len = *reinterpret_cast<uint16_t*>(buffer + 8);
-        size_t data_offset = 10 + header_len; // 10 bytes before header data
-        // Construct an NpyArray that references the mmap region
-        cnpy::NpyArray arr(shape, word_size, fortran_order, mmap_file, data_offset);
-        return arr;
+#ifdef O_TMPFILE
+        // an O_TMPFILE is given its name through /proc/self/fd, so it is only any use where /proc is mounted
+        if (::access("/proc/self/fd", X_OK) == 0)
+            target.fd = open_file(directory_of(fname), O_TMPFILE | O_WRONLY | O_CLOEXEC);
+#endif
+        if (target.fd < 0) {
+            target.temp = temp_name_for(fname);
+            target.fd = open_file(target.temp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC);
+            if (target.fd < 0) target.temp.clear();
+        }
+    }
+    if (target.fd < 0) throw std::runtime_error(what + ": Unable to open file " + fname + ": " + strerror(errno));
+    return target;
+}
+
+// give up on a save, removing its temporary file
+void abandon_save_target(SaveTarget& target) {
+    if (target.fd >= 0) ::close(target.fd);
+    target.fd = -1;
+    if (!target.temp.empty()) ::unlink(target.temp.c_str());
+    target.temp.clear();
+}
+
+// sync the finished file as options.fsync asks, close it and, for an atomic save, move it into place
+void publish_save_target(const std::string& what, SaveTarget& target, const cnpy::SaveOptions& options) {
+    using cnpy::FsyncPolicy;
+    int err = 0;
+    // a replaced file keeps its owner and permissions, so a private file does not become readable by others. only
+    // a privileged process may give a file away; anyone else stays the owner of the new file
+    struct stat existing;
+    if (options.atomic && ::stat(target.fname.c_str(), &existing) == 0) {
+        if (::fchown(target.fd, existing.st_uid, existing.st_gid) != 0 && errno != EPERM) err = errno;
+        if (err == 0 && ::fchmod(target.fd, existing.st_mode & 07777) != 0) err = errno;
+    }
+#if defined(__linux__)
+    if (err == 0 && options.fsync == FsyncPolicy::Data && ::fdatasync(target.fd) != 0) err = errno;
 #else
-        stderr << "mmap not supported – fallback to regular load" << std::endl;
-        return npy_load(fname, false);
+    if (err == 0 && options.fsync == FsyncPolicy::Data && ::fsync(target.fd) != 0) err = errno;
 #endif
+    if (err == 0 && options.fsync == FsyncPolicy::Full && ::fsync(target.fd) != 0) err = errno;
+    if (err == 0 && options.atomic && target.temp.empty()) {
+        // linkat cannot replace an existing file, so the O_TMPFILE gets a temporary name to rename from
+        std::string temp = temp_name_for(target.fname);
+        std::string path = "/proc/self/fd/" + std::to_string(target.fd);
+        if (::linkat(AT_FDCWD, path.c_str(), AT_FDCWD, temp.c_str(), AT_SYMLINK_FOLLOW) == 0)
+            target.temp = temp;
+        else
+            err = errno;
+    }
+    if (::close(target.fd) != 0 && err == 0) err = errno;
+    target.fd = -1;
+    if (err == 0 && !target.temp.empty()) {
+        if (::rename(target.temp.c_str(), target.fname.c_str()) == 0)
+            target.temp.clear();
+        else
+            err = errno;
+    }
+    // the new directory entry is only durable once the directory itself is synced
+    if (err == 0 && options.fsync == FsyncPolicy::Full) {
+        int dir = ::open(directory_of(target.fname).c_str(), O_RDONLY | O_CLOEXEC);
+        if (dir < 0 || ::fsync(dir) != 0) err = errno;
+        if (dir >= 0) ::close(dir);
+    }
+    if (err != 0) {
+        abandon_save_target(target);
+        throw std::runtime_error(what + ": failed to write out " + target.fname + ": " + strerror(err));
     }
 }
 
-// Implementation of new_npz_mmap
-cnpy::npz_t cnpy::new_npz_mmap(std::string filename, const std::vector<ShapeAndType>& _shapes, bool _fortran_order) {
-    if (_shapes.empty()) return npz_t();
-    bool first = true;
-    for (const auto& st : _shapes) {
-        const auto& shape = st.shape;
-        size_t nvals = 1;
-        for (size_t dim : shape) nvals *= dim;
-        std::string mode = first ? "w" : "a";
-        first = false;
-        const std::type_info& tinfo = st.type_info;
-        if (tinfo == typeid(int)) {
-            std::vector<int> data(nvals);
-            npz_save<int>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(float)) {
-            std::vector<float> data(nvals);
-            npz_save<float>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(double)) {
-            std::vector<double> data(nvals);
-            npz_save<double>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(long double)) {
-            std::vector<long double> data(nvals);
-            npz_save<long double>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(char)) {
-            std::vector<char> data(nvals);
-            npz_save<char>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(short)) {
-            std::vector<short> data(nvals);
-            npz_save<short>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(long)) {
-            std::vector<long> data(nvals);
-            npz_save<long>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(long long)) {
-            std::vector<long long> data(nvals);
-            npz_save<long long>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(unsigned char)) {
-            std::vector<unsigned char> data(nvals);
-            npz_save<unsigned char>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(unsigned short)) {
-            std::vector<unsigned short> data(nvals);
-            npz_save<unsigned short>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(unsigned int)) {
-            std::vector<unsigned int> data(nvals);
-            npz_save<unsigned int>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(unsigned long)) {
-            std::vector<unsigned long> data(nvals);
-            npz_save<unsigned long>(filename, st.name, data.data(), shape, mode, false);
-        } else if (tinfo == typeid(unsigned long long)) {
-            std::vector<unsigned long long> data(nvals);
-            npz_save<unsigned long long>(filename, st.name, data.data(), shape, mode, false);
+// write a new .npy file as npy_save(..., SaveOptions) does, returning it still open and unpublished
+SaveTarget write_new_npy(const std::string& fname, const std::vector<cnpy::Segment>& segments,
+                         const cnpy::Shape& shape, const cnpy::DType& dtype, const cnpy::SaveOptions& options) {
+    check_segments("npy_save", segments, shape, dtype);
+    std::vector<char> header = cnpy::create_npy_header(shape, dtype);
+    // with O_DIRECT the data has to start on an aligned offset, so the header is padded out to a whole block
+    if (options.direct) pad_npy_header(header, direct_align);
+    size_t total = header.size() + std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+
+    SaveTarget target = open_save_target("npy_save", fname, O_WRONLY | O_CREAT | O_TRUNC, options);
+    int fd = target.fd;
+    try {
+#ifdef __linux__
+        // reserve the blocks up front so that the file is laid out in one go. not every filesystem can; that is fine
+        if (options.preallocate && total > 0 && ::fallocate(fd, 0, 0, total) != 0 && errno != EOPNOTSUPP &&
+            errno != ENOSYS)
+            throw std::runtime_error("npy_save: failed fallocate for " + fname + ": " + strerror(errno));
+#endif
+        if (options.direct) {
+            DirectWriter w(fd, 0);
+            w.write(header.data(), header.size());
+            write_array_data(w, segments, dtype);
+            w.finish();
         } else {
-            throw std::runtime_error("new_npz_mmap: unsupported type for variable " + st.name);
+            // header and data go out together, in a single pwritev unless there are more than IOV_MAX segments
+            SegmentWriter w(fd, 0, false);
+            if (options.cache == cnpy::CachePolicy::Stream) w.stream();
+            w.write(header.data(), header.size());
+            write_array_data(w, segments, dtype);
+            w.finish();
         }
+    } catch (...) {
+        abandon_save_target(target);
+        throw;
     }
-    // Return memory-mapped arrays
-    auto arrays = npz_load(filename, true);
-    for (auto& kv : arrays) {
-        kv.second.fortran_order = _fortran_order;
+    return target;
+}
+
+void cnpy::npy_save(std::string fname, const std::vector<Segment>& segments, const Shape& shape, const DType& dtype,
+                    const SaveOptions& options) {
+    SaveTarget target = write_new_npy(fname, segments, shape, dtype, options);
+    publish_save_target("npy_save", target, options);
+}
+
+void cnpy::npy_save(std::string fname, const std::vector<Segment>& segments, const Shape& shape, const DType& dtype,
+                    std::string mode) {
+    FILE* fp = NULL;
+    if (mode == "a") fp = fopen(fname.c_str(), "r+b");
+    if (!fp) {
+        npy_save(fname, segments, shape, dtype, SaveOptions());
+        return;
     }
-    return arrays;
+
+    check_segments("npy_save", segments, shape, dtype);
+    Shape true_data_shape; // the shape of existing + new data
+    size_t header_size;
+    // the file exists: read its header and check that the new rows fit
+    DType stored;
+    bool fortran_order;
+    try {
+        parse_npy_header(fp, stored, true_data_shape, fortran_order);
+        if (fortran_order)
+            throw std::runtime_error("npy_save: cannot append to Fortran-ordered array in " + fname);
+        if (!stored.same_layout(dtype))
+            throw std::runtime_error("npy_save: " + fname + " has dtype " + stored.str() +
+                                     " but npy_save appending dtype " + dtype.str());
+        if (true_data_shape.size() != shape.size())
+            throw std::runtime_error("npy_save: attempting to append misdimensioned data to " + fname);
+        for (size_t i = 1; i < shape.size(); i++) {
+            if (shape[i] != true_data_shape[i])
+                throw std::runtime_error("npy_save: attempting to append misshaped data to " + fname);
+        }
+        header_size = ftell(fp);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+    true_data_shape[0] += shape[0];
+
+    // the data stays where it is, so the new header must take up exactly the space of the old one
+    std::vector<char> header = create_npy_header(true_data_shape, dtype);
+    int fd = fileno(fp);
+    try {
+        pad_npy_header(header, header_size);
+        pwrite_fully(fd, header.data(), header.size(), 0);
+        off_t end = ::lseek(fd, 0, SEEK_END);
+        if (end < 0) throw std::runtime_error("npy_save: failed lseek in " + fname);
+        SegmentWriter w(fd, end, false);
+        write_array_data(w, segments, dtype);
+        w.finish();
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+    fclose(fp);
+}
+
+// the local file header of a zip entry
+std::vector<char> zip_local_header(const std::string& fname, uint32_t crc, size_t compressed, size_t nbytes,
+                                   uint16_t compr_method) {
+    using cnpy::operator+=;
+    std::vector<char> local_header;
+    local_header += "PK";                   // first part of sig
+    local_header += (uint16_t)0x0403;       // second part of sig
+    local_header += (uint16_t)20;           // min version to extract
+    local_header += (uint16_t)0;            // general purpose bit flag
+    local_header += compr_method;           // compression method
+    local_header += (uint16_t)0;            // file last mod time
+    local_header += (uint16_t)0;            // file last mod date
+    local_header += (uint32_t)crc;          // crc
+    local_header += (uint32_t)compressed;   // compressed size
+    local_header += (uint32_t)nbytes;       // uncompressed size
+    local_header += (uint16_t)fname.size(); // fname length
+    local_header += (uint16_t)0;            // extra field length
+    local_header += fname;
+    return local_header;
+}
+
+// add the central directory record of the entry whose local header is at offset
+void append_zip_record(std::vector<char>& global_header, const std::vector<char>& local_header, size_t offset,
+                       const std::string& fname) {
+    using cnpy::operator+=;
+    global_header += "PK";             // first part of sig
+    global_header += (uint16_t)0x0201; // second part of sig
+    global_header += (uint16_t)20;     // version made by
+    global_header.insert(global_header.end(), local_header.begin() + 4, local_header.begin() + 30);
+    global_header += (uint16_t)0;      // file comment length
+    global_header += (uint16_t)0;      // disk number where file starts
+    global_header += (uint16_t)0;      // internal file attributes
+    global_header += (uint32_t)0;      // external file attributes
+    global_header += (uint32_t)offset; // relative offset of local file header
+    global_header += fname;
+}
+
+// the end of central directory record
+std::vector<char> zip_footer(size_t nrecs, size_t global_header_size, size_t global_header_offset) {
+    using cnpy::operator+=;
+    std::vector<char> footer;
+    footer += "PK";                           // first part of sig
+    footer += (uint16_t)0x0605;               // second part of sig
+    footer += (uint16_t)0;                    // number of this disk
+    footer += (uint16_t)0;                    // disk where footer starts
+    footer += (uint16_t)nrecs;                // number of records on this disk
+    footer += (uint16_t)nrecs;                // total number of records
+    footer += (uint32_t)global_header_size;   // nbytes of global headers
+    footer += (uint32_t)global_header_offset; // offset of start of global headers
+    footer += (uint16_t)0;                    // zip file comment length
+    return footer;
+}
+
+void cnpy::npz_save(std::string zipname, std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                    std::string mode, bool compress) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    npz_save(zipname, fname, std::vector<Segment>(1, Segment(data, nbytes)), shape, dtype, mode, compress);
+}
+
+void cnpy::npz_save(std::string zipname, std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                    std::string mode, bool compress, const SaveOptions& options) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    npz_save(zipname, fname, std::vector<Segment>(1, Segment(data, nbytes)), shape, dtype, mode, compress, options);
+}
+
+void cnpy::npz_save(std::string zipname, std::string fname, const std::vector<Segment>& segments, const Shape& shape,
+                    const DType& dtype, std::string mode, bool compress) {
+    npz_save(zipname, fname, segments, shape, dtype, mode, compress, SaveOptions());
+}
+
+// copy the first nbytes of in to out
+void copy_file_prefix(int in, int out, size_t nbytes) {
+    std::vector<char> buf(std::min<size_t>(nbytes, 1 << 20));
+    for (size_t done = 0; done < nbytes;) {
+        ssize_t n = ::pread(in, buf.data(), std::min(buf.size(), nbytes - done), done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("npz_save: failed read while copying the archive");
+        pwrite_fully(out, buf.data(), n, done);
+        done += n;
+    }
+}
+
+void cnpy::npz_save(std::string zipname, std::string fname, const std::vector<Segment>& segments, const Shape& shape,
+                    const DType& dtype, std::string mode, bool compress, const SaveOptions& options) {
+    check_segments("npz_save", segments, shape, dtype);
+    // first, append a .npy to the fname
+    fname += ".npy";
+
+    // now, on with the show
+    FILE* fp = NULL;
+    uint16_t nrecs = 0;
+    size_t global_header_offset = 0;
+    std::vector<char> global_header;
+
+    if (mode == "a") fp = fopen(zipname.c_str(), "rb");
+
+    if (fp) {
+        // zip file exists. we need to add a new npy file to it.
+        // first read the footer. this gives us the offset and size of the global header
+        // then read and store the global header.
+        // below, we will write the the new data at the start of the global header then append the global header and
+        // footer below it
+        size_t global_header_size;
+        parse_zip_footer(fp, nrecs, global_header_size, global_header_offset);
+        fseek(fp, global_header_offset, SEEK_SET);
+        global_header.resize(global_header_size);
+        size_t res = fread(&global_header[0], sizeof(char), global_header_size, fp);
+        if (res != global_header_size) {
+            fclose(fp);
+            throw std::runtime_error("npz_save: header read error while adding to existing zip");
+        }
+    }
+
+    // entries are not block aligned, so O_DIRECT does not apply. an atomic append copies the existing entries into
+    // the new file first
+    SaveOptions npz_options = options;
+    npz_options.direct = false;
+    SaveTarget target;
+    try {
+        target = open_save_target("npz_save", zipname, fp && !options.atomic ? O_RDWR : O_WRONLY | O_CREAT | O_TRUNC,
+                                  npz_options);
+        if (fp && options.atomic) copy_file_prefix(fileno(fp), target.fd, global_header_offset);
+    } catch (...) {
+        if (fp) fclose(fp);
+        abandon_save_target(target);
+        throw;
+    }
+    if (fp) fclose(fp);
+
+    std::vector<char> npy_header = create_npy_header(shape, dtype);
+    uint16_t compr_method = compress ? 8 : 0; // deflate or store
+    size_t local_header_size = 30 + fname.size();
+
+    // write the entry after room for its local header, computing the CRC (and deflating) as the data goes out. the
+    // local header is filled in afterwards, once the CRC and compressed size are known
+    int fd = target.fd;
+    uint32_t crc;
+    size_t nbytes;
+    uint32_t compr_bytes_val;
+    try {
+        SegmentWriter w(fd, global_header_offset + local_header_size, compress);
+        if (options.cache == CachePolicy::Stream) w.stream();
+        w.write(npy_header.data(), npy_header.size());
+        write_array_data(w, segments, dtype);
+        w.finish();
+        crc = w.crc;
+        nbytes = w.bytes_in;
+        compr_bytes_val = w.bytes_out;
+    } catch (...) {
+        abandon_save_target(target);
+        throw;
+    }
+
+    std::vector<char> local_header = zip_local_header(fname, crc, compr_bytes_val, nbytes, compr_method);
+    // the new entry's local header begins where the global header used to begin
+    append_zip_record(global_header, local_header, global_header_offset, fname);
+    // and the global header now starts after the newly written array
+    std::vector<char> footer =
+        zip_footer(nrecs + 1, global_header.size(), global_header_offset + compr_bytes_val + local_header.size());
+
+    // write everything
+    try {
+        pwrite_fully(fd, local_header.data(), local_header.size(), global_header_offset);
+        size_t offset = global_header_offset + local_header.size() + compr_bytes_val;
+        pwrite_fully(fd, global_header.data(), global_header.size(), offset);
+        pwrite_fully(fd, footer.data(), footer.size(), offset + global_header.size());
+    } catch (...) {
+        abandon_save_target(target);
+        throw;
+    }
+    publish_save_target("npz_save", target, options);
+}
+
+// pulls the next n bytes of an array's data into the given buffer
+typedef std::function<void(void*, size_t)> PayloadReader;
+
+// wrap read so that data in a non-native byte order is swapped a chunk at a time while it is still in cache
+PayloadReader native_order(const PayloadReader& read, const cnpy::DType& dtype) {
+    if (dtype.is_native()) return read;
+    size_t chunk = std::max<size_t>(1, (1 << 20) / dtype.size) * dtype.size;
+    return [read, dtype, chunk](void* dst, size_t nbytes) {
+        char* p = static_cast<char*>(dst);
+        for (size_t done = 0; done < nbytes; done += chunk) {
+            size_t n = std::min(chunk, nbytes - done);
+            read(p + done, n);
+            swap_bytes(p + done, n, dtype);
+        }
+    };
+}
+
+// swap the data of an array read in its stored byte order to native order in place
+void make_native(cnpy::NpyArray& arr) {
+    if (arr.dtype.is_native()) return;
+    swap_bytes(arr.data<char>(), arr.num_bytes(), arr.dtype);
+    arr.dtype = arr.dtype.native();
+}
+
+static_assert(sizeof(cnpy::float16) == 2 && sizeof(cnpy::bfloat16) == 2, "16-bit float types must be packed");
+
+void cnpy::to_float(const float16* src, float* dst, size_t n) {
+    kernels::half_to_float(reinterpret_cast<const uint16_t*>(src), dst, n);
+}
+
+void cnpy::to_float16(const float* src, float16* dst, size_t n) {
+    kernels::float_to_half(src, reinterpret_cast<uint16_t*>(dst), n);
+}
+
+void cnpy::to_float(const bfloat16* src, float* dst, size_t n) {
+    kernels::bfloat16_to_float(reinterpret_cast<const uint16_t*>(src), dst, n);
+}
+
+void cnpy::to_bfloat16(const float* src, bfloat16* dst, size_t n) {
+    kernels::float_to_bfloat16(src, reinterpret_cast<uint16_t*>(dst), n);
+}
+
+float cnpy::to_float(float16 h) {
+    float f;
+    to_float(&h, &f, 1);
+    return f;
+}
+
+cnpy::float16 cnpy::to_float16(float f) {
+    float16 h;
+    to_float16(&f, &h, 1);
+    return h;
+}
+
+float cnpy::to_float(bfloat16 b) {
+    float f;
+    to_float(&b, &f, 1);
+    return f;
+}
+
+cnpy::bfloat16 cnpy::to_bfloat16(float f) {
+    bfloat16 b;
+    to_bfloat16(&f, &b, 1);
+    return b;
+}
+
+std::string cnpy::to_utf8(const UnicodeRef& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char32_t c : s) {
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xc0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3f));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xe0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (c & 0x3f));
+        } else if (c < 0x110000) {
+            out += static_cast<char>(0xf0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            throw std::runtime_error("to_utf8: invalid code point");
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> cnpy::NpyArray::as_strings() const {
+    std::vector<std::string> out;
+    out.reserve(num_vals);
+    if (dtype.kind == 'U') {
+        NpyArray native = as_native(*this);
+        for (size_t i = 0; i < num_vals; ++i) out.push_back(to_utf8(native.unicode_at(i)));
+    } else {
+        for (size_t i = 0; i < num_vals; ++i) out.push_back(bytes_at(i).str());
+    }
+    return out;
+}
+
+// number of code points in a UTF-8 string: every byte that is not a continuation byte starts one
+size_t utf8_length(const std::string& s) {
+    size_t n = 0;
+    for (unsigned char c : s) n += (c & 0xc0) != 0x80;
+    return n;
+}
+
+// decode UTF-8 into dst, which has room for utf8_length(s) code points
+void utf8_decode(const std::string& s, char32_t* dst) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+    const unsigned char* end = p + s.size();
+    while (p < end) {
+        unsigned char c = *p++;
+        int extra = c < 0x80 ? 0 : (c & 0xe0) == 0xc0 ? 1 : (c & 0xf0) == 0xe0 ? 2 : (c & 0xf8) == 0xf0 ? 3 : -1;
+        if (extra < 0 || end - p < extra) throw std::runtime_error("pack_strings: invalid UTF-8 in " + s);
+        char32_t cp = extra == 0 ? c : c & (0x3f >> extra);
+        for (int k = 0; k < extra; ++k) {
+            if ((*p & 0xc0) != 0x80) throw std::runtime_error("pack_strings: invalid UTF-8 in " + s);
+            cp = (cp << 6) | (*p++ & 0x3f);
+        }
+        *dst++ = cp;
+    }
+}
+
+// pack_strings with a width of at least min_width characters
+std::vector<char> pack_strings(const std::vector<std::string>& strings, char kind, size_t min_width,
+                               cnpy::DType& dtype) {
+    using cnpy::DType;
+    if (kind != 'S' && kind != 'U') throw std::runtime_error("pack_strings: kind must be 'S' or 'U'");
+    // numpy never makes a zero-width string dtype
+    size_t width = std::max<size_t>(1, min_width);
+    for (const std::string& str : strings) width = std::max(width, kind == 'U' ? utf8_length(str) : str.size());
+
+    dtype = kind == 'U' ? DType('U', width * 4) : DType('S', width, '|');
+    std::vector<char> packed(strings.size() * dtype.size, 0);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        char* dst = &packed[i * dtype.size];
+        if (kind == 'U') {
+            // itemsizes are a multiple of 4, so every element of the heap buffer is char32_t aligned
+            utf8_decode(strings[i], reinterpret_cast<char32_t*>(dst));
+        } else {
+            memcpy(dst, strings[i].data(), strings[i].size());
+        }
+    }
+    return packed;
+}
+
+std::vector<char> cnpy::pack_strings(const std::vector<std::string>& strings, char kind, DType& dtype) {
+    return ::pack_strings(strings, kind, 1, dtype);
+}
+
+void cnpy::npy_save(std::string fname, const std::vector<std::string>& strings, std::string mode, char kind) {
+    // when appending, pad to the width already in the file so that shorter strings can be added
+    size_t min_width = 1;
+    FILE* fp = mode == "a" ? fopen(fname.c_str(), "rb") : NULL;
+    if (fp) {
+        DType stored;
+        Shape shape;
+        bool fortran_order;
+        try {
+            parse_npy_header(fp, stored, shape, fortran_order);
+        } catch (...) {
+            fclose(fp);
+            throw;
+        }
+        fclose(fp);
+        if (stored.kind == kind) min_width = kind == 'U' ? stored.size / 4 : stored.size;
+    }
+    DType dtype;
+    std::vector<char> packed = ::pack_strings(strings, kind, min_width, dtype);
+    npy_save(fname, packed.data(), {strings.size()}, dtype, mode);
+}
+
+void cnpy::npz_save(std::string zipname, std::string fname, const std::vector<std::string>& strings,
+                    std::string mode, bool compress, char kind) {
+    DType dtype;
+    std::vector<char> packed = pack_strings(strings, kind, dtype);
+    npz_save(zipname, fname, packed.data(), {strings.size()}, dtype, mode, compress);
+}
+
+// check that an array of a sparse matrix is 1-d with n elements (any n if n is -1), and of an index dtype if index
+void check_sparse_array(const cnpy::NpyArray& arr, const std::string& name, int64_t n, bool index) {
+    if (arr.shape.size() != 1) throw std::runtime_error("sparse: " + name + " must be 1-d");
+    if (n >= 0 && arr.num_vals != static_cast<size_t>(n))
+        throw std::runtime_error("sparse: " + name + " has " + std::to_string(arr.num_vals) + " elements, expected " +
+                                 std::to_string(n));
+    if (index && (arr.dtype.kind != 'i' || (arr.dtype.size != 4 && arr.dtype.size != 8) || !arr.dtype.is_native()))
+        throw std::runtime_error("sparse: " + name + " must hold int32 or int64, not " + arr.dtype.str());
+    if (!index && arr.dtype.kind == '?') throw std::runtime_error("sparse: " + name + " has no dtype");
+}
+
+void check_sparse(const cnpy::SparseMatrix& m) {
+    using cnpy::SparseMatrix;
+    check_sparse_array(m.data, "data", -1, false);
+    int64_t nnz = m.nnz();
+    if (m.format == "csr" || m.format == "csc") {
+        size_t major = m.format == "csr" ? m.rows : m.cols;
+        check_sparse_array(m.indices, "indices", nnz, true);
+        check_sparse_array(m.indptr, "indptr", major + 1, true);
+        if (SparseMatrix::index_at(m.indptr, 0) != 0 || SparseMatrix::index_at(m.indptr, major) != nnz)
+            throw std::runtime_error("sparse: indptr does not span the " + std::to_string(nnz) + " stored values");
+    } else if (m.format == "coo") {
+        check_sparse_array(m.row, "row", nnz, true);
+        check_sparse_array(m.col, "col", nnz, true);
+    } else {
+        throw std::runtime_error("sparse: unsupported format '" + m.format + "'");
+    }
+}
+
+// the entry called name of a sparse .npz, swapped to native order
+cnpy::NpyArray sparse_entry(cnpy::npz_t& npz, const std::string& fname, const std::string& name) {
+    cnpy::npz_t::iterator it = npz.find(name);
+    if (it == npz.end()) throw std::runtime_error("sparse_load: " + fname + " has no " + name + " entry");
+    return cnpy::as_native(it->second);
+}
+
+cnpy::SparseMatrix cnpy::sparse_load(std::string fname, bool use_mmap) {
+    npz_t npz = npz_load(fname, use_mmap);
+    SparseMatrix m;
+    NpyArray format = sparse_entry(npz, fname, "format");
+    if (format.num_vals != 1 || (format.dtype.kind != 'S' && format.dtype.kind != 'U'))
+        throw std::runtime_error("sparse_load: format of " + fname + " is not a string");
+    m.format = format.as_strings()[0];
+
+    NpyArray shape = sparse_entry(npz, fname, "shape");
+    check_sparse_array(shape, "shape", 2, true);
+    m.rows = static_cast<size_t>(SparseMatrix::index_at(shape, 0));
+    m.cols = static_cast<size_t>(SparseMatrix::index_at(shape, 1));
+
+    m.data = sparse_entry(npz, fname, "data");
+    if (m.format == "coo") {
+        m.row = sparse_entry(npz, fname, "row");
+        m.col = sparse_entry(npz, fname, "col");
+    } else if (m.format == "csr" || m.format == "csc") {
+        m.indices = sparse_entry(npz, fname, "indices");
+        m.indptr = sparse_entry(npz, fname, "indptr");
+    }
+    check_sparse(m);
+    return m;
+}
+
+void cnpy::sparse_save(std::string fname, const SparseMatrix& m, bool compress) {
+    check_sparse(m);
+    // the entries in the order save_npz writes them
+    std::vector<std::pair<std::string, const NpyArray*>> arrays;
+    if (m.format == "coo") {
+        arrays.push_back(std::make_pair("row", &m.row));
+        arrays.push_back(std::make_pair("col", &m.col));
+    } else {
+        arrays.push_back(std::make_pair("indices", &m.indices));
+        arrays.push_back(std::make_pair("indptr", &m.indptr));
+    }
+    std::string mode = "w";
+    for (size_t i = 0; i < arrays.size(); ++i) {
+        const NpyArray& arr = *arrays[i].second;
+        npz_save(fname, arrays[i].first, arr.data<char>(), arr.shape, arr.dtype, mode, compress);
+        mode = "a";
+    }
+    // scipy stores the format as a 0-d bytes array and the shape as int64
+    npz_save(fname, "format", m.format.data(), Shape(), DType('S', m.format.size(), '|'), mode, compress);
+    int64_t shape[2] = {static_cast<int64_t>(m.rows), static_cast<int64_t>(m.cols)};
+    npz_save(fname, "shape", shape, {2}, mode, compress);
+    npz_save(fname, "data", m.data.data<char>(), m.data.shape, m.data.dtype, mode, compress);
+}
+
+cnpy::NpyArray cnpy::gather_field(const NpyArray& arr, const std::string& name) {
+    const Field& f = arr.dtype.field(name);
+    if (arr.fortran_order && !f.shape.empty())
+        throw std::runtime_error("gather_field: subarray fields of Fortran-ordered arrays are not supported");
+    Shape shape(arr.shape);
+    shape.insert(shape.end(), f.shape.begin(), f.shape.end());
+    NpyArray column(shape, f.dtype, arr.fortran_order);
+    cnpy::kernels::gather(arr.data<char>() + f.offset, arr.dtype.size, f.num_bytes(), column.data<char>(),
+                          arr.num_vals);
+    make_native(column);
+    return column;
+}
+
+cnpy::NpyArray cnpy::as_native(const NpyArray& arr) {
+    if (arr.dtype.is_native()) return arr;
+    NpyArray copy(arr.shape, arr.dtype, arr.fortran_order);
+    memcpy(copy.data<char>(), arr.data<char>(), arr.num_bytes());
+    make_native(copy);
+    return copy;
+}
+
+// read the data following a parsed header into a new array. when the requested order differs from the stored one
+// the data is staged through a bounce buffer a few megabytes at a time and each chunk is transposed into place
+cnpy::NpyArray read_payload(const PayloadReader& stored_read, const cnpy::Shape& shape, const cnpy::DType& dtype,
+                            bool fortran_order, cnpy::MemoryOrder order) {
+    PayloadReader read = native_order(stored_read, dtype);
+    bool want_fortran = order == cnpy::MemoryOrder::AsStored ? fortran_order : order == cnpy::MemoryOrder::Fortran;
+    cnpy::NpyArray arr(shape, dtype.native(), want_fortran);
+    if (want_fortran == fortran_order || shape.size() < 2) {
+        read(arr.data<char>(), arr.num_bytes());
+        return arr;
+    }
+    if (arr.num_bytes() == 0) return arr;
+
+    // the kernel works on the stored layout viewed as a C-order array, slowest axis first
+    cnpy::Shape storage_shape(shape);
+    if (fortran_order) std::reverse(storage_shape.begin(), storage_shape.end());
+    size_t row_bytes = arr.num_bytes() / storage_shape[0];
+    size_t rows_per_chunk = std::max<size_t>(1, (8 << 20) / row_bytes);
+    std::vector<char> bounce(std::min(rows_per_chunk, storage_shape[0]) * row_bytes);
+
+    for (size_t row = 0; row < storage_shape[0]; row += rows_per_chunk) {
+        size_t row_end = std::min(row + rows_per_chunk, storage_shape[0]);
+        read(&bounce[0], (row_end - row) * row_bytes);
+        cnpy::kernels::reverse_axes(&bounce[0], arr.data<char>(), storage_shape, row, row_end, dtype.size);
+    }
+    return arr;
+}
+
+cnpy::NpyArray load_the_npy_file(FILE* fp, cnpy::MemoryOrder order = cnpy::MemoryOrder::AsStored) {
+    cnpy::Shape shape;
+    cnpy::DType dtype;
+    bool fortran_order;
+    cnpy::parse_npy_header(fp, dtype, shape, fortran_order);
+
+    return read_payload(
+        [fp](void* dst, size_t nbytes) {
+            size_t nread = fread(dst, 1, nbytes, fp);
+            if (nread != nbytes) throw std::runtime_error("load_the_npy_file: failed fread");
+        },
+        shape, dtype, fortran_order, order);
+}
+
+// Incrementally inflates a raw-deflated zip entry, pulling the compressed input from fp or a source in fixed-size
+// chunks (or straight from memory) so that each part of the output can be written straight to where it belongs
+class InflateReader {
+  public:
+    InflateReader(FILE* fp, size_t compr_bytes)
+        : fp_(fp), mem_(nullptr), source_(nullptr), offset_(0), remaining_(compr_bytes), in_(1 << 16) {
+        init();
+    }
+
+    // inflate an entry that is already in memory, without copying its compressed bytes
+    InflateReader(const unsigned char* data, size_t compr_bytes)
+        : fp_(nullptr), mem_(data), source_(nullptr), offset_(0), remaining_(compr_bytes) {
+        init();
+    }
+
+    // inflate the entry at offset in source with ranged reads
+    InflateReader(const cnpy::Source& source, size_t offset, size_t compr_bytes)
+        : fp_(nullptr), mem_(nullptr), source_(&source), offset_(offset), remaining_(compr_bytes), in_(1 << 16) {
+        init();
+    }
+    ~InflateReader() { inflateEnd(&strm_); }
+
+    InflateReader(const InflateReader&) = delete;
+    InflateReader& operator=(const InflateReader&) = delete;
+
+    // inflate exactly nbytes into out
+    void read(void* out, size_t nbytes) {
+        strm_.next_out = static_cast<Bytef*>(out);
+        while (nbytes > 0) {
+            uInt chunk = static_cast<uInt>(std::min<size_t>(nbytes, 1u << 30));
+            strm_.avail_out = chunk;
+            while (strm_.avail_out > 0) {
+                if (strm_.avail_in == 0) refill();
+                int err = inflate(&strm_, Z_NO_FLUSH);
+                if (err == Z_STREAM_END && strm_.avail_out > 0)
+                    throw std::runtime_error("InflateReader: compressed entry ended early");
+                if (err != Z_OK && err != Z_STREAM_END) throw std::runtime_error("InflateReader: inflate failed");
+            }
+            nbytes -= chunk;
+        }
+    }
+
+    // parse the .npy header at the start of the inflated stream, returning its size in bytes
+    size_t read_npy_header(cnpy::DType& dtype, cnpy::Shape& shape, bool& fortran_order) {
+        std::vector<unsigned char> header(10);
+        read(&header[0], 10);
+        uint16_t header_len = *reinterpret_cast<uint16_t*>(&header[8]);
+        header.resize(10 + header_len);
+        read(&header[10], header_len);
+        cnpy::parse_npy_header(const_cast<const unsigned char*>(&header[0]), dtype, shape, fortran_order);
+        return header.size();
+    }
+
+    // inflate and discard nbytes
+    void skip(size_t nbytes) {
+        std::vector<unsigned char> scratch(std::min<size_t>(nbytes, 1 << 16));
+        while (nbytes > 0) {
+            size_t n = std::min(nbytes, scratch.size());
+            read(&scratch[0], n);
+            nbytes -= n;
+        }
+    }
+
+    // resume inflating mid-stream: feed the bits left over from the previous byte and preset the window
+    void resume(int bits, int value, const std::vector<unsigned char>& window) {
+        if (bits && inflatePrime(&strm_, bits, value >> (8 - bits)) != Z_OK)
+            throw std::runtime_error("InflateReader: inflatePrime failed");
+        if (!window.empty() && inflateSetDictionary(&strm_, &window[0], static_cast<uInt>(window.size())) != Z_OK)
+            throw std::runtime_error("InflateReader: inflateSetDictionary failed");
+    }
+
+    // leave fp at the end of the compressed entry
+    void skip_rest() {
+        if (remaining_ > 0 && fp_) fseek(fp_, remaining_, SEEK_CUR);
+        remaining_ = 0;
+    }
+
+  private:
+    void init() {
+        strm_.zalloc = Z_NULL;
+        strm_.zfree = Z_NULL;
+        strm_.opaque = Z_NULL;
+        strm_.avail_in = 0;
+        strm_.next_in = Z_NULL;
+        if (inflateInit2(&strm_, -MAX_WBITS) != Z_OK) throw std::runtime_error("InflateReader: inflateInit2 failed");
+    }
+
+    void refill() {
+        if (remaining_ == 0) throw std::runtime_error("InflateReader: compressed entry truncated");
+        if (mem_) {
+            // zlib lengths are 32-bit
+            size_t n = std::min<size_t>(remaining_, 1u << 30);
+            strm_.next_in = const_cast<unsigned char*>(mem_);
+            strm_.avail_in = static_cast<uInt>(n);
+            mem_ += n;
+            remaining_ -= n;
+            return;
+        }
+        size_t n = std::min(remaining_, in_.size());
+        if (source_) {
+            source_->read_at(&in_[0], n, offset_);
+            offset_ += n;
+        } else if (fread(&in_[0], 1, n, fp_) != n) {
+            throw std::runtime_error("InflateReader: failed fread");
+        }
+        remaining_ -= n;
+        strm_.next_in = &in_[0];
+        strm_.avail_in = static_cast<uInt>(n);
+    }
+
+    FILE* fp_;
+    const unsigned char* mem_;
+    const cnpy::Source* source_;
+    size_t offset_; // of the next read from source_
+    size_t remaining_;
+    std::vector<unsigned char> in_;
+    z_stream strm_;
+};
+
+// inflate the .npy held by a deflated entry, whose uncompressed size is uncompr_bytes
+cnpy::NpyArray inflate_npy(InflateReader& reader, uint32_t uncompr_bytes, cnpy::MemoryOrder order) {
+    cnpy::Shape shape;
+    cnpy::DType dtype;
+    bool fortran_order;
+    size_t header_bytes = reader.read_npy_header(dtype, shape, fortran_order);
+
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    if (header_bytes + nbytes > uncompr_bytes)
+        throw std::runtime_error("load_the_npz_array: entry smaller than its header");
+    return read_payload([&reader](void* dst, size_t n) { reader.read(dst, n); }, shape, dtype, fortran_order, order);
+}
+
+cnpy::NpyArray load_the_npz_array(FILE* fp, uint32_t compr_bytes, uint32_t uncompr_bytes,
+                                  cnpy::MemoryOrder order = cnpy::MemoryOrder::AsStored) {
+    InflateReader reader(fp, compr_bytes);
+    cnpy::NpyArray array = inflate_npy(reader, uncompr_bytes, order);
+    reader.skip_rest();
+    return array;
+}
+
+// check a header parsed by one of the *_load_into functions before anything is written to the caller's buffer
+void check_load_into(const std::string& what, const cnpy::Shape& shape, const cnpy::DType& dtype, size_t capacity,
+                     const cnpy::Shape* expected_shape, const cnpy::DType* expected_dtype) {
+    if (expected_shape && shape != *expected_shape)
+        throw std::runtime_error("load_into: " + what + " does not have the expected shape");
+    if (expected_dtype && (dtype.kind != expected_dtype->kind || dtype.size != expected_dtype->size))
+        throw std::runtime_error("load_into: " + what + " has dtype " + dtype.str() + ", expected " +
+                                 expected_dtype->str());
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    if (nbytes > capacity)
+        throw std::runtime_error("load_into: " + what + " needs " + std::to_string(nbytes) +
+                                 " bytes but the buffer holds " + std::to_string(capacity));
+}
+
+// position fp at the data of entry varname of an open .npz, returning false if there is no such entry
+bool find_npz_entry(FILE* fp, const std::string& varname, uint16_t& compr_method, uint32_t& compr_bytes,
+                    uint32_t& uncompr_bytes) {
+    while (1) {
+        unsigned char local_header[30];
+        size_t header_res = fread(local_header, sizeof(char), 30, fp);
+        if (header_res != 30) throw std::runtime_error("npz_load: failed fread");
+
+        // if we've reached the global header, stop reading
+        ZipLocalHeader header;
+        if (!decode_zip_local_header(local_header, header)) return false;
+
+        // read in the variable name
+        std::string vname(header.name_len, ' ');
+        size_t vname_res = fread(&vname[0], sizeof(char), header.name_len, fp);
+        if (vname_res != header.name_len) throw std::runtime_error("npz_load: failed fread");
+        vname.erase(vname.end() - 4, vname.end()); // erase the lagging .npy
+
+        fseek(fp, header.extra_len, SEEK_CUR); // skip past the extra field
+
+        compr_method = header.compr_method;
+        compr_bytes = header.compr_bytes;
+        uncompr_bytes = header.uncompr_bytes;
+
+        if (vname == varname) return true;
+
+        // skip past the (possibly compressed) data
+        fseek(fp, compr_bytes, SEEK_CUR);
+    }
+}
+
+// Helper to memory-map a .npy array within a .npz file
+cnpy::NpyArray load_the_npy_mmap(FILE* fp) {
+    long data_pos = ftell(fp);
+    auto mmap_file = std::make_shared<cnpy::MMapFile>(fileno(fp), "rw");
+    unsigned char* buffer = reinterpret_cast<unsigned char*>(const_cast<char*>(mmap_file->data()));
+    cnpy::DType dtype;
+    cnpy::Shape shape;
+    bool fortran_order;
+    cnpy::parse_npy_header(buffer + data_pos, dtype, shape, fortran_order);
+    uint16_t header_len = *reinterpret_cast<uint16_t*>(buffer + data_pos + 8);
+    size_t data_offset = data_pos + 10 + header_len;
+    cnpy::NpyArray arr(shape, dtype.size, fortran_order, mmap_file, data_offset);
+    arr.dtype = dtype;
+    return arr;
+}
+
+static cnpy::npz_t load_all_npz(const std::string& fname, const cnpy::LoadOptions& options) {
+    bool use_mmap = options.mmap;
+    cnpy::MemoryOrder order = options.order;
+    FILE* fp = fopen(fname.c_str(), use_mmap ? "rb+" : "rb");
+
+    if (!fp) {
+        throw std::runtime_error("npz_load: Error! Unable to open file " + fname + "!");
+    }
+    advise_read(fileno(fp), options.cache);
+
+    cnpy::npz_t arrays;
+
+    try {
+        while (1) {
+            unsigned char local_header[30];
+            size_t headerres = fread(local_header, sizeof(char), 30, fp);
+            if (headerres != 30) throw std::runtime_error("npz_load: failed fread");
+
+            // if we've reached the global header, stop reading
+            ZipLocalHeader header;
+            if (!decode_zip_local_header(local_header, header)) break;
+
+            // read in the variable name
+            std::string varname(header.name_len, ' ');
+            size_t vname_res = fread(&varname[0], sizeof(char), header.name_len, fp);
+            if (vname_res != header.name_len) throw std::runtime_error("npz_load: failed fread");
+
+            // erase the lagging .npy
+            varname.erase(varname.end() - 4, varname.end());
+
+            // read in the extra field
+            if (header.extra_len > 0) {
+                std::vector<char> buff(header.extra_len);
+                size_t efield_res = fread(&buff[0], sizeof(char), header.extra_len, fp);
+                if (efield_res != header.extra_len) throw std::runtime_error("npz_load: failed fread");
+            }
+
+            uint16_t compr_method = header.compr_method;
+            uint32_t compr_bytes = header.compr_bytes;
+            uint32_t uncompr_bytes = header.uncompr_bytes;
+
+            if (compr_method == 0) {
+                if (use_mmap) {
+                    arrays[varname] = load_the_npy_mmap(fp);
+                    // skip mmap data to advance file pointer past this entry
+                    fseek(fp, uncompr_bytes, SEEK_CUR);
+                } else {
+                    arrays[varname] = load_the_npy_file(fp, order);
+                }
+            } else {
+                if (use_mmap) {
+                    std::cerr << "Warning: npz_load: memory map requested but file '" << fname << "' entry '" << varname
+                              << "' is compressed; falling back to memory load" << std::endl;
+                }
+                arrays[varname] = load_the_npz_array(fp, compr_bytes, uncompr_bytes, order);
+            }
+        }
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+
+    release_read(fileno(fp), options.cache);
+    fclose(fp);
+    return arrays;
+}
+
+cnpy::npz_t cnpy::npz_load(std::string fname, const LoadOptions& options) { return load_all_npz(fname, options); }
+
+cnpy::npz_t cnpy::npz_load(std::string fname, bool use_mmap) {
+    LoadOptions options;
+    options.mmap = use_mmap;
+    return npz_load(fname, options);
+}
+
+cnpy::npz_t cnpy::npz_load(std::string fname, MemoryOrder order) {
+    LoadOptions options;
+    options.order = order;
+    return npz_load(fname, options);
+}
+
+cnpy::npz_t cnpy::npz_load(std::string fname, CachePolicy cache) {
+    LoadOptions options;
+    options.cache = cache;
+    return npz_load(fname, options);
+}
+
+static cnpy::NpyArray load_one_npz(const std::string& fname, const std::string& varname,
+                                   const cnpy::LoadOptions& options) {
+    bool use_mmap = options.mmap;
+    cnpy::MemoryOrder order = options.order;
+    FILE* fp = fopen(fname.c_str(), use_mmap ? "rb+" : "rb");
+
+    if (!fp) throw std::runtime_error("npz_load: Unable to open file " + fname);
+    advise_read(fileno(fp), options.cache);
+
+    uint16_t compr_method;
+    uint32_t compr_bytes, uncompr_bytes;
+    bool found;
+    try {
+        found = find_npz_entry(fp, varname, compr_method, compr_bytes, uncompr_bytes);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+
+    if (!found) {
+        fclose(fp);
+        // if we get here, we haven't found the variable in the file
+        throw std::runtime_error("npz_load: Variable name " + varname + " not found in " + fname);
+    }
+
+    cnpy::NpyArray array;
+    try {
+        if (use_mmap && compr_method == 0) {
+            array = load_the_npy_mmap(fp);
+        } else if (compr_method == 0) {
+            array = load_the_npy_file(fp, order);
+        } else {
+            if (use_mmap) {
+                std::cerr << "Warning: npz_load: memory map requested but file '" << fname << "' entry '" << varname
+                          << "' is compressed; falling back to memory load" << std::endl;
+            }
+            array = load_the_npz_array(fp, compr_bytes, uncompr_bytes, order);
+        }
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+    release_read(fileno(fp), options.cache);
+    fclose(fp);
+    return array;
+}
+
+cnpy::NpyArray cnpy::npz_load(std::string fname, std::string varname, const LoadOptions& options) {
+    return load_one_npz(fname, varname, options);
+}
+
+cnpy::NpyArray cnpy::npz_load(std::string fname, std::string varname, bool use_mmap) {
+    LoadOptions options;
+    options.mmap = use_mmap;
+    return npz_load(fname, varname, options);
+}
+
+cnpy::NpyArray cnpy::npz_load(std::string fname, std::string varname, MemoryOrder order) {
+    LoadOptions options;
+    options.order = order;
+    return npz_load(fname, varname, options);
+}
+
+cnpy::NpyArray cnpy::npz_load(std::string fname, std::string varname, CachePolicy cache) {
+    LoadOptions options;
+    options.cache = cache;
+    return npz_load(fname, varname, options);
+}
+
+cnpy::NpyArray cnpy::npz_load(std::string fname, const char* varname, bool use_mmap) {
+    return npz_load(fname, std::string(varname), use_mmap);
+}
+
+// a view of the .npy held in [data, data + size), or a native-order copy if it is stored byte-swapped
+cnpy::NpyArray view_npy(const unsigned char* data, size_t size, const std::shared_ptr<const void>& owner,
+                        const std::string& what) {
+    if (size < 10 || memcmp(data, "\x93NUMPY", 6) != 0) throw std::runtime_error(what + ": not an .npy");
+    uint16_t header_len;
+    memcpy(&header_len, data + 8, 2);
+    if (10 + static_cast<size_t>(header_len) > size) throw std::runtime_error(what + ": truncated .npy header");
+    cnpy::DType dtype;
+    cnpy::Shape shape;
+    bool fortran_order;
+    cnpy::parse_npy_header(data, dtype, shape, fortran_order);
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    if (nbytes > size - 10 - header_len) throw std::runtime_error(what + ": truncated .npy data");
+
+    cnpy::NpyArray view(shape, dtype.size, fortran_order, const_cast<unsigned char*>(data) + 10 + header_len);
+    view.dtype = dtype;
+    view.owner = owner;
+    return cnpy::as_native(view);
+}
+
+cnpy::NpyArray cnpy::npy_load_buffer(const void* data, size_t size, std::shared_ptr<const void> owner) {
+    return npy_load(std::make_shared<MemorySource>(data, size, owner));
+}
+
+cnpy::npz_t cnpy::npz_load_buffer(const void* data, size_t size, std::shared_ptr<const void> owner) {
+    return npz_load(std::make_shared<MemorySource>(data, size, owner));
+}
+
+cnpy::NpyArray cnpy::npz_load_buffer(const void* data, size_t size, std::string varname,
+                                     std::shared_ptr<const void> owner) {
+    return npz_load(std::make_shared<MemorySource>(data, size, owner), varname);
+}
+
+cnpy::NpyArray cnpy::npy_load(std::string fname, const LoadOptions& options) {
+    if (options.mmap) {
+#ifdef __unix__
+        // Open and memory-map the file (read-write mode)
+        std::shared_ptr<MMapFile> mmap_file = std::make_shared<MMapFile>(fname, "rw");
+        // Obtain raw pointer to the mapped region
+        unsigned char* buffer = reinterpret_cast<unsigned char*>(const_cast<char*>(mmap_file->data()));
+        // Parse the header from the mapped memory
+        DType dtype;
+        Shape shape;
+        bool fortran_order;
+        cnpy::parse_npy_header(const_cast<const unsigned char*>(buffer), dtype, shape, fortran_order);
+        // Header length is stored at offset 8 (little-endian uint16)
+        uint16_t header_len = *reinterpret_cast<uint16_t*>(buffer + 8);
+        size_t data_offset = 10 + header_len; // 10 bytes before header data
+        // Construct an NpyArray that references the mmap region
+        cnpy::NpyArray arr(shape, dtype.size, fortran_order, mmap_file, data_offset);
+        arr.dtype = dtype;
+        return arr;
+#else
+        std::cerr << "mmap not supported – fallback to regular load" << std::endl;
+#endif
+    }
+
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("npy_load: Unable to open file " + fname);
+    advise_read(fileno(fp), options.cache);
+    NpyArray arr;
+    try {
+        arr = load_the_npy_file(fp, options.order);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+    release_read(fileno(fp), options.cache);
+    fclose(fp);
+    return arr;
+}
+
+cnpy::NpyArray cnpy::npy_load(std::string fname, MemoryOrder order) {
+    LoadOptions options;
+    options.order = order;
+    return npy_load(fname, options);
+}
+
+cnpy::NpyArray cnpy::npy_load(std::string fname, CachePolicy cache) {
+    LoadOptions options;
+    options.cache = cache;
+    return npy_load(fname, options);
+}
+
+cnpy::NpyArray cnpy::npy_load(std::string fname, bool use_mmap) {
+    LoadOptions options;
+    options.mmap = use_mmap;
+    return npy_load(fname, options);
+}
+
+cnpy::NpyArray load_npy_into(const std::string& fname, void* dst, size_t capacity, const cnpy::Shape* expected_shape,
+                             const cnpy::DType* expected_dtype) {
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("npy_load_into: Unable to open file " + fname);
+
+    cnpy::Shape shape;
+    cnpy::DType dtype;
+    bool fortran_order;
+    try {
+        cnpy::parse_npy_header(fp, dtype, shape, fortran_order);
+        check_load_into(fname, shape, dtype, capacity, expected_shape, expected_dtype);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+
+    cnpy::NpyArray arr(shape, dtype.size, fortran_order, dst);
+    arr.dtype = dtype;
+    size_t nread = fread(dst, 1, arr.num_bytes(), fp);
+    fclose(fp);
+    if (nread != arr.num_bytes()) throw std::runtime_error("npy_load_into: failed fread");
+    make_native(arr);
+    return arr;
+}
+
+cnpy::NpyArray cnpy::npy_load_into(std::string fname, void* dst, size_t capacity) {
+    return load_npy_into(fname, dst, capacity, nullptr, nullptr);
+}
+
+cnpy::NpyArray cnpy::npy_load_into(std::string fname, void* dst, size_t capacity, const Shape& shape,
+                                   const DType& dtype) {
+    return load_npy_into(fname, dst, capacity, &shape, &dtype);
+}
+
+cnpy::NpyArray load_npz_into(const std::string& fname, const std::string& varname, void* dst, size_t capacity,
+                             const cnpy::Shape* expected_shape, const cnpy::DType* expected_dtype) {
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("npz_load_into: Unable to open file " + fname);
+
+    try {
+        uint16_t compr_method;
+        uint32_t compr_bytes, uncompr_bytes;
+        if (!find_npz_entry(fp, varname, compr_method, compr_bytes, uncompr_bytes))
+            throw std::runtime_error("npz_load_into: Variable name " + varname + " not found in " + fname);
+
+        cnpy::Shape shape;
+        cnpy::DType dtype;
+        bool fortran_order;
+        if (compr_method == 0) {
+            cnpy::parse_npy_header(fp, dtype, shape, fortran_order);
+            check_load_into(fname + ":" + varname, shape, dtype, capacity, expected_shape, expected_dtype);
+            cnpy::NpyArray arr(shape, dtype.size, fortran_order, dst);
+            arr.dtype = dtype;
+            if (fread(dst, 1, arr.num_bytes(), fp) != arr.num_bytes())
+                throw std::runtime_error("npz_load_into: failed fread");
+            fclose(fp);
+            make_native(arr);
+            return arr;
+        }
+
+        InflateReader reader(fp, compr_bytes);
+        reader.read_npy_header(dtype, shape, fortran_order);
+        check_load_into(fname + ":" + varname, shape, dtype, capacity, expected_shape, expected_dtype);
+        cnpy::NpyArray arr(shape, dtype.size, fortran_order, dst);
+        arr.dtype = dtype;
+        reader.read(dst, arr.num_bytes());
+        fclose(fp);
+        make_native(arr);
+        return arr;
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+}
+
+cnpy::NpyArray cnpy::npz_load_into(std::string fname, std::string varname, void* dst, size_t capacity) {
+    return load_npz_into(fname, varname, dst, capacity, nullptr, nullptr);
+}
+
+cnpy::NpyArray cnpy::npz_load_into(std::string fname, std::string varname, void* dst, size_t capacity,
+                                   const Shape& shape, const DType& dtype) {
+    return load_npz_into(fname, varname, dst, capacity, &shape, &dtype);
+}
+
+// read the data following a parsed header into a new array of the requested dtype, converting a few megabytes at a
+// time from a bounce buffer so that the source type never exists in memory at full size
+cnpy::NpyArray read_converted(const PayloadReader& stored_read, const cnpy::Shape& shape, const cnpy::DType& dtype,
+                              bool fortran_order, const cnpy::DType& want) {
+    PayloadReader read = native_order(stored_read, dtype);
+    cnpy::NpyArray arr(shape, want.native(), fortran_order);
+    if (dtype.kind == want.kind && dtype.size == want.size) {
+        read(arr.data<char>(), arr.num_bytes());
+        return arr;
+    }
+    if (!cnpy::kernels::can_convert(dtype.kind, dtype.size) || !cnpy::kernels::can_convert(want.kind, want.size))
+        throw std::runtime_error("load_as: cannot convert from dtype " + dtype.str() + " to " + want.str());
+
+    size_t chunk = std::max<size_t>(1, (4 << 20) / dtype.size);
+    std::vector<char> bounce(std::min(chunk, arr.num_vals) * dtype.size);
+    char* out = arr.data<char>();
+    for (size_t done = 0; done < arr.num_vals; done += chunk) {
+        size_t n = std::min(chunk, arr.num_vals - done);
+        read(&bounce[0], n * dtype.size);
+        cnpy::kernels::convert(&bounce[0], dtype.kind, dtype.size, out + done * want.size, want.kind, want.size, n);
+    }
+    return arr;
+}
+
+cnpy::NpyArray cnpy::npy_load_as(std::string fname, const DType& dtype) {
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("npy_load_as: Unable to open file " + fname);
+
+    try {
+        Shape shape;
+        DType stored;
+        bool fortran_order;
+        parse_npy_header(fp, stored, shape, fortran_order);
+        NpyArray arr = read_converted(
+            [fp](void* dst, size_t nbytes) {
+                if (fread(dst, 1, nbytes, fp) != nbytes) throw std::runtime_error("npy_load_as: failed fread");
+            },
+            shape, stored, fortran_order, dtype);
+        fclose(fp);
+        return arr;
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+}
+
+cnpy::NpyArray cnpy::npz_load_as(std::string fname, std::string varname, const DType& dtype) {
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("npz_load_as: Unable to open file " + fname);
+
+    try {
+        uint16_t compr_method;
+        uint32_t compr_bytes, uncompr_bytes;
+        if (!find_npz_entry(fp, varname, compr_method, compr_bytes, uncompr_bytes))
+            throw std::runtime_error("npz_load_as: Variable name " + varname + " not found in " + fname);
+
+        Shape shape;
+        DType stored;
+        bool fortran_order;
+        NpyArray arr;
+        if (compr_method == 0) {
+            parse_npy_header(fp, stored, shape, fortran_order);
+            arr = read_converted(
+                [fp](void* dst, size_t nbytes) {
+                    if (fread(dst, 1, nbytes, fp) != nbytes) throw std::runtime_error("npz_load_as: failed fread");
+                },
+                shape, stored, fortran_order, dtype);
+        } else {
+            InflateReader reader(fp, compr_bytes);
+            reader.read_npy_header(stored, shape, fortran_order);
+            arr = read_converted([&reader](void* dst, size_t n) { reader.read(dst, n); }, shape, stored,
+                                 fortran_order, dtype);
+        }
+        fclose(fp);
+        return arr;
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+}
+
+// read exactly nbytes at offset from fd, retrying short reads
+void pread_fully(int fd, void* dst, size_t nbytes, size_t offset) {
+    char* p = static_cast<char*>(dst);
+    while (nbytes > 0) {
+        ssize_t n = ::pread(fd, p, nbytes, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("pread_fully: failed pread");
+        p += n;
+        offset += n;
+        nbytes -= n;
+    }
+}
+
+cnpy::NpyArray cnpy::npy_load_slice(std::string fname, const std::vector<Slice>& selection) {
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("npy_load_slice: Unable to open file " + fname);
+
+    Shape shape;
+    DType dtype;
+    bool fortran_order;
+    try {
+        parse_npy_header(fp, dtype, shape, fortran_order);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+    size_t data_offset = ftell(fp);
+    size_t ndims = shape.size();
+    if (selection.size() > ndims) {
+        fclose(fp);
+        throw std::runtime_error("npy_load_slice: more slices than dimensions in " + fname);
+    }
+
+    // describe the selection in storage order, slowest axis first
+    std::vector<size_t> dims(ndims), start(ndims), step(ndims), count(ndims);
+    Shape out_shape(ndims);
+    for (size_t axis = 0; axis < ndims; ++axis) {
+        Slice sl = axis < selection.size() ? selection[axis] : Slice::all();
+        if (sl.step == 0) {
+            fclose(fp);
+            throw std::runtime_error("npy_load_slice: slice step must be positive");
+        }
+        size_t stop = std::min(sl.stop, shape[axis]);
+        size_t n = sl.start < stop ? (stop - sl.start + sl.step - 1) / sl.step : 0;
+        size_t k = fortran_order ? ndims - 1 - axis : axis;
+        dims[k] = shape[axis];
+        start[k] = sl.start;
+        step[k] = sl.step;
+        count[k] = n;
+        out_shape[axis] = n;
+    }
+
+    size_t word_size = dtype.size;
+    NpyArray arr(out_shape, dtype, fortran_order);
+    if (arr.num_bytes() == 0) {
+        fclose(fp);
+        arr.dtype = dtype.native();
+        return arr;
+    }
+
+    std::vector<size_t> stride(ndims);
+    for (size_t k = ndims, s = word_size; k-- > 0; s *= dims[k]) stride[k] = s;
+
+    // the innermost axes covered by one contiguous read: whole axes, plus at most one partial unit-step axis
+    size_t run = word_size;
+    size_t nouter = ndims;
+    while (nouter > 0 && step[nouter - 1] == 1) {
+        --nouter;
+        run *= count[nouter];
+        if (count[nouter] != dims[nouter]) break;
+    }
+    size_t base = data_offset;
+    for (size_t k = nouter; k < ndims; ++k) base += start[k] * stride[k];
+
+    // walk the outer axes like an odometer, merging runs that happen to be adjacent on disk
+    int fd = fileno(fp);
+    char* out = arr.data<char>();
+    std::vector<size_t> idx(nouter, 0);
+    size_t pending_offset = 0, pending_len = 0;
+    try {
+        while (1) {
+            size_t offset = base;
+            for (size_t k = 0; k < nouter; ++k) offset += (start[k] + idx[k] * step[k]) * stride[k];
+            if (pending_len > 0 && pending_offset + pending_len == offset) {
+                pending_len += run;
+            } else {
+                if (pending_len > 0) pread_fully(fd, out, pending_len, pending_offset);
+                out += pending_len;
+                pending_offset = offset;
+                pending_len = run;
+            }
+
+            size_t k = nouter;
+            while (k > 0 && ++idx[k - 1] == count[k - 1]) idx[--k] = 0;
+            if (k == 0) break;
+        }
+        pread_fully(fd, out, pending_len, pending_offset);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+
+    fclose(fp);
+    make_native(arr);
+    return arr;
+}
+
+// bytes of one row along the first axis of a C-order array
+size_t row_bytes(const cnpy::Shape& shape, size_t word_size, bool fortran_order, const std::string& what) {
+    if (shape.empty()) throw std::runtime_error("load_rows: " + what + " is a scalar");
+    if (fortran_order && shape.size() > 1)
+        throw std::runtime_error("load_rows: " + what + " is in Fortran order, rows are not contiguous");
+    return std::accumulate(shape.begin() + 1, shape.end(), word_size, std::multiplies<size_t>());
+}
+
+cnpy::NpyArray cnpy::npz_load_rows(std::string fname, std::string varname, size_t row_begin, size_t row_end) {
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("npz_load_rows: Unable to open file " + fname);
+
+    try {
+        uint16_t compr_method;
+        uint32_t compr_bytes, uncompr_bytes;
+        if (!find_npz_entry(fp, varname, compr_method, compr_bytes, uncompr_bytes))
+            throw std::runtime_error("npz_load_rows: Variable name " + varname + " not found in " + fname);
+
+        Shape shape;
+        DType dtype;
+        bool fortran_order;
+        std::unique_ptr<InflateReader> reader;
+        if (compr_method == 0) {
+            parse_npy_header(fp, dtype, shape, fortran_order);
+        } else {
+            reader.reset(new InflateReader(fp, compr_bytes));
+            reader->read_npy_header(dtype, shape, fortran_order);
+        }
+
+        size_t row_size = row_bytes(shape, dtype.size, fortran_order, fname + ":" + varname);
+        row_end = std::min(row_end, shape[0]);
+        row_begin = std::min(row_begin, row_end);
+        shape[0] = row_end - row_begin;
+        NpyArray arr(shape, dtype, fortran_order);
+
+        if (reader) {
+            // stop inflating as soon as the last requested row is out
+            reader->skip(row_begin * row_size);
+            reader->read(arr.data<char>(), arr.num_bytes());
+        } else {
+            fseek(fp, row_begin * row_size, SEEK_CUR);
+            if (fread(arr.data<char>(), 1, arr.num_bytes(), fp) != arr.num_bytes())
+                throw std::runtime_error("npz_load_rows: failed fread");
+        }
+        fclose(fp);
+        make_native(arr);
+        return arr;
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+}
+
+cnpy::NpzSeekIndex::NpzSeekIndex(std::string fname, std::string varname, size_t span)
+    : fname_(fname), entry_offset_(0), compr_bytes_(0), compressed_(false), header_bytes_(0), fortran_order_(false) {
+    const size_t window_size = 1 << 15;
+
+    FILE* fp = fopen(fname.c_str(), "rb");
+    if (!fp) throw std::runtime_error("NpzSeekIndex: Unable to open file " + fname);
+
+    z_stream strm;
+    bool strm_open = false;
+    try {
+        uint16_t compr_method;
+        uint32_t compr_bytes, uncompr_bytes;
+        if (!find_npz_entry(fp, varname, compr_method, compr_bytes, uncompr_bytes))
+            throw std::runtime_error("NpzSeekIndex: Variable name " + varname + " not found in " + fname);
+        entry_offset_ = ftell(fp);
+        compr_bytes_ = compr_bytes;
+        compressed_ = compr_method != 0;
+
+        if (!compressed_) {
+            parse_npy_header(fp, dtype_, shape_, fortran_order_);
+            header_bytes_ = ftell(fp) - entry_offset_;
+            fclose(fp);
+            return;
+        }
+
+        InflateReader reader(fp, compr_bytes);
+        header_bytes_ = reader.read_npy_header(dtype_, shape_, fortran_order_);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+
+    // one full pass with Z_BLOCK, adding an access point at block boundaries at least span bytes apart
+    try {
+        fseek(fp, entry_offset_, SEEK_SET);
+        strm.zalloc = Z_NULL;
+        strm.zfree = Z_NULL;
+        strm.opaque = Z_NULL;
+        strm.avail_in = 0;
+        strm.next_in = Z_NULL;
+        if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) throw std::runtime_error("NpzSeekIndex: inflateInit2 failed");
+        strm_open = true;
+
+        std::vector<unsigned char> in(1 << 16), window(window_size);
+        size_t remaining = compr_bytes_, totin = 0, totout = 0, last = 0;
+        int err = Z_OK;
+        AccessPoint start;
+        start.out = 0;
+        start.in = 0;
+        start.bits = 0;
+        points_.push_back(start);
+        strm.avail_out = 0;
+        do {
+            if (strm.avail_in == 0 && remaining > 0) {
+                size_t n = std::min(remaining, in.size());
+                if (fread(&in[0], 1, n, fp) != n) throw std::runtime_error("NpzSeekIndex: failed fread");
+                remaining -= n;
+                strm.next_in = &in[0];
+                strm.avail_in = static_cast<uInt>(n);
+            }
+            if (strm.avail_out == 0) {
+                strm.avail_out = window_size;
+                strm.next_out = &window[0];
+            }
+            totin += strm.avail_in;
+            totout += strm.avail_out;
+            err = inflate(&strm, Z_BLOCK);
+            totin -= strm.avail_in;
+            totout -= strm.avail_out;
+            if (err == Z_BUF_ERROR && strm.avail_in == 0 && remaining == 0)
+                throw std::runtime_error("NpzSeekIndex: compressed entry truncated");
+            if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+                throw std::runtime_error("NpzSeekIndex: inflate failed");
+
+            bool block_boundary = (strm.data_type & 128) && !(strm.data_type & 64);
+            if (err == Z_OK && block_boundary && totout - last > span) {
+                AccessPoint point;
+                point.out = totout;
+                point.in = totin;
+                point.bits = strm.data_type & 7;
+                // unroll the circular window so that it ends at the current output position
+                size_t left = strm.avail_out;
+                size_t have = std::min(totout, window_size);
+                point.window.resize(have);
+                if (have == window_size) {
+                    if (left) memcpy(&point.window[0], &window[window_size - left], left);
+                    memcpy(&point.window[left], &window[0], window_size - left);
+                } else {
+                    memcpy(&point.window[0], &window[0], have);
+                }
+                points_.push_back(point);
+                last = totout;
+            }
+        } while (err != Z_STREAM_END);
+    } catch (...) {
+        if (strm_open) inflateEnd(&strm);
+        fclose(fp);
+        throw;
+    }
+    inflateEnd(&strm);
+    fclose(fp);
+}
+
+void cnpy::NpzSeekIndex::read(size_t offset, void* dst, size_t nbytes) const {
+    size_t data_bytes = std::accumulate(shape_.begin(), shape_.end(), dtype_.size, std::multiplies<size_t>());
+    if (offset + nbytes > data_bytes) throw std::runtime_error("NpzSeekIndex: read past the end of the array");
+    if (nbytes == 0) return;
+    size_t out = header_bytes_ + offset;
+
+    FILE* fp = fopen(fname_.c_str(), "rb");
+    if (!fp) throw std::runtime_error("NpzSeekIndex: Unable to open file " + fname_);
+    try {
+        if (!compressed_) {
+            pread_fully(fileno(fp), dst, nbytes, entry_offset_ + out);
+            fclose(fp);
+            return;
+        }
+
+        // the last access point at or before the requested offset
+        size_t lo = 0, hi = points_.size();
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (points_[mid].out <= out)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        const AccessPoint& point = points_[lo];
+
+        size_t start = point.in - (point.bits ? 1 : 0);
+        fseek(fp, entry_offset_ + start, SEEK_SET);
+        int value = 0;
+        if (point.bits) {
+            value = getc(fp);
+            if (value == EOF) throw std::runtime_error("NpzSeekIndex: failed getc");
+            ++start;
+        }
+        InflateReader reader(fp, compr_bytes_ - start);
+        reader.resume(point.bits, value, point.window);
+        reader.skip(out - point.out);
+        reader.read(dst, nbytes);
+    } catch (...) {
+        fclose(fp);
+        throw;
+    }
+    fclose(fp);
+}
+
+cnpy::NpyArray cnpy::NpzSeekIndex::load_rows(size_t row_begin, size_t row_end) const {
+    size_t row_size = row_bytes(shape_, dtype_.size, fortran_order_, fname_);
+    row_end = std::min(row_end, shape_[0]);
+    row_begin = std::min(row_begin, row_end);
+    Shape shape = shape_;
+    shape[0] = row_end - row_begin;
+    NpyArray arr(shape, dtype_, fortran_order_);
+    read(row_begin * row_size, arr.data<char>(), arr.num_bytes());
+    make_native(arr);
+    return arr;
+}
+
+// Implementation of new_npz_mmap
+cnpy::npz_t cnpy::new_npz_mmap(std::string filename, const std::vector<ShapeAndType>& _shapes, bool _fortran_order) {
+    if (_shapes.empty()) return npz_t();
+    bool first = true;
+    for (const auto& st : _shapes) {
+        const auto& shape = st.shape;
+        size_t nvals = 1;
+        for (size_t dim : shape) nvals *= dim;
+        std::string mode = first ? "w" : "a";
+        first = false;
+        DType dtype = dtype_of(st.type_info);
+        if (dtype.kind == '?') throw std::runtime_error("new_npz_mmap: unsupported type for variable " + st.name);
+        std::vector<char> zeros(nvals * dtype.size);
+        npz_save(filename, st.name, zeros.data(), shape, dtype, mode, false);
+    }
+    // Return memory-mapped arrays
+    auto arrays = npz_load(filename, true);
+    for (auto& kv : arrays) {
+        kv.second.fortran_order = _fortran_order;
+    }
+    return arrays;
+}
+
+// the asynchronous loads and saves, built on the engine in npy_io.cpp. each keeps its state in a shared_ptr that the
+// completions of its reads and writes hold on to
+namespace {
+    using cnpy::io::Engine;
+
+    std::string errno_message(ssize_t err) { return strerror(static_cast<int>(-err)); }
+
+    struct AsyncLoad {
+        AsyncLoad(const std::string& _fname, const cnpy::LoadCallback& _callback)
+            : fd(-1), fname(_fname), callback(_callback) {}
+        ~AsyncLoad() {
+            if (fd >= 0) ::close(fd);
+        }
+
+        int fd;
+        std::string fname;
+        std::vector<unsigned char> head; // the start of a .npy file, header and maybe some data
+        cnpy::NpyArray arr;
+        cnpy::LoadCallback callback;
+    };
+
+    // the bytes read together with the header of a .npy file; most headers are far smaller
+    const size_t async_head_bytes = 4096;
+
+    void on_async_data(const std::shared_ptr<AsyncLoad>& s, ssize_t n, size_t expected) {
+        try {
+            if (n < 0) throw std::runtime_error("npy_load_async: failed read of " + s->fname + ": " + errno_message(n));
+            if (static_cast<size_t>(n) < expected)
+                throw std::runtime_error("npy_load_async: " + s->fname + " is truncated");
+            ::close(s->fd);
+            s->fd = -1;
+            make_native(s->arr);
+        } catch (...) {
+            s->callback(cnpy::NpyArray(), std::current_exception());
+            return;
+        }
+        s->callback(s->arr, nullptr);
+    }
+
+    // read the data of s->arr, which starts at offset of s->fd
+    void read_async_data(const std::shared_ptr<AsyncLoad>& s, size_t offset, size_t have) {
+        size_t rest = s->arr.num_bytes() - have;
+        if (rest == 0) return on_async_data(s, 0, 0);
+        Engine::instance().read(s->fd, s->arr.data<char>() + have, rest, offset + have,
+                                [s, rest](ssize_t n) { on_async_data(s, n, rest); });
+    }
+
+    void on_async_head(const std::shared_ptr<AsyncLoad>& s, ssize_t n) {
+        try {
+            if (n < 0) throw std::runtime_error("npy_load_async: failed read of " + s->fname + ": " + errno_message(n));
+            size_t got = static_cast<size_t>(n);
+            if (got < 10 || memcmp(s->head.data(), "\x93NUMPY", 6) != 0)
+                throw std::runtime_error("npy_load_async: " + s->fname + " is not a .npy file");
+            uint16_t header_len;
+            memcpy(&header_len, &s->head[8], 2);
+            size_t header_size = 10 + static_cast<size_t>(header_len);
+            if (header_size > got) {
+                // a long header: fetch the rest of it
+                if (got < s->head.size()) throw std::runtime_error("npy_load_async: " + s->fname + " is truncated");
+                s->head.resize(header_size);
+                Engine::instance().read(s->fd, &s->head[got], header_size - got, got,
+                                        [s, got](ssize_t m) { on_async_head(s, m < 0 ? m : got + m); });
+                return;
+            }
+
+            cnpy::DType dtype;
+            cnpy::Shape shape;
+            bool fortran_order;
+            cnpy::parse_npy_header(s->head.data(), dtype, shape, fortran_order);
+            s->arr = cnpy::NpyArray(shape, dtype, fortran_order);
+            size_t have = std::min(got - header_size, s->arr.num_bytes());
+            if (have > 0) memcpy(s->arr.data<char>(), &s->head[header_size], have);
+            std::vector<unsigned char>().swap(s->head);
+            read_async_data(s, header_size, have);
+        } catch (...) {
+            s->callback(cnpy::NpyArray(), std::current_exception());
+        }
+    }
+
+    // saves to one npz archive rewrite its central directory, so they run one at a time in the order they were made
+    class ArchiveQueue {
+      public:
+        void run(const std::string& zipname, std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                std::deque<std::function<void()>>& tasks = pending_[zipname];
+                tasks.push_back(std::move(task));
+                if (tasks.size() > 1) return; // the archive's tasks are already being worked through
+            }
+            Engine::instance().run([this, zipname] { drain(zipname); });
+        }
+
+      private:
+        void drain(const std::string& zipname) {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    task = pending_[zipname].front();
+                }
+                task();
+                std::lock_guard<std::mutex> lock(mutex_);
+                std::deque<std::function<void()>>& tasks = pending_[zipname];
+                tasks.pop_front();
+                if (tasks.empty()) {
+                    pending_.erase(zipname);
+                    return;
+                }
+            }
+        }
+
+        std::mutex mutex_;
+        std::map<std::string, std::deque<std::function<void()>>> pending_;
+    };
+
+    ArchiveQueue& archive_queue() {
+        static ArchiveQueue* queue = new ArchiveQueue; // outlives the engine's pool, like the engine itself
+        return *queue;
+    }
+} // namespace
+
+void cnpy::npy_load_async(std::string fname, LoadCallback callback) {
+    std::shared_ptr<AsyncLoad> s = std::make_shared<AsyncLoad>(fname, callback);
+    Engine::instance().run([s] {
+        s->fd = ::open(s->fname.c_str(), O_RDONLY | O_CLOEXEC);
+        if (s->fd < 0)
+            return s->callback(NpyArray(), std::make_exception_ptr(std::runtime_error(
+                                               "npy_load_async: Unable to open file " + s->fname)));
+        s->head.resize(async_head_bytes);
+        Engine::instance().read(s->fd, s->head.data(), s->head.size(), 0, [s](ssize_t n) { on_async_head(s, n); });
+    });
+}
+
+void cnpy::npz_load_async(std::string fname, std::string varname, LoadCallback callback) {
+    std::shared_ptr<AsyncLoad> s = std::make_shared<AsyncLoad>(fname, callback);
+    Engine::instance().run([s, varname] {
+        // finding the entry takes a few small reads. stored entries then read their data through the engine;
+        // deflated ones are inflated right here, which is CPU work anyway
+        FILE* fp = fopen(s->fname.c_str(), "rb");
+        try {
+            if (!fp) throw std::runtime_error("npz_load_async: Unable to open file " + s->fname);
+            uint16_t compr_method;
+            uint32_t compr_bytes, uncompr_bytes;
+            if (!find_npz_entry(fp, varname, compr_method, compr_bytes, uncompr_bytes))
+                throw std::runtime_error("npz_load_async: Variable name " + varname + " not found in " + s->fname);
+            if (compr_method != 0) {
+                NpyArray arr = load_the_npz_array(fp, compr_bytes, uncompr_bytes);
+                fclose(fp);
+                fp = NULL;
+                return s->callback(arr, nullptr);
+            }
+            DType dtype;
+            Shape shape;
+            bool fortran_order;
+            parse_npy_header(fp, dtype, shape, fortran_order);
+            size_t offset = ftell(fp);
+            s->arr = NpyArray(shape, dtype, fortran_order);
+            s->fd = ::dup(fileno(fp));
+            fclose(fp);
+            fp = NULL;
+            if (s->fd < 0) throw std::runtime_error("npz_load_async: failed dup");
+            read_async_data(s, offset, 0);
+        } catch (...) {
+            if (fp) fclose(fp);
+            s->callback(NpyArray(), std::current_exception());
+        }
+    });
+}
+
+void cnpy::npy_save_async(std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                          SaveCallback callback) {
+    Engine::instance().run([fname, data, shape, dtype, callback] {
+        int fd = -1;
+        try {
+            size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+            std::shared_ptr<std::vector<char>> header =
+                std::make_shared<std::vector<char>>(create_npy_header(shape, dtype));
+            // non-native byte orders are written from a swapped copy, which the completion keeps alive
+            std::shared_ptr<std::vector<char>> swapped = std::make_shared<std::vector<char>>();
+            if (!dtype.is_native()) {
+                swapped->assign(static_cast<const char*>(data), static_cast<const char*>(data) + nbytes);
+                swap_bytes(swapped->data(), nbytes, dtype);
+            }
+            fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            if (fd < 0) throw std::runtime_error("npy_save_async: Unable to open file " + fname);
+            std::vector<struct iovec> iov(2);
+            iov[0].iov_base = header->data();
+            iov[0].iov_len = header->size();
+            iov[1].iov_base = const_cast<void*>(dtype.is_native() ? data : swapped->data());
+            iov[1].iov_len = nbytes;
+            Engine::instance().write(fd, iov, 0, [fd, fname, header, swapped, callback](ssize_t n) {
+                bool closed = ::close(fd) == 0;
+                if (n < 0)
+                    return callback(std::make_exception_ptr(
+                        std::runtime_error("npy_save_async: failed write of " + fname + ": " + errno_message(n))));
+                if (!closed)
+                    return callback(std::make_exception_ptr(
+                        std::runtime_error("npy_save_async: failed close of " + fname)));
+                callback(nullptr);
+            });
+        } catch (...) {
+            if (fd >= 0) ::close(fd);
+            callback(std::current_exception());
+        }
+    });
+}
+
+void cnpy::npz_save_async(std::string zipname, std::string fname, const void* data, const Shape& shape,
+                          const DType& dtype, std::string mode, bool compress, SaveCallback callback) {
+    archive_queue().run(zipname, [=] {
+        try {
+            npz_save(zipname, fname, data, shape, dtype, mode, compress);
+        } catch (...) {
+            return callback(std::current_exception());
+        }
+        callback(nullptr);
+    });
+}
+
+namespace {
+    cnpy::LoadCallback fulfil(const std::shared_ptr<std::promise<cnpy::NpyArray>>& promise) {
+        return [promise](cnpy::NpyArray arr, std::exception_ptr error) {
+            if (error)
+                promise->set_exception(error);
+            else
+                promise->set_value(arr);
+        };
+    }
+
+    cnpy::SaveCallback fulfil(const std::shared_ptr<std::promise<void>>& promise) {
+        return [promise](std::exception_ptr error) {
+            if (error)
+                promise->set_exception(error);
+            else
+                promise->set_value();
+        };
+    }
+} // namespace
+
+std::future<cnpy::NpyArray> cnpy::npy_load_async(std::string fname) {
+    std::shared_ptr<std::promise<NpyArray>> promise = std::make_shared<std::promise<NpyArray>>();
+    npy_load_async(fname, fulfil(promise));
+    return promise->get_future();
+}
+
+std::future<cnpy::NpyArray> cnpy::npz_load_async(std::string fname, std::string varname) {
+    std::shared_ptr<std::promise<NpyArray>> promise = std::make_shared<std::promise<NpyArray>>();
+    npz_load_async(fname, varname, fulfil(promise));
+    return promise->get_future();
+}
+
+std::future<void> cnpy::npy_save_async(std::string fname, const void* data, const Shape& shape, const DType& dtype) {
+    std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+    npy_save_async(fname, data, shape, dtype, fulfil(promise));
+    return promise->get_future();
+}
+
+std::future<void> cnpy::npz_save_async(std::string zipname, std::string fname, const void* data, const Shape& shape,
+                                       const DType& dtype, std::string mode, bool compress) {
+    std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+    npz_save_async(zipname, fname, data, shape, dtype, mode, compress, fulfil(promise));
+    return promise->get_future();
+}
+
+bool cnpy::async_uses_io_uring() { return Engine::instance().uses_io_uring(); }
+
+namespace {
+    // the part [next, end) of the paths that one npy_load_many worker has yet to load. the owner takes from the
+    // front; thieves take the back half
+    struct Share {
+        std::mutex mutex;
+        size_t next;
+        size_t end;
+        Share() : next(0), end(0) {}
+    };
+
+    // move the back half of the largest other share into mine, returning false once every share is empty
+    bool steal(std::vector<Share>& shares, size_t mine) {
+        while (true) {
+            size_t victim = shares.size();
+            size_t most = 0;
+            for (size_t i = 0; i < shares.size(); ++i) {
+                if (i == mine) continue;
+                std::lock_guard<std::mutex> lock(shares[i].mutex);
+                size_t left = shares[i].end - shares[i].next;
+                if (left > most) {
+                    most = left;
+                    victim = i;
+                }
+            }
+            if (victim == shares.size()) return false;
+
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(shares[victim].mutex);
+                size_t left = shares[victim].end - shares[victim].next;
+                if (left == 0) continue; // emptied since we looked
+                end = shares[victim].end;
+                begin = end - (left + 1) / 2;
+                shares[victim].end = begin;
+            }
+            std::lock_guard<std::mutex> lock(shares[mine].mutex);
+            shares[mine].next = begin;
+            shares[mine].end = end;
+            return true;
+        }
+    }
+} // namespace
+
+std::vector<cnpy::LoadResult> cnpy::npy_load_many(const std::vector<std::string>& paths,
+                                                  const LoadManyOptions& options) {
+    std::vector<LoadResult> results(paths.size());
+    if (paths.empty()) return results;
+    size_t nthreads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, paths.size());
+
+    std::vector<Share> shares(nthreads);
+    for (size_t t = 0; t < nthreads; ++t) {
+        shares[t].next = paths.size() * t / nthreads;
+        shares[t].end = paths.size() * (t + 1) / nthreads;
+    }
+
+    auto work = [&](size_t t) {
+        while (true) {
+            size_t i;
+            {
+                std::lock_guard<std::mutex> lock(shares[t].mutex);
+                i = shares[t].next < shares[t].end ? shares[t].next++ : paths.size();
+            }
+            if (i == paths.size() && !steal(shares, t)) return;
+            if (i == paths.size()) continue;
+            try {
+                LoadOptions load;
+                load.mmap = options.use_mmap;
+                load.cache = options.cache;
+                results[i].array = npy_load(paths[i], load);
+            } catch (const std::exception& e) {
+                results[i].error = std::current_exception();
+                results[i].message = e.what();
+            } catch (...) {
+                results[i].error = std::current_exception();
+                results[i].message = "npy_load_many: unknown error loading " + paths[i];
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nthreads; ++t) threads.push_back(std::thread(work, t));
+    work(0);
+    for (std::thread& thread : threads) thread.join();
+    return results;
+}
+
+// call f(i) for i in [0, sizes.size()) on up to threads threads, counting the calling thread (0: one per hardware
+// thread). the sizes are known up front, so handing the indices out largest first is enough to keep the threads
+// balanced. f must not throw
+void for_each_largest_first(const std::vector<size_t>& sizes, unsigned threads, const std::function<void(size_t)>& f) {
+    std::vector<size_t> order(sizes.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+    size_t nthreads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, order.size());
+
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t k = next++; k < order.size(); k = next++) f(order[k]);
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < nthreads; ++t) pool.push_back(std::thread(work));
+    work();
+    for (std::thread& thread : pool) thread.join();
+}
+
+// the options each file of a batch save is published with. save.fsync wins when set; otherwise a sync policy that
+// syncs file by file becomes an fdatasync in publish_save_target, so that no file is synced twice
+cnpy::SaveOptions batch_save_options(const cnpy::SaveManyOptions& options, bool each_file) {
+    cnpy::SaveOptions save = options.save;
+    if (save.fsync == cnpy::FsyncPolicy::None && each_file) save.fsync = cnpy::FsyncPolicy::Data;
+    return save;
+}
+
+cnpy::SaveManyStats cnpy::npy_save_many(const std::vector<SaveItem>& items, const SaveManyOptions& options) {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    SaveManyStats stats;
+    std::vector<size_t> sizes(items.size());
+    for (size_t i = 0; i < items.size(); ++i) sizes[i] = items[i].nbytes();
+    std::vector<std::exception_ptr> errors(items.size());
+    std::vector<dev_t> devices(items.size());
+    std::vector<char> written(items.size(), 0); // not vector<bool>: the threads set neighbouring entries
+    SaveOptions save = batch_save_options(options, options.sync == SyncPolicy::EachFile);
+
+    for_each_largest_first(sizes, options.threads, [&](size_t i) {
+        const SaveItem& item = items[i];
+        try {
+            SaveTarget target = write_new_npy(item.fname, std::vector<Segment>(1, Segment(item.data, sizes[i])),
+                                              item.shape, item.dtype, save);
+            struct stat st;
+            if (::fstat(target.fd, &st) == 0) devices[i] = st.st_dev;
+            publish_save_target("npy_save_many", target, save);
+            written[i] = 1;
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+
+    // files already synced as they were published are not synced again
+    if (options.sync == SyncPolicy::AtEnd && save.fsync == FsyncPolicy::None) {
+        // one syncfs per filesystem flushes every file at once; without syncfs each file is synced in turn
+        std::vector<dev_t> synced;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (!written[i]) continue;
+#ifdef __linux__
+            if (std::find(synced.begin(), synced.end(), devices[i]) != synced.end()) continue;
+            synced.push_back(devices[i]);
+#endif
+            int fd = ::open(items[i].fname.c_str(), O_RDONLY | O_CLOEXEC);
+            int err = fd < 0 ? errno : 0;
+#ifdef __linux__
+            if (fd >= 0 && ::syncfs(fd) != 0) err = errno;
+#else
+            if (fd >= 0 && ::fsync(fd) != 0) err = errno;
+#endif
+            if (fd >= 0) ::close(fd);
+            if (err != 0)
+                errors[i] = std::make_exception_ptr(
+                    std::runtime_error("npy_save_many: failed to sync " + items[i].fname + ": " + strerror(err)));
+        }
+    }
+
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (errors[i]) std::rethrow_exception(errors[i]);
+        ++stats.files;
+        stats.bytes += items[i].nbytes();
+    }
+    stats.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return stats;
+}
+
+cnpy::SaveManyStats cnpy::npz_save_many(std::string zipname, const std::vector<SaveItem>& items, bool compress,
+                                        const SaveManyOptions& options) {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    if (items.size() > 0xffff) throw std::runtime_error("npz_save_many: a zip file holds at most 65535 entries");
+
+    // everything but the compressed sizes is known before any data is written
+    size_t n = items.size();
+    std::vector<std::string> names(n);
+    std::vector<std::vector<char>> npy_headers(n);
+    std::vector<size_t> sizes(n);
+    for (size_t i = 0; i < n; ++i) {
+        names[i] = items[i].fname + ".npy";
+        for (size_t j = 0; j < i; ++j)
+            if (names[j] == names[i]) throw std::runtime_error("npz_save_many: duplicate entry " + items[i].fname);
+        npy_headers[i] = create_npy_header(items[i].shape, items[i].dtype);
+        sizes[i] = items[i].nbytes();
+    }
+
+    // entries are not block aligned, so O_DIRECT does not apply. with a single file, every sync policy but None
+    // means syncing it once it is complete
+    SaveOptions npz_options = batch_save_options(options, options.sync != SyncPolicy::None);
+    npz_options.direct = false;
+    SaveTarget target = open_save_target("npz_save_many", zipname, O_WRONLY | O_CREAT | O_TRUNC, npz_options);
+    int fd = target.fd;
+
+    std::vector<uint32_t> crcs(n);
+    std::vector<size_t> stored_sizes(n);
+    std::vector<size_t> offsets(n);
+    std::vector<std::vector<char>> deflated(n);
+    std::vector<std::exception_ptr> errors(n);
+    auto rethrow_first = [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            if (!errors[i]) continue;
+            abandon_save_target(target);
+            std::rethrow_exception(errors[i]);
+        }
+    };
+    // the entry's npy header and data, written by w
+    auto write_entry = [&](size_t i, SegmentWriter& w) {
+        w.write(npy_headers[i].data(), npy_headers[i].size());
+        write_array_data(w, std::vector<Segment>(1, Segment(items[i].data, sizes[i])), items[i].dtype);
+        w.finish();
+        crcs[i] = w.crc;
+        stored_sizes[i] = w.bytes_out;
+    };
+
+    // compressed entries are deflated into memory in parallel first, since their offsets depend on the sizes of
+    // the entries before them
+    if (compress) {
+        for_each_largest_first(sizes, options.threads, [&](size_t i) {
+            try {
+                SegmentWriter w(deflated[i], true);
+                write_entry(i, w);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+        rethrow_first();
+    } else {
+        for (size_t i = 0; i < n; ++i) stored_sizes[i] = npy_headers[i].size() + sizes[i];
+    }
+
+    size_t end = 0;
+    for (size_t i = 0; i < n; ++i) {
+        offsets[i] = end;
+        end += 30 + names[i].size() + stored_sizes[i];
+    }
+    size_t directory_size = 0;
+    for (size_t i = 0; i < n; ++i) directory_size += 46 + names[i].size();
+    if (end + directory_size + 22 > 0xffffffffu) {
+        abandon_save_target(target);
+        throw std::runtime_error("npz_save_many: " + zipname + " would need zip64, which is not supported");
+    }
+#ifdef __linux__
+    if (options.save.preallocate && end > 0 && ::fallocate(fd, 0, 0, end + directory_size + 22) != 0 &&
+        errno != EOPNOTSUPP && errno != ENOSYS) {
+        int err = errno;
+        abandon_save_target(target);
+        throw std::runtime_error("npz_save_many: failed fallocate for " + zipname + ": " + strerror(err));
+    }
+#endif
+
+    // every entry goes to its own fixed offset, so the writes are independent. stored entries are written straight
+    // from the caller's memory with the CRC computed on the way out; their local headers follow once it is known
+    std::vector<std::vector<char>> local_headers(n);
+    for_each_largest_first(sizes, options.threads, [&](size_t i) {
+        try {
+            size_t data_offset = offsets[i] + 30 + names[i].size();
+            if (compress) {
+                pwrite_fully(fd, deflated[i].data(), deflated[i].size(), data_offset);
+                if (options.save.cache == CachePolicy::Stream)
+                    WritebackThrottle(fd, data_offset).finish(data_offset + deflated[i].size());
+                std::vector<char>().swap(deflated[i]);
+            } else {
+                SegmentWriter w(fd, data_offset, false);
+                if (options.save.cache == CachePolicy::Stream) w.stream();
+                write_entry(i, w);
+            }
+            local_headers[i] = zip_local_header(names[i], crcs[i], stored_sizes[i], npy_headers[i].size() + sizes[i],
+                                                compress ? 8 : 0);
+            pwrite_fully(fd, local_headers[i].data(), local_headers[i].size(), offsets[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    rethrow_first();
+
+    // one central directory, in the order the entries were given
+    std::vector<char> global_header;
+    for (size_t i = 0; i < n; ++i) append_zip_record(global_header, local_headers[i], offsets[i], names[i]);
+    std::vector<char> footer = zip_footer(n, global_header.size(), end);
+    try {
+        pwrite_fully(fd, global_header.data(), global_header.size(), end);
+        pwrite_fully(fd, footer.data(), footer.size(), end + global_header.size());
+    } catch (...) {
+        abandon_save_target(target);
+        throw;
+    }
+    publish_save_target("npz_save_many", target, npz_options);
+
+    SaveManyStats stats;
+    stats.files = n;
+    stats.bytes = std::accumulate(sizes.begin(), sizes.end(), size_t(0));
+    stats.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return stats;
+}
+
+// hand nbytes of native-order data to the sinks in dtype's byte order: as it is to reference when no swap is needed,
+// otherwise swapped a chunk at a time to copy
+void sink_array_data(const cnpy::ByteSink& copy, const cnpy::ByteSink& reference, const void* data, size_t nbytes,
+                     const cnpy::DType& dtype) {
+    if (dtype.is_native()) {
+        if (nbytes > 0) reference(data, nbytes);
+        return;
+    }
+    SegmentWriter w(copy, false);
+    write_array_data(w, std::vector<cnpy::Segment>(1, cnpy::Segment(data, nbytes)), dtype);
+    w.finish();
+}
+
+// Collects scatter output. copied bytes are appended to storage and referenced ones recorded where they are; the
+// segments pointing into storage are only resolved by segments(), once storage has stopped growing
+class ScatterCollector {
+  public:
+    ScatterCollector(std::vector<char>& storage, size_t reserve) : storage_(storage) {
+        storage_.clear();
+        storage_.reserve(reserve);
+    }
+
+    cnpy::ByteSink copy() {
+        return [this](const void* p, size_t n) {
+            if (n == 0) return;
+            if (pieces_.empty() || pieces_.back().data) pieces_.push_back(Piece(nullptr, storage_.size()));
+            pieces_.back().size += n;
+            storage_.insert(storage_.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+        };
+    }
+
+    cnpy::ByteSink reference() {
+        return [this](const void* p, size_t n) {
+            pieces_.push_back(Piece(p, 0));
+            pieces_.back().size = n;
+        };
+    }
+
+    std::vector<cnpy::Segment> segments() const {
+        std::vector<cnpy::Segment> segments;
+        for (const Piece& piece : pieces_)
+            segments.push_back(cnpy::Segment(piece.data ? piece.data : storage_.data() + piece.offset, piece.size));
+        return segments;
+    }
+
+  private:
+    struct Piece {
+        const void* data; // null for a run of storage
+        size_t offset;    // into storage
+        size_t size;
+        Piece(const void* _data, size_t _offset) : data(_data), offset(_offset), size(0) {}
+    };
+
+    std::vector<char>& storage_;
+    std::vector<Piece> pieces_;
+};
+
+std::vector<char> cnpy::npy_save_buffer(const void* data, const Shape& shape, const DType& dtype) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    std::vector<char> image = create_npy_header(shape, dtype);
+    image.reserve(image.size() + nbytes);
+    sink_array_data(append_to(image), append_to(image), data, nbytes, dtype);
+    return image;
+}
+
+void cnpy::npy_save_sink(const ByteSink& sink, const void* data, const Shape& shape, const DType& dtype) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    std::vector<char> header = create_npy_header(shape, dtype);
+    sink(header.data(), header.size());
+    sink_array_data(sink, sink, data, nbytes, dtype);
+}
+
+std::vector<cnpy::Segment> cnpy::npy_save_segments(const void* data, const Shape& shape, const DType& dtype,
+                                                   std::vector<char>& storage) {
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    std::vector<char> header = create_npy_header(shape, dtype);
+    ScatterCollector out(storage, header.size() + (dtype.is_native() ? 0 : nbytes));
+    out.copy()(header.data(), header.size());
+    sink_array_data(out.copy(), out.reference(), data, nbytes, dtype);
+    return out.segments();
+}
+
+// An .npz image of items, laid out as npz_save_many would write it. the local headers come before the data, so the
+// CRCs are computed (and compressed entries deflated into memory) up front; after that the image can be produced
+// front to back, and its exact size is known
+class NpzImage {
+  public:
+    NpzImage(const std::vector<cnpy::SaveItem>& items, bool compress)
+        : items_(items), compress_(compress), referenced_(0) {
+        size_t n = items.size();
+        if (n > 0xffff) throw std::runtime_error("npz_save_buffer: a zip file holds at most 65535 entries");
+        npy_headers_.resize(n);
+        deflated_.resize(n);
+        local_headers_.resize(n);
+        size_t offset = 0;
+        std::vector<std::string> names(n);
+        for (size_t i = 0; i < n; ++i) {
+            names[i] = items[i].fname + ".npy";
+            for (size_t j = 0; j < i; ++j)
+                if (names[j] == names[i])
+                    throw std::runtime_error("npz_save_buffer: duplicate entry " + items[i].fname);
+            npy_headers_[i] = cnpy::create_npy_header(items[i].shape, items[i].dtype);
+            size_t nbytes = items[i].nbytes();
+            std::vector<cnpy::Segment> data(1, cnpy::Segment(items[i].data, nbytes));
+
+            // a stored entry's data is only read here for its CRC
+            SegmentWriter w(compress ? append_to(deflated_[i]) : cnpy::ByteSink([](const void*, size_t) {}), compress);
+            w.write(npy_headers_[i].data(), npy_headers_[i].size());
+            write_array_data(w, data, items[i].dtype);
+            w.finish();
+            if (!compress && items[i].dtype.is_native()) referenced_ += nbytes;
+
+            local_headers_[i] = zip_local_header(names[i], w.crc, w.bytes_out, w.bytes_in, compress ? 8 : 0);
+            append_zip_record(global_header_, local_headers_[i], offset, names[i]);
+            offset += local_headers_[i].size() + w.bytes_out;
+        }
+        if (offset + global_header_.size() + 22 > 0xffffffffu)
+            throw std::runtime_error("npz_save_buffer: the archive would need zip64, which is not supported");
+        footer_ = zip_footer(n, global_header_.size(), offset);
+        size_ = offset + global_header_.size() + footer_.size();
+    }
+
+    size_t size() const { return size_; }
+    // the bytes of native-order stored data, which write() hands to reference
+    size_t referenced() const { return referenced_; }
+
+    void write(const cnpy::ByteSink& copy, const cnpy::ByteSink& reference) const {
+        for (size_t i = 0; i < items_.size(); ++i) {
+            copy(local_headers_[i].data(), local_headers_[i].size());
+            if (compress_) {
+                copy(deflated_[i].data(), deflated_[i].size());
+                continue;
+            }
+            copy(npy_headers_[i].data(), npy_headers_[i].size());
+            sink_array_data(copy, reference, items_[i].data, items_[i].nbytes(), items_[i].dtype);
+        }
+        copy(global_header_.data(), global_header_.size());
+        copy(footer_.data(), footer_.size());
+    }
+
+  private:
+    const std::vector<cnpy::SaveItem>& items_;
+    bool compress_;
+    std::vector<std::vector<char>> npy_headers_;
+    std::vector<std::vector<char>> deflated_;
+    std::vector<std::vector<char>> local_headers_;
+    std::vector<char> global_header_;
+    std::vector<char> footer_;
+    size_t size_;
+    size_t referenced_;
+};
+
+std::vector<char> cnpy::npz_save_buffer(const std::vector<SaveItem>& items, bool compress) {
+    NpzImage image(items, compress);
+    std::vector<char> buffer;
+    buffer.reserve(image.size());
+    image.write(append_to(buffer), append_to(buffer));
+    return buffer;
+}
+
+void cnpy::npz_save_sink(const ByteSink& sink, const std::vector<SaveItem>& items, bool compress) {
+    NpzImage(items, compress).write(sink, sink);
+}
+
+std::vector<cnpy::Segment> cnpy::npz_save_segments(const std::vector<SaveItem>& items, std::vector<char>& storage,
+                                                   bool compress) {
+    NpzImage image(items, compress);
+    ScatterCollector out(storage, image.size() - image.referenced());
+    image.write(out.copy(), out.reference());
+    return out.segments();
+}
+
+cnpy::FileSource::FileSource(const std::string& fname, bool use_mmap) : fd_(-1), size_(0), map_(nullptr) {
+    fd_ = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) throw std::runtime_error("FileSource: unable to open file " + fname + ": " + strerror(errno));
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        int err = errno;
+        ::close(fd_);
+        throw std::runtime_error("FileSource: unable to stat file " + fname + ": " + strerror(err));
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (use_mmap && size_ > 0) {
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (map == MAP_FAILED) {
+            int err = errno;
+            ::close(fd_);
+            throw std::runtime_error("FileSource: mmap failed for file " + fname + ": " + strerror(err));
+        }
+        map_ = map;
+    }
+}
+
+cnpy::FileSource::~FileSource() {
+    if (map_) ::munmap(map_, size_);
+    ::close(fd_);
+}
+
+void cnpy::FileSource::read_at(void* dst, size_t n, size_t offset) const {
+    if (offset > size_ || n > size_ - offset) throw std::runtime_error("FileSource: read past the end of the file");
+    pread_fully(fd_, dst, n, offset);
+}
+
+cnpy::FdSource::FdSource(int fd) : fd_(fd), size_(0) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) throw std::runtime_error(std::string("FdSource: unable to stat fd: ") + strerror(errno));
+    size_ = static_cast<size_t>(st.st_size);
+}
+
+void cnpy::FdSource::read_at(void* dst, size_t n, size_t offset) const {
+    if (offset > size_ || n > size_ - offset) throw std::runtime_error("FdSource: read past the end of the file");
+    pread_fully(fd_, dst, n, offset);
+}
+
+void cnpy::MemorySource::read_at(void* dst, size_t n, size_t offset) const {
+    if (offset > size_ || n > size_ - offset) throw std::runtime_error("MemorySource: read past the end of the buffer");
+    memcpy(dst, data_ + offset, n);
+}
+
+cnpy::FileTarget::FileTarget(const std::string& fname) {
+    fd_ = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd_ < 0) throw std::runtime_error("FileTarget: unable to open file " + fname + ": " + strerror(errno));
+}
+
+cnpy::FileTarget::~FileTarget() { ::close(fd_); }
+
+void cnpy::FileTarget::write_at(const void* src, size_t n, size_t offset) { pwrite_fully(fd_, src, n, offset); }
+
+void cnpy::FdTarget::write_at(const void* src, size_t n, size_t offset) { pwrite_fully(fd_, src, n, offset); }
+
+void cnpy::MemoryTarget::write_at(const void* src, size_t n, size_t offset) {
+    if (offset + n > buffer.size()) buffer.resize(offset + n);
+    memcpy(buffer.data() + offset, src, n);
+}
+
+// the .npy at [offset, offset + size) in source. in memory it is returned as a view where possible; otherwise the
+// header and then the data are read with ranged reads
+cnpy::NpyArray load_npy_at(const std::shared_ptr<const cnpy::Source>& source, size_t offset, size_t size,
+                           const std::string& what) {
+    if (source->data()) return view_npy(static_cast<const unsigned char*>(source->data()) + offset, size, source, what);
+
+    unsigned char preamble[10];
+    if (size < 10) throw std::runtime_error(what + ": not an .npy");
+    source->read_at(preamble, 10, offset);
+    if (memcmp(preamble, "\x93NUMPY", 6) != 0) throw std::runtime_error(what + ": not an .npy");
+    uint16_t header_len;
+    memcpy(&header_len, preamble + 8, 2);
+    if (10 + static_cast<size_t>(header_len) > size) throw std::runtime_error(what + ": truncated .npy header");
+    std::vector<unsigned char> header(10 + header_len);
+    memcpy(header.data(), preamble, 10);
+    source->read_at(&header[10], header_len, offset + 10);
+    cnpy::DType dtype;
+    cnpy::Shape shape;
+    bool fortran_order;
+    cnpy::parse_npy_header(header.data(), dtype, shape, fortran_order);
+    size_t nbytes = std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+    if (nbytes > size - header.size()) throw std::runtime_error(what + ": truncated .npy data");
+
+    size_t pos = offset + header.size();
+    const cnpy::Source& src = *source;
+    return read_payload(
+        [&src, &pos](void* dst, size_t n) {
+            src.read_at(dst, n, pos);
+            pos += n;
+        },
+        shape, dtype, fortran_order, cnpy::MemoryOrder::AsStored);
+}
+
+// Reads the entries of a zip archive in a source through its central directory, which takes a few ranged reads:
+// the tail of the archive, the directory, and each entry's local header
+class SourceArchive {
+  public:
+    struct Entry {
+        std::string name; // without .npy
+        uint16_t compr_method;
+        size_t compr_bytes;
+        size_t uncompr_bytes;
+        size_t offset; // of the entry's data
+    };
+
+    explicit SourceArchive(const std::shared_ptr<const cnpy::Source>& source) : source_(source) {
+        size_t size = source->size();
+        if (size < 22) throw std::runtime_error("npz_load: too small to be a zip archive");
+        std::vector<unsigned char> tail(std::min<size_t>(size, 22 + 0xffff));
+        source->read_at(tail.data(), tail.size(), size - tail.size());
+        ZipFooter footer = decode_zip_footer(&tail[find_zip_footer(tail.data(), tail.size(), "npz_load")], "npz_load");
+        size_t count = footer.nrecs;
+        std::vector<unsigned char> directory(footer.global_header_size);
+        size_t directory_offset = footer.global_header_offset;
+        if (directory_offset > size || directory.size() > size - directory_offset)
+            throw std::runtime_error("npz_load: truncated archive");
+        source->read_at(directory.data(), directory.size(), directory_offset);
+
+        size_t offset = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (u32(directory, offset) != 0x02014b50) throw std::runtime_error("npz_load: corrupt central directory");
+            Entry e;
+            e.compr_method = u16(directory, offset + 10);
+            e.compr_bytes = u32(directory, offset + 20);
+            e.uncompr_bytes = u32(directory, offset + 24);
+            size_t name_len = u16(directory, offset + 28);
+            size_t extra_len = u16(directory, offset + 30);
+            size_t comment_len = u16(directory, offset + 32);
+            size_t local = u32(directory, offset + 42);
+            if (offset + 46 + name_len > directory.size()) throw std::runtime_error("npz_load: truncated archive");
+            e.name = std::string(reinterpret_cast<const char*>(&directory[offset + 46]), name_len);
+            if (e.name.size() < 4 || e.name.compare(e.name.size() - 4, 4, ".npy") != 0)
+                throw std::runtime_error("npz_load: entry " + e.name + " is not an .npy");
+            e.name.erase(e.name.size() - 4);
+            // the local header's name and extra field can differ in length from the central directory's
+            unsigned char local_header[30];
+            source->read_at(local_header, sizeof(local_header), local);
+            ZipLocalHeader header;
+            if (!decode_zip_local_header(local_header, header))
+                throw std::runtime_error("npz_load: corrupt local header");
+            e.offset = local + 30 + header.name_len + header.extra_len;
+            if (e.offset > size || e.compr_bytes > size - e.offset)
+                throw std::runtime_error("npz_load: truncated archive");
+            entries_.push_back(e);
+            offset += 46 + name_len + extra_len + comment_len;
+        }
+    }
+
+    const std::vector<Entry>& entries() const { return entries_; }
+
+    cnpy::NpyArray load(const Entry& e) const {
+        if (e.compr_method == 0) return load_npy_at(source_, e.offset, e.compr_bytes, "npz_load: " + e.name);
+        if (e.compr_method != 8)
+            throw std::runtime_error("npz_load: entry " + e.name + " uses an unsupported compression method");
+        const void* data = source_->data();
+        std::unique_ptr<InflateReader> reader(
+            data ? new InflateReader(static_cast<const unsigned char*>(data) + e.offset, e.compr_bytes)
+                 : new InflateReader(*source_, e.offset, e.compr_bytes));
+        return inflate_npy(*reader, static_cast<uint32_t>(e.uncompr_bytes), cnpy::MemoryOrder::AsStored);
+    }
+
+  private:
+    // fields of the central directory, checked to lie within it
+    static uint16_t u16(const std::vector<unsigned char>& buf, size_t offset) {
+        if (offset + 2 > buf.size()) throw std::runtime_error("npz_load: truncated archive");
+        return zip_u16(&buf[offset]);
+    }
+    static uint32_t u32(const std::vector<unsigned char>& buf, size_t offset) {
+        if (offset + 4 > buf.size()) throw std::runtime_error("npz_load: truncated archive");
+        return zip_u32(&buf[offset]);
+    }
+
+    std::shared_ptr<const cnpy::Source> source_;
+    std::vector<Entry> entries_;
+};
+
+cnpy::NpyArray cnpy::npy_load(std::shared_ptr<const Source> source) {
+    return load_npy_at(source, 0, source->size(), "npy_load");
+}
+
+cnpy::npz_t cnpy::npz_load(std::shared_ptr<const Source> source, unsigned threads) {
+    SourceArchive archive(source);
+    const std::vector<SourceArchive::Entry>& entries = archive.entries();
+    std::vector<NpyArray> arrays(entries.size());
+    std::vector<std::exception_ptr> errors(entries.size());
+    std::vector<size_t> sizes(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) sizes[i] = entries[i].uncompr_bytes;
+    for_each_largest_first(sizes, threads, [&](size_t i) {
+        try {
+            arrays[i] = archive.load(entries[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    npz_t result;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (errors[i]) std::rethrow_exception(errors[i]);
+        result[entries[i].name] = arrays[i];
+    }
+    return result;
+}
+
+cnpy::NpyArray cnpy::npz_load(std::shared_ptr<const Source> source, std::string varname) {
+    SourceArchive archive(source);
+    for (const SourceArchive::Entry& e : archive.entries())
+        if (e.name == varname) return archive.load(e);
+    throw std::runtime_error("npz_load: Variable name " + varname + " not found");
+}
+
+// a sink that writes to target front to back, advancing offset
+cnpy::ByteSink sequential_writer(cnpy::Target& target, size_t& offset) {
+    return [&target, &offset](const void* p, size_t n) {
+        target.write_at(p, n, offset);
+        offset += n;
+    };
+}
+
+void cnpy::npy_save(Target& target, const void* data, const Shape& shape, const DType& dtype) {
+    size_t offset = 0;
+    npy_save_sink(sequential_writer(target, offset), data, shape, dtype);
+}
+
+void cnpy::npz_save(Target& target, const std::vector<SaveItem>& items, bool compress) {
+    size_t offset = 0;
+    npz_save_sink(sequential_writer(target, offset), items, compress);
+}
+
+// a checkpoint waiting to be written: its arrays copied into one staging buffer
+struct Snapshot {
+    std::string zipname;
+    std::vector<char> buffer;
+    std::vector<cnpy::SaveItem> items;
+};
+
+struct cnpy::CheckpointWriter::Impl {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Snapshot*> queue; // filled, oldest first
+    std::vector<Snapshot*> free; // written and ready for reuse
+    std::vector<std::unique_ptr<Snapshot>> all;
+    size_t writing;              // 1 while the thread is writing a snapshot
+    std::exception_ptr error;
+    bool stop;
+    bool compress;
+    SaveManyOptions options;
+    std::thread thread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return stop || !queue.empty(); });
+            if (queue.empty()) return;
+            Snapshot* snap = queue.front();
+            queue.pop_front();
+            writing = 1;
+            lock.unlock();
+            std::exception_ptr failed;
+            try {
+                npz_save_many(snap->zipname, snap->items, compress, options);
+            } catch (...) {
+                failed = std::current_exception();
+            }
+            lock.lock();
+            if (failed && !error) error = failed;
+            writing = 0;
+            free.push_back(snap);
+            changed.notify_all();
+        }
+    }
+
+    // throw the error of a failed background write, once. called with mutex held
+    void rethrow() {
+        if (!error) return;
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+};
+
+cnpy::CheckpointWriter::CheckpointWriter(size_t buffers, bool compress, const SaveManyOptions& options) {
+    if (buffers == 0) throw std::runtime_error("CheckpointWriter: needs at least one buffer");
+    impl_.reset(new Impl);
+    for (size_t i = 0; i < buffers; ++i) {
+        impl_->all.push_back(std::unique_ptr<Snapshot>(new Snapshot));
+        impl_->free.push_back(impl_->all.back().get());
+    }
+    impl_->writing = 0;
+    impl_->stop = false;
+    impl_->compress = compress;
+    impl_->options = options;
+    impl_->thread = std::thread(&Impl::run, impl_.get());
+}
+
+cnpy::CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stop = true;
+    }
+    impl_->changed.notify_all();
+    impl_->thread.join();
+}
+
+void cnpy::CheckpointWriter::save(const std::string& zipname, const std::vector<SaveItem>& items) {
+    Snapshot* snap;
+    {
+        // backpressure: with every buffer queued or being written, wait for the oldest checkpoint to finish
+        std::unique_lock<std::mutex> lock(impl_->mutex);
+        impl_->changed.wait(lock, [this] { return !impl_->free.empty() || impl_->error; });
+        impl_->rethrow();
+        snap = impl_->free.back();
+        impl_->free.pop_back();
+    }
+
+    // the copy is the only part of a checkpoint the caller waits for. each array starts on a cache line, and the
+    // buffer keeps its capacity from one checkpoint to the next
+    const size_t align = 64;
+    size_t total = 0;
+    for (const SaveItem& item : items) total += (item.nbytes() + align - 1) / align * align;
+    try {
+        snap->buffer.resize(total);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->free.push_back(snap);
+        throw;
+    }
+    snap->zipname = zipname;
+    snap->items.clear();
+    size_t offset = 0;
+    for (const SaveItem& item : items) {
+        size_t nbytes = item.nbytes();
+        if (nbytes > 0) memcpy(&snap->buffer[offset], item.data, nbytes);
+        snap->items.push_back(SaveItem(item.fname, snap->buffer.data() + offset, item.shape, item.dtype));
+        offset += (nbytes + align - 1) / align * align;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->queue.push_back(snap);
+    }
+    impl_->changed.notify_all();
+}
+
+void cnpy::CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    impl_->changed.wait(lock, [this] { return impl_->queue.empty() && impl_->writing == 0; });
+    impl_->rethrow();
+}
+
+struct cnpy::ArrayCache::Impl {
+    // what an array was loaded from
+    struct Key {
+        dev_t dev;
+        ino_t ino;
+        off_t size;
+        time_t mtime_sec;
+        long mtime_nsec;
+        bool npz;
+        std::string entry;
+        bool operator<(const Key& other) const {
+            return std::tie(dev, ino, size, mtime_sec, mtime_nsec, npz, entry) <
+                   std::tie(other.dev, other.ino, other.size, other.mtime_sec, other.mtime_nsec, other.npz,
+                            other.entry);
+        }
+    };
+    typedef std::list<std::pair<Key, NpyArray>> Lru; // most recently used first
+
+    mutable std::mutex mutex;
+    size_t budget;
+    Lru lru;
+    std::map<Key, Lru::iterator> index;
+    ArrayCacheStats stats;
+
+    static Key key_of(const std::string& fname, bool npz, const std::string& entry) {
+        Key key;
+        if (!stat_key(fname, npz, entry, key))
+            throw std::runtime_error("ArrayCache: unable to stat file " + fname + ": " + strerror(errno));
+        return key;
+    }
+
+    // fills key from the file's current identity. false, with errno set, if it cannot be stat'ed
+    static bool stat_key(const std::string& fname, bool npz, const std::string& entry, Key& key) {
+        struct stat st;
+        if (::stat(fname.c_str(), &st) != 0) return false;
+        key.dev = st.st_dev;
+        key.ino = st.st_ino;
+        key.size = st.st_size;
+        key.mtime_sec = st.st_mtim.tv_sec;
+        key.mtime_nsec = st.st_mtim.tv_nsec;
+        key.npz = npz;
+        key.entry = entry;
+        return true;
+    }
+
+    // drop least recently used arrays until the rest fit in the budget. called with mutex held
+    void evict() {
+        while (stats.bytes > budget) {
+            stats.bytes -= lru.back().second.num_bytes();
+            index.erase(lru.back().first);
+            lru.pop_back();
+            --stats.entries;
+            ++stats.evictions;
+        }
+    }
+
+    // the cached array for the file, or one from load. the lock is not held while loading, so lookups of other
+    // arrays go on meanwhile. the file is stat'ed again after loading and the array is only cached when it is still
+    // the same file, so a rewrite that races the load cannot leave new contents cached under the old identity
+    NpyArray get(const std::string& fname, bool npz, const std::string& entry, const std::function<NpyArray()>& load) {
+        Key key = key_of(fname, npz, entry);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::map<Key, Lru::iterator>::iterator it = index.find(key);
+            if (it != index.end()) {
+                lru.splice(lru.begin(), lru, it->second);
+                ++stats.hits;
+                return it->second->second;
+            }
+            ++stats.misses;
+        }
+        NpyArray array = load();
+        Key after;
+        if (!stat_key(fname, npz, entry, after) || key < after || after < key) return array;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t nbytes = array.num_bytes();
+        if (nbytes > budget || index.count(key)) return array;
+        lru.push_front(std::make_pair(key, array));
+        index[key] = lru.begin();
+        ++stats.entries;
+        stats.bytes += nbytes;
+        evict();
+        return array;
+    }
+};
+
+cnpy::ArrayCache::ArrayCache(size_t budget) : impl_(new Impl) { impl_->budget = budget; }
+
+cnpy::ArrayCache::~ArrayCache() {}
+
+cnpy::ArrayCache& cnpy::ArrayCache::shared() {
+    // leaked, so that it outlives any use from other static destructors
+    static ArrayCache* cache = new ArrayCache(size_t(1) << 30);
+    return *cache;
+}
+
+cnpy::NpyArray cnpy::ArrayCache::npy_load(const std::string& fname) {
+    return impl_->get(fname, false, std::string(), [&fname]() { return cnpy::npy_load(fname); });
+}
+
+cnpy::NpyArray cnpy::ArrayCache::npz_load(const std::string& fname, const std::string& varname) {
+    return impl_->get(fname, true, varname, [&fname, &varname]() { return cnpy::npz_load(fname, varname); });
+}
+
+void cnpy::ArrayCache::set_budget(size_t budget) {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->budget = budget;
+    impl_->evict();
+}
+
+void cnpy::ArrayCache::clear() {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->lru.clear();
+    impl_->index.clear();
+    impl_->stats.entries = 0;
+    impl_->stats.bytes = 0;
+}
+
+cnpy::ArrayCacheStats cnpy::ArrayCache::stats() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->stats;
 }
@@ -8,7 +8,12 @@
 
 #include "mmap_util.h"
 #include <cassert>
+#include <complex>
+#include <cstddef>
 #include <cstdio>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -25,6 +30,24 @@
 namespace cnpy {
 
     using Shape = std::vector<size_t>;
+
+    // Memory layout requested from a loader. AsStored keeps the order recorded in the file.
+    enum class MemoryOrder { AsStored, C, Fortran };
+
+    // page cache use of a load or save. Stream is for data not needed again soon: its pages are dropped as it goes
+    // (Linux only; elsewhere the same as Normal)
+    enum class CachePolicy { Normal, Stream };
+
+    // Selects the indices start, start + step, ... below stop along one axis, like a python slice with a positive
+    // step. stop is clamped to the extent of the axis.
+    struct Slice {
+        size_t start;
+        size_t stop;
+        size_t step;
+        Slice(size_t start_, size_t stop_, size_t step_ = 1) : start(start_), stop(stop_), step(step_) {}
+        static Slice all() { return Slice(0, static_cast<size_t>(-1)); }
+    };
+
     struct ShapeAndType {
         Shape shape;
         const std::type_info& type_info;
@@ -33,34 +56,265 @@ namespace cnpy {
             : shape(shape_), type_info(type_info_), name(name_) {}
     };
 
+    char BigEndianTest();
+
+    // IEEE 754 half precision value held as its bit pattern; numpy's float16 ('<f2')
+    struct float16 {
+        uint16_t bits;
+    };
+
+    // bfloat16 value (the top half of a float32) held as its bit pattern. numpy has no bfloat16 dtype; like the
+    // ml_dtypes package these arrays are saved as two-byte voids ('<V2')
+    struct bfloat16 {
+        uint16_t bits;
+    };
+
+    // Every C++ type with a numpy equivalent, paired with its dtype kind character. Expands X(type, kind) per type.
+#define CNPY_FOR_EACH_TYPE(X)                                                                                          \
+    X(float, 'f') X(double, 'f') X(long double, 'f')                                                                   \
+    X(char, 'i') X(signed char, 'i') X(short, 'i') X(int, 'i') X(long, 'i') X(long long, 'i')                          \
+    X(unsigned char, 'u') X(unsigned short, 'u') X(unsigned int, 'u') X(unsigned long, 'u')                            \
+    X(unsigned long long, 'u') X(bool, 'b')                                                                            \
+    X(std::complex<float>, 'c') X(std::complex<double>, 'c') X(std::complex<long double>, 'c')                         \
+    X(cnpy::float16, 'f') X(cnpy::bfloat16, 'V')
+
+    // Compile-time numpy kind of a C++ type; '?' for types numpy has no equivalent for
+    template <typename T> struct npy_type {
+        static const char kind = '?';
+    };
+    template <typename T> const char npy_type<T>::kind;
+#define CNPY_NPY_TYPE(T, K)                                                                                            \
+    template <> struct npy_type<T> {                                                                                   \
+        static const char kind = K;                                                                                    \
+    };
+    CNPY_FOR_EACH_TYPE(CNPY_NPY_TYPE)
+#undef CNPY_NPY_TYPE
+
+    // Runtime description of a numpy dtype: kind character ('f', 'i', 'u', 'b', 'c', ...), item size in bytes and byte
+    // order ('<', '>', or '|' where it does not apply)
+    struct Field;
+
+    struct DType {
+        char kind;
+        size_t size;
+        char byte_order;
+        // fields of a structured (record) dtype, in file order; null for plain dtypes. structured dtypes have kind
+        // 'V', byte order '|' and size equal to the record size
+        std::shared_ptr<const std::vector<Field>> fields;
+
+        DType() : kind('?'), size(0), byte_order('|') {}
+        DType(char kind_, size_t size_) : kind(kind_), size(size_), byte_order(BigEndianTest()) {}
+        DType(char kind_, size_t size_, char byte_order_) : kind(kind_), size(size_), byte_order(byte_order_) {}
+
+        template <typename T> static DType of() { return DType(npy_type<T>::kind, sizeof(T)); }
+        // a record dtype of the given size; fields may be listed in any order but must not overlap
+        static DType structured(const std::vector<Field>& fields, size_t itemsize);
+
+        bool is_structured() const { return fields != nullptr; }
+        // the field called name; throws if there is none
+        const Field& field(const std::string& name) const;
+
+        // true if the data can be used in place on this machine
+        inline bool is_native() const;
+        // the same dtype in this machine's byte order
+        DType native() const;
+        // same kind and size in native order, i.e. a T* over the data is valid
+        template <typename T> bool holds() const {
+            return kind == npy_type<T>::kind && size == sizeof(T) && is_native();
+        }
+
+        // descr string as written in an .npy header, e.g. "<f8"; "|V<size>" for structured dtypes. size is in bytes,
+        // but numpy counts 'U' (UCS-4) strings in characters
+        std::string str() const {
+            return std::string(1, byte_order) + kind + std::to_string(kind == 'U' ? size / 4 : size);
+        }
+        // the python literal for the 'descr' entry of an .npy header: "'<f8'", or a list of fields such as
+        // "[('x', '<f4'), ('id', '<i8')]"
+        std::string descr() const;
+
+        inline bool operator==(const DType& other) const;
+        bool operator!=(const DType& other) const { return !(*this == other); }
+        // same kind, size and bytes in memory, e.g. "|u1" and "<u1", or "=i4" and "<i4" on a little-endian machine
+        inline bool same_layout(const DType& other) const;
+    };
+
+    // One named member of a structured dtype
+    struct Field {
+        std::string name;
+        DType dtype;
+        size_t offset; // byte offset within a record
+        Shape shape;   // subarray shape, empty for a scalar field
+
+        Field(const std::string& name_, const DType& dtype_, size_t offset_, const Shape& shape_ = Shape())
+            : name(name_), dtype(dtype_), offset(offset_), shape(shape_) {}
+
+        // number of dtype elements in the field
+        size_t count() const {
+            return std::accumulate(shape.begin(), shape.end(), (size_t)1, std::multiplies<size_t>());
+        }
+        size_t num_bytes() const { return count() * dtype.size; }
+
+        bool operator==(const Field& other) const {
+            return name == other.name && dtype == other.dtype && offset == other.offset && shape == other.shape;
+        }
+    };
+
+    bool DType::is_native() const {
+        if (fields) {
+            for (const Field& f : *fields)
+                if (!f.dtype.is_native()) return false;
+            return true;
+        }
+        return byte_order == '|' || byte_order == '=' || byte_order == BigEndianTest() || size == 1;
+    }
+
+    bool DType::operator==(const DType& other) const {
+        if (kind != other.kind || size != other.size || byte_order != other.byte_order) return false;
+        if (!fields || !other.fields) return !fields && !other.fields;
+        return *fields == *other.fields;
+    }
+
+    bool DType::same_layout(const DType& other) const {
+        if (kind != other.kind || size != other.size) return false;
+        if (fields || other.fields) {
+            if (!fields || !other.fields || fields->size() != other.fields->size()) return false;
+            for (size_t i = 0; i < fields->size(); ++i) {
+                const Field& a = (*fields)[i];
+                const Field& b = (*other.fields)[i];
+                if (a.name != b.name || a.offset != b.offset || a.shape != b.shape || !a.dtype.same_layout(b.dtype))
+                    return false;
+            }
+            return true;
+        }
+        if (byte_order == other.byte_order || size == 1) return true;
+        if (byte_order == '|' || byte_order == '=' || other.byte_order == '|' || other.byte_order == '=') return true;
+        return false;
+    }
+
+    // element type and subarray shape of a struct member, for describing C++ structs as numpy records
+    template <typename T> struct field_type {
+        static DType dtype() { return DType::of<T>(); }
+        static Shape shape() { return Shape(); }
+    };
+    template <typename T, size_t N> struct field_type<T[N]> {
+        static DType dtype() { return field_type<T>::dtype(); }
+        static Shape shape() {
+            Shape inner = field_type<T>::shape();
+            inner.insert(inner.begin(), N);
+            return inner;
+        }
+    };
+
+    // Field describing member m of struct S, e.g.
+    //   DType::structured({CNPY_FIELD(Point, x), CNPY_FIELD(Point, id)}, sizeof(Point))
+#define CNPY_FIELD(S, m)                                                                                               \
+    cnpy::Field(#m, cnpy::field_type<decltype(S::m)>::dtype(), offsetof(S, m),                                         \
+                cnpy::field_type<decltype(S::m)>::shape())
+
+    // Strided view of one field of a structured array, over the array's own memory (heap, caller buffer or mmap).
+    // Records are often packed, so elements are copied in and out with memcpy rather than referenced.
+    template <typename T> class FieldView {
+      public:
+        FieldView(char* base, size_t stride, size_t size, size_t width)
+            : base_(base), stride_(stride), size_(size), width_(width) {}
+
+        size_t size() const { return size_; }     // number of records
+        size_t width() const { return width_; }   // elements of the field per record (1 unless it is a subarray)
+        size_t stride() const { return stride_; } // bytes between records
+
+        char* ptr(size_t i, size_t j = 0) const { return base_ + i * stride_ + j * sizeof(T); }
+        T get(size_t i, size_t j = 0) const {
+            T v;
+            memcpy(&v, ptr(i, j), sizeof(T));
+            return v;
+        }
+        void set(size_t i, const T& v) { memcpy(ptr(i), &v, sizeof(T)); }
+        void set(size_t i, size_t j, const T& v) { memcpy(ptr(i, j), &v, sizeof(T)); }
+        T operator[](size_t i) const { return get(i); }
+
+      private:
+        char* base_;
+        size_t stride_;
+        size_t size_;
+        size_t width_;
+    };
+
+    // Read-only reference to one element of a fixed-width string array ('S' bytes or 'U' UCS-4 code points), without
+    // numpy's trailing NUL padding. Points into the array's memory, so it is only valid while the array is alive.
+    template <typename Char> class FixedStringRef {
+      public:
+        FixedStringRef(const Char* data, size_t size) : data_(data), size_(size) {}
+
+        const Char* data() const { return data_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        const Char* begin() const { return data_; }
+        const Char* end() const { return data_ + size_; }
+        Char operator[](size_t i) const { return data_[i]; }
+
+        std::basic_string<Char> str() const { return std::basic_string<Char>(data_, size_); }
+        bool operator==(const std::basic_string<Char>& other) const {
+            return other.size() == size_ && std::char_traits<Char>::compare(data_, other.data(), size_) == 0;
+        }
+        bool operator!=(const std::basic_string<Char>& other) const { return !(*this == other); }
+
+      private:
+        const Char* data_;
+        size_t size_;
+    };
+
+    typedef FixedStringRef<char> BytesRef;
+    typedef FixedStringRef<char32_t> UnicodeRef;
+
+    // encode UCS-4 code points as UTF-8
+    std::string to_utf8(const UnicodeRef& s);
+
     // Represents a loaded NPY array, either in memory or memory-mapped
     struct NpyArray {
         // Constructor for regular in‑memory array
         NpyArray(const Shape& _shape, size_t _word_size, bool _fortran_order)
-            : data_holder(nullptr), mmap_file(nullptr), data_offset(0), shape(_shape), word_size(_word_size),
-              fortran_order(_fortran_order), num_vals(0) {
+            : data_holder(nullptr), mmap_file(nullptr), data_offset(0), external_data(nullptr), shape(_shape),
+              word_size(_word_size), fortran_order(_fortran_order), num_vals(0), dtype('?', _word_size) {
             num_vals = 1;
             for (size_t i = 0; i < shape.size(); ++i) num_vals *= shape[i];
             data_holder = std::make_shared<std::vector<char>>(num_vals * word_size);
         }
 
+        // Constructor for regular in‑memory array of a known dtype
+        NpyArray(const Shape& _shape, const DType& _dtype, bool _fortran_order)
+            : NpyArray(_shape, _dtype.size, _fortran_order) {
+            dtype = _dtype;
+        }
+
         // Constructor for mmap‑backed array
         NpyArray(const Shape& _shape, size_t _word_size, bool _fortran_order,
                  std::shared_ptr<MMapFile> _mmap_file, size_t _data_offset)
-            : data_holder(nullptr), mmap_file(std::move(_mmap_file)), data_offset(_data_offset), shape(_shape),
-              word_size(_word_size), fortran_order(_fortran_order), num_vals(0) {
+            : data_holder(nullptr), mmap_file(std::move(_mmap_file)), data_offset(_data_offset),
+              external_data(nullptr), shape(_shape), word_size(_word_size), fortran_order(_fortran_order),
+              num_vals(0), dtype('?', _word_size) {
+            num_vals = 1;
+            for (size_t i = 0; i < shape.size(); ++i) num_vals *= shape[i];
+        }
+
+        // Constructor for an array over a caller-owned buffer; the buffer must outlive the array (or be kept alive
+        // through owner)
+        NpyArray(const Shape& _shape, size_t _word_size, bool _fortran_order, void* _external_data)
+            : data_holder(nullptr), mmap_file(nullptr), data_offset(0),
+              external_data(static_cast<char*>(_external_data)), shape(_shape), word_size(_word_size),
+              fortran_order(_fortran_order), num_vals(0), dtype('?', _word_size) {
             num_vals = 1;
             for (size_t i = 0; i < shape.size(); ++i) num_vals *= shape[i];
         }
 
         NpyArray()
-            : data_holder(nullptr), mmap_file(nullptr), data_offset(0), shape(), word_size(0), fortran_order(0),
-              num_vals(0) {}
+            : data_holder(nullptr), mmap_file(nullptr), data_offset(0), external_data(nullptr), shape(), word_size(0),
+              fortran_order(0), num_vals(0), dtype() {}
 
         template <typename T> T* data() {
             if (mmap_file) {
                 return reinterpret_cast<T*>(mmap_file->data() + data_offset);
             }
+            if (external_data) return reinterpret_cast<T*>(external_data);
             return reinterpret_cast<T*>(&(*data_holder)[0]);
         }
 
@@ -68,16 +322,61 @@ namespace cnpy {
             if (mmap_file) {
                 return reinterpret_cast<const T*>(mmap_file->data() + data_offset);
             }
+            if (external_data) return reinterpret_cast<const T*>(external_data);
             return reinterpret_cast<const T*>(&(*data_holder)[0]);
         }
 
+        // like data<T>(), but throws unless the array's dtype is exactly T in native byte order
+        template <typename T> T* checked_data() {
+            check_dtype<T>();
+            return data<T>();
+        }
+
+        template <typename T> const T* checked_data() const {
+            check_dtype<T>();
+            return data<T>();
+        }
+
+        // zero-copy view of the field called name of a structured array; throws unless the field holds T in native
+        // byte order
+        template <typename T> FieldView<T> field(const std::string& name) const {
+            const Field& f = dtype.field(name);
+            if (!f.dtype.holds<T>())
+                throw std::runtime_error("NpyArray: field " + name + " holds " + f.dtype.str() + ", not " +
+                                         DType::of<T>().str());
+            return FieldView<T>(const_cast<char*>(data<char>()) + f.offset, dtype.size, num_vals, f.count());
+        }
+
+        // element i of an 'S' array
+        BytesRef bytes_at(size_t i) const {
+            if (dtype.kind != 'S')
+                throw std::runtime_error("NpyArray: bytes_at needs an 'S' array, not " + dtype.str());
+            const char* p = data<char>() + i * word_size;
+            size_t n = word_size;
+            while (n > 0 && p[n - 1] == 0) --n;
+            return BytesRef(p, n);
+        }
+
+        // element i of a native-order 'U' array
+        UnicodeRef unicode_at(size_t i) const {
+            if (dtype.kind != 'U' || !dtype.is_native())
+                throw std::runtime_error("NpyArray: unicode_at needs a native 'U' array, not " + dtype.str());
+            const char32_t* p = data<char32_t>() + i * (word_size / 4);
+            size_t n = word_size / 4;
+            while (n > 0 && p[n - 1] == 0) --n;
+            return UnicodeRef(p, n);
+        }
+
+        // every element of an 'S' array, or of a 'U' array encoded as UTF-8
+        std::vector<std::string> as_strings() const;
+
         template <typename T> std::vector<T> as_vec() const {
             const T* p = data<T>();
             return std::vector<T>(p, p + num_vals);
         }
 
         size_t num_bytes() const {
-            if (mmap_file) {
+            if (mmap_file || external_data) {
                 return num_vals * word_size;
             }
             assert(data_holder->size() == num_vals * word_size);
@@ -87,19 +386,32 @@ namespace cnpy {
         std::shared_ptr<std::vector<char>> data_holder;
         std::shared_ptr<MMapFile> mmap_file;
         size_t data_offset;
+        char* external_data;
+        std::shared_ptr<const void> owner; // if set, keeps external_data alive
         Shape shape;
         size_t word_size;
         bool fortran_order;
         size_t num_vals;
+        DType dtype;
+
+      private:
+        template <typename T> void check_dtype() const {
+            if (!dtype.holds<T>())
+                throw std::runtime_error("NpyArray: array holds " + dtype.str() + ", not " + DType::of<T>().str());
+        }
     };
 
     using npz_t = std::map<std::string, NpyArray>;
 
-    char BigEndianTest();
     char map_type(const std::type_info& t);
+    // dtype of a type listed in CNPY_FOR_EACH_TYPE; kind '?' for anything else
+    DType dtype_of(const std::type_info& t);
     template <typename T> std::vector<char> create_npy_header(const Shape& shape);
+    std::vector<char> create_npy_header(const Shape& shape, const DType& dtype, bool fortran_order = false);
     void parse_npy_header(FILE* fp, size_t& word_size, Shape& shape, bool& fortran_order);
     void parse_npy_header(unsigned char* buffer, size_t& word_size, Shape& shape, bool& fortran_order);
+    void parse_npy_header(FILE* fp, DType& dtype, Shape& shape, bool& fortran_order);
+    void parse_npy_header(const unsigned char* buffer, DType& dtype, Shape& shape, bool& fortran_order);
     void parse_zip_footer(FILE* fp, uint16_t& nrecs, size_t& global_header_size, size_t& global_header_offset);
 
     // load a .npy file, if use_mmap is true, memory-map the file instead of reading it into memory (allows read-write)
@@ -110,6 +422,134 @@ namespace cnpy {
     // load a .npy file. if use_mmap is true, memory-map the file instead of reading it into memory (allows read-write)
     NpyArray npy_load(std::string fname, bool use_mmap = false);
 
+    // convert between float32 and half precision or bfloat16, rounding to nearest even. the array versions use F16C
+    // instructions on CPUs that have them
+    void to_float(const float16* src, float* dst, size_t n);
+    void to_float16(const float* src, float16* dst, size_t n);
+    void to_float(const bfloat16* src, float* dst, size_t n);
+    void to_bfloat16(const float* src, bfloat16* dst, size_t n);
+    float to_float(float16 h);
+    float16 to_float16(float f);
+    float to_float(bfloat16 b);
+    bfloat16 to_bfloat16(float f);
+
+    // copy the field called name of a structured array into a new packed array of shape arr.shape + field.shape,
+    // swapped to native order
+    NpyArray gather_field(const NpyArray& arr, const std::string& name);
+
+    // Loaders that copy data byte-swap non-native (e.g. '>f8') arrays to native order while reading. Memory-mapped
+    // arrays keep the stored byte order, visible in arr.dtype; as_native returns arr itself if it is already native,
+    // otherwise an in-memory copy swapped to native order.
+    NpyArray as_native(const NpyArray& arr);
+
+    // load into memory converting each element to the given numeric dtype ('f', 'i', 'u' or 'b' kinds), chunk by
+    // chunk as the data is read. narrowing conversions throw std::range_error if a value does not fit
+    NpyArray npy_load_as(std::string fname, const DType& dtype);
+    NpyArray npz_load_as(std::string fname, std::string varname, const DType& dtype);
+
+    template <typename T> NpyArray npy_load_as(std::string fname) { return npy_load_as(fname, DType::of<T>()); }
+
+    template <typename T> NpyArray npz_load_as(std::string fname, std::string varname) {
+        return npz_load_as(fname, varname, DType::of<T>());
+    }
+
+    // Load from a .npy or .npz image already in memory, e.g. one received over the network. Stored entries in native
+    // byte order are not copied: the arrays point into the buffer, which must stay alive as long as they do. pass
+    // the buffer's owner (say, a shared_ptr to the vector holding it) to have every array keep it alive. deflated
+    // entries are inflated straight from the buffer into new arrays, and byte-swapped ones are copied
+    NpyArray npy_load_buffer(const void* data, size_t size, std::shared_ptr<const void> owner = nullptr);
+    npz_t npz_load_buffer(const void* data, size_t size, std::shared_ptr<const void> owner = nullptr);
+    NpyArray npz_load_buffer(const void* data, size_t size, std::string varname,
+                             std::shared_ptr<const void> owner = nullptr);
+
+    // how npy_load and npz_load read a file; the options combine freely
+    struct LoadOptions {
+        bool mmap;         // map read-write instead of reading; deflated npz entries are always read
+        MemoryOrder order; // for arrays that are not mapped
+        CachePolicy cache;
+        LoadOptions() : mmap(false), order(MemoryOrder::AsStored), cache(CachePolicy::Normal) {}
+    };
+
+    NpyArray npy_load(std::string fname, const LoadOptions& options);
+    npz_t npz_load(std::string fname, const LoadOptions& options);
+    NpyArray npz_load(std::string fname, std::string varname, const LoadOptions& options);
+
+    // shorthands for a LoadOptions with only cache or order set
+    NpyArray npy_load(std::string fname, CachePolicy cache);
+    npz_t npz_load(std::string fname, CachePolicy cache);
+    NpyArray npz_load(std::string fname, std::string varname, CachePolicy cache);
+    NpyArray npy_load(std::string fname, MemoryOrder order);
+    npz_t npz_load(std::string fname, MemoryOrder order);
+    NpyArray npz_load(std::string fname, std::string varname, MemoryOrder order);
+
+    // load a .npy file straight into dst, which must hold at least capacity bytes. the returned NpyArray refers to
+    // dst instead of owning a copy. the overloads taking shape and dtype throw before reading anything if the stored
+    // array does not match them
+    NpyArray npy_load_into(std::string fname, void* dst, size_t capacity);
+    NpyArray npy_load_into(std::string fname, void* dst, size_t capacity, const Shape& shape, const DType& dtype);
+
+    // same as npy_load_into for the array varname of a .npz file; deflated entries are inflated directly into dst
+    NpyArray npz_load_into(std::string fname, std::string varname, void* dst, size_t capacity);
+    NpyArray npz_load_into(std::string fname, std::string varname, void* dst, size_t capacity, const Shape& shape,
+                           const DType& dtype);
+
+    // load the hyperslab of a .npy file picked by one Slice per leading axis (missing trailing axes are taken whole).
+    // only the selected bytes are read, with one pread per contiguous run of the file. the result is a compact array
+    // with the sliced shape and the same memory order as the file
+    NpyArray npy_load_slice(std::string fname, const std::vector<Slice>& selection);
+
+    // load rows [row_begin, row_end) along the first axis of a C-order array in a .npz file. deflated entries are
+    // inflated only as far as the last requested row
+    NpyArray npz_load_rows(std::string fname, std::string varname, size_t row_begin, size_t row_end);
+
+    // Random access into one entry of a .npz file. For deflated entries the constructor inflates the entry once and
+    // records the decompressor state every span bytes of output (as in zlib's zran example), so each later read
+    // only inflates from the nearest preceding access point. Stored entries are read directly.
+    class NpzSeekIndex {
+      public:
+        NpzSeekIndex(std::string fname, std::string varname, size_t span = 1 << 20);
+
+        // copy nbytes of array data starting at byte offset (relative to the start of the data) into dst, in the byte
+        // order given by dtype()
+        void read(size_t offset, void* dst, size_t nbytes) const;
+        // rows [row_begin, row_end) along the first axis of a C-order array
+        NpyArray load_rows(size_t row_begin, size_t row_end) const;
+
+        const Shape& shape() const { return shape_; }
+        size_t word_size() const { return dtype_.size; }
+        const DType& dtype() const { return dtype_; }
+        bool fortran_order() const { return fortran_order_; }
+        size_t num_points() const { return points_.size(); }
+
+        struct AccessPoint {
+            size_t out;                       // offset in the inflated entry
+            size_t in;                        // offset in the compressed entry of the first complete byte
+            int bits;                         // bits of the preceding byte still to be inflated, 0 to 7
+            std::vector<unsigned char> window; // the last 32K of output before this point
+        };
+
+      private:
+        std::string fname_;
+        size_t entry_offset_;  // file offset of the entry's (possibly compressed) data
+        size_t compr_bytes_;
+        bool compressed_;
+        size_t header_bytes_;  // size of the .npy header at the start of the entry
+        Shape shape_;
+        DType dtype_;
+        bool fortran_order_;
+        std::vector<AccessPoint> points_;
+    };
+
+    template <typename T> NpyArray npy_load_into(std::string fname, T* dst, const Shape& shape) {
+        size_t nels = std::accumulate(shape.begin(), shape.end(), (size_t)1, std::multiplies<size_t>());
+        return npy_load_into(fname, static_cast<void*>(dst), nels * sizeof(T), shape, DType::of<T>());
+    }
+
+    template <typename T> NpyArray npz_load_into(std::string fname, std::string varname, T* dst, const Shape& shape) {
+        size_t nels = std::accumulate(shape.begin(), shape.end(), (size_t)1, std::multiplies<size_t>());
+        return npz_load_into(fname, varname, static_cast<void*>(dst), nels * sizeof(T), shape, DType::of<T>());
+    }
+
     template <typename T>
     static NpyArray new_npy_mmap(std::string filename, const Shape& _shape, bool _fortran_order) {
         // create a new file and truncate it to the correct size
@@ -127,7 +567,9 @@ namespace cnpy {
         auto mmap_file = std::make_shared<MMapFile>(fd, "rw");
         // write the header
         memcpy(const_cast<char*>(mmap_file->data()), &header[0], header.size());
-        return NpyArray(_shape, _word_size, _fortran_order, mmap_file, header.size());
+        NpyArray arr(_shape, _word_size, _fortran_order, mmap_file, header.size());
+        arr.dtype = DType::of<T>();
+        return arr;
     };
 
     // creates a new .npz file with memory-mapped arrays with the specified shapes and types
@@ -145,185 +587,66 @@ namespace cnpy {
     template <> std::vector<char>& operator+=(std::vector<char>& lhs, const std::string rhs);
     template <> std::vector<char>& operator+=(std::vector<char>& lhs, const char* rhs);
 
-    template <typename T>
-    void npy_save(std::string fname, const T* data, const Shape &shape, std::string mode = "w") {
-        FILE* fp = NULL;
-        Shape true_data_shape; // if appending, the shape of existing + new data
-
-        if (mode == "a") fp = fopen(fname.c_str(), "r+b");
-
-        if (fp) {
-            // file exists. we need to append to it. read the header, modify the array size
-            size_t word_size;
-            bool fortran_order;
-            parse_npy_header(fp, word_size, true_data_shape, fortran_order);
-            assert(!fortran_order);
-
-            if (word_size != sizeof(T)) {
-                std::cout << "libnpy error: " << fname << " has word size " << word_size
-                          << " but npy_save appending data sized " << sizeof(T) << "\n";
-                assert(word_size == sizeof(T));
-            }
-            if (true_data_shape.size() != shape.size()) {
-                std::cout << "libnpy error: npy_save attempting to append misdimensioned data to " << fname << "\n";
-                assert(true_data_shape.size() != shape.size());
-            }
-
-            for (size_t i = 1; i < shape.size(); i++) {
-                if (shape[i] != true_data_shape[i]) {
-                    std::cout << "libnpy error: npy_save attempting to append misshaped data to " << fname << "\n";
-                    assert(shape[i] == true_data_shape[i]);
-                }
-            }
-            true_data_shape[0] += shape[0];
-        } else {
-            fp = fopen(fname.c_str(), "wb");
-            true_data_shape = shape;
-        }
+    // A run of bytes in memory, one piece of an array that is not stored contiguously
+    struct Segment {
+        const void* data;
+        size_t size;
+        Segment(const void* _data, size_t _size) : data(_data), size(_size) {}
+    };
 
-        std::vector<char> header = create_npy_header<T>(true_data_shape);
-        size_t nels = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<size_t>());
+    // what a save flushes to stable storage before it returns: nothing (left to the kernel), the file's data and
+    // size (fdatasync), or the file and its directory entry (fsync of both)
+    enum class FsyncPolicy { None, Data, Full };
 
-        fseek(fp, 0, SEEK_SET);
-        fwrite(&header[0], sizeof(char), header.size(), fp);
-        fseek(fp, 0, SEEK_END);
-        fwrite(data, sizeof(T), nels, fp);
-        fclose(fp);
+    // how npy_save writes a new file
+    struct SaveOptions {
+        bool direct;       // O_DIRECT where the filesystem allows it; the header is padded to keep the data aligned
+        bool preallocate;  // fallocate the whole file first
+        bool atomic;       // write a temporary file and rename it over the target once complete
+        FsyncPolicy fsync; // applied before an atomic rename
+        CachePolicy cache; // O_DIRECT writes bypass the cache anyway
+        SaveOptions()
+            : direct(false), preallocate(true), atomic(false), fsync(FsyncPolicy::None), cache(CachePolicy::Normal) {}
     };
 
+    // write an array of any dtype from raw memory in native order. a non-native dtype.byte_order (e.g. '>') writes
+    // the data byte-swapped to that order. mode "a" appends along the first axis of an existing .npy file, or adds an
+    // entry to an existing .npz file
+    void npy_save(std::string fname, const void* data, const Shape& shape, const DType& dtype, std::string mode = "w");
+    void npz_save(std::string zipname, std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                  std::string mode = "w", bool compress = false);
+
+    // same as above for data given as segments whose concatenation is the array in C order, e.g. the rows of a
+    // column slice. segments are written with writev in batches (or deflated one by one), without a staging copy; for
+    // npz entries the CRC is computed as the data goes out
+    void npy_save(std::string fname, const std::vector<Segment>& segments, const Shape& shape, const DType& dtype,
+                  std::string mode = "w");
+    void npz_save(std::string zipname, std::string fname, const std::vector<Segment>& segments, const Shape& shape,
+                  const DType& dtype, std::string mode = "w", bool compress = false);
+
+    // create fname (replacing any existing file) with the given options
+    void npy_save(std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                  const SaveOptions& options);
+    void npy_save(std::string fname, const std::vector<Segment>& segments, const Shape& shape, const DType& dtype,
+                  const SaveOptions& options);
+
+    // add to or create zipname with the given options. with options.atomic, appending copies the archive's existing
+    // entries into the new file. options.direct does not apply to .npz files
+    void npz_save(std::string zipname, std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                  std::string mode, bool compress, const SaveOptions& options);
+    void npz_save(std::string zipname, std::string fname, const std::vector<Segment>& segments, const Shape& shape,
+                  const DType& dtype, std::string mode, bool compress, const SaveOptions& options);
+
+    template <typename T>
+    void npy_save(std::string fname, const T* data, const Shape& shape, std::string mode = "w") {
+        npy_save(fname, static_cast<const void*>(data), shape, DType::of<T>(), mode);
+    }
+
     template <typename T>
     void npz_save(std::string zipname, std::string fname, const T* data, const Shape& shape,
                   std::string mode = "w", bool compress = false) {
-        // first, append a .npy to the fname
-        fname += ".npy";
-
-        // now, on with the show
-        FILE* fp = NULL;
-        uint16_t nrecs = 0;
-        size_t global_header_offset = 0;
-        std::vector<char> global_header;
-
-        if (mode == "a") fp = fopen(zipname.c_str(), "r+b");
-
-        if (fp) {
-            // zip file exists. we need to add a new npy file to it.
-            // first read the footer. this gives us the offset and size of the global header
-            // then read and store the global header.
-            // below, we will write the the new data at the start of the global header then append the global header and
-            // footer below it
-            size_t global_header_size;
-            parse_zip_footer(fp, nrecs, global_header_size, global_header_offset);
-            fseek(fp, global_header_offset, SEEK_SET);
-            global_header.resize(global_header_size);
-            size_t res = fread(&global_header[0], sizeof(char), global_header_size, fp);
-            if (res != global_header_size) {
-                throw std::runtime_error("npz_save: header read error while adding to existing zip");
-            }
-            fseek(fp, global_header_offset, SEEK_SET);
-        } else {
-            fp = fopen(zipname.c_str(), "wb");
-        }
-
-        std::vector<char> npy_header = create_npy_header<T>(shape);
-
-        size_t nels = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<size_t>());
-        size_t nbytes = nels * sizeof(T) + npy_header.size();
-
-        // get the CRC of the data to be added
-        uint32_t crc = crc32(0L, (uint8_t*)&npy_header[0], npy_header.size());
-        crc = crc32(crc, (uint8_t*)data, nels * sizeof(T));
-
-        // prepare compression if requested
-        std::vector<unsigned char> compr_buf;
-        uint16_t compr_method = 0;
-        uint32_t compr_bytes_val = nbytes;
-
-        if (compress) {
-            // build raw buffer of header + data for deflation
-            compr_buf.reserve(nbytes);
-            compr_buf.insert(compr_buf.end(), npy_header.begin(), npy_header.end());
-            const unsigned char* raw_data = reinterpret_cast<const unsigned char*>(data);
-            compr_buf.insert(compr_buf.end(), raw_data, raw_data + nels * sizeof(T));
-
-            // deflate (raw, no wrapper) for zip entry
-            z_stream c_stream;
-            c_stream.zalloc = Z_NULL;
-            c_stream.zfree = Z_NULL;
-            c_stream.opaque = Z_NULL;
-            c_stream.next_in = compr_buf.data();
-            c_stream.avail_in = compr_buf.size();
-            int err = deflateInit2(&c_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
-            if (err != Z_OK) throw std::runtime_error("npz_save: deflateInit2 failed");
-            std::vector<unsigned char> tmp(deflateBound(&c_stream, compr_buf.size()));
-            c_stream.next_out = tmp.data();
-            c_stream.avail_out = tmp.size();
-            err = deflate(&c_stream, Z_FINISH);
-            if (err != Z_STREAM_END) {
-                deflateEnd(&c_stream);
-                throw std::runtime_error("npz_save: deflate failed");
-            }
-            compr_bytes_val = c_stream.total_out;
-            err = deflateEnd(&c_stream);
-            if (err != Z_OK) throw std::runtime_error("npz_save: deflateEnd failed");
-            compr_buf.assign(tmp.data(), tmp.data() + compr_bytes_val);
-            compr_method = 8; // deflate compression
-        }
-
-        // build the local header
-        std::vector<char> local_header;
-        local_header += "PK";                      // first part of sig
-        local_header += (uint16_t)0x0403;          // second part of sig
-        local_header += (uint16_t)20;              // min version to extract
-        local_header += (uint16_t)0;               // general purpose bit flag
-        local_header += compr_method;              // compression method
-        local_header += (uint16_t)0;               // file last mod time
-        local_header += (uint16_t)0;               // file last mod date
-        local_header += (uint32_t)crc;             // crc
-        local_header += (uint32_t)compr_bytes_val; // compressed size
-        local_header += (uint32_t)nbytes;          // uncompressed size
-        local_header += (uint16_t)fname.size();    // fname length
-        local_header += (uint16_t)0;               // extra field length
-        local_header += fname;
-
-        // build global header
-        global_header += "PK";             // first part of sig
-        global_header += (uint16_t)0x0201; // second part of sig
-        global_header += (uint16_t)20;     // version made by
-        global_header.insert(global_header.end(), local_header.begin() + 4, local_header.begin() + 30);
-        global_header += (uint16_t)0;                    // file comment length
-        global_header += (uint16_t)0;                    // disk number where file starts
-        global_header += (uint16_t)0;                    // internal file attributes
-        global_header += (uint32_t)0;                    // external file attributes
-        global_header += (uint32_t)global_header_offset; // relative offset of local file header, since it begins where
-                                                         // the global header used to begin
-        global_header += fname;
-
-        // build footer
-        std::vector<char> footer;
-        footer += "PK";                                                            // first part of sig
-        footer += (uint16_t)0x0605;                                                // second part of sig
-        footer += (uint16_t)0;                                                     // number of this disk
-        footer += (uint16_t)0;                                                     // disk where footer starts
-        footer += (uint16_t)(nrecs + 1);                                           // number of records on this disk
-        footer += (uint16_t)(nrecs + 1);                                           // total number of records
-        footer += (uint32_t)global_header.size();                                  // nbytes of global headers
-        footer += (uint32_t)(global_header_offset + nbytes + local_header.size()); // offset of start of global
-                                                                                   // headers, since global header now
-                                                                                   // starts after newly written array
-        footer += (uint16_t)0;                                                     // zip file comment length
-
-        // write everything
-        fwrite(&local_header[0], sizeof(char), local_header.size(), fp);
-        if (compress) {
-            fwrite(compr_buf.data(), 1, compr_bytes_val, fp);
-        } else {
-            fwrite(&npy_header[0], sizeof(char), npy_header.size(), fp);
-            fwrite(data, sizeof(T), nels, fp);
-        }
-        fwrite(&global_header[0], sizeof(char), global_header.size(), fp);
-        fwrite(&footer[0], sizeof(char), footer.size(), fp);
-        fclose(fp);
-    };
+        npz_save(zipname, fname, static_cast<const void*>(data), shape, DType::of<T>(), mode, compress);
+    }
 
     template <typename T> void npy_save(std::string fname, const std::vector<T> data, std::string mode = "w") {
         Shape shape;
@@ -339,35 +662,392 @@ namespace cnpy {
         npz_save(zipname, fname, &data[0], shape, mode, compress);
     }
 
-    template <typename T> std::vector<char> create_npy_header(const Shape& shape) {
+    // Pack strings into a fixed-width buffer for npy_save/npz_save, setting dtype to match: 'S' copies the bytes,
+    // 'U' decodes UTF-8 into UCS-4. The width is that of the longest string, found in one pass over the lengths.
+    std::vector<char> pack_strings(const std::vector<std::string>& strings, char kind, DType& dtype);
+
+    // save strings as a 1-d 'S' (bytes) or 'U' (unicode, from UTF-8) array. npy_save in mode "a" pads to the width
+    // already in the file; longer strings than that throw
+    void npy_save(std::string fname, const std::vector<std::string>& strings, std::string mode = "w", char kind = 'S');
+    void npz_save(std::string zipname, std::string fname, const std::vector<std::string>& strings,
+                  std::string mode = "w", bool compress = false, char kind = 'S');
+
+    // A sparse matrix in the layout scipy.sparse.save_npz uses. "csr" and "csc" matrices use data, indices and
+    // indptr; "coo" matrices use data, row and col. Index arrays hold int32 or int64, whichever scipy picked.
+    struct SparseMatrix {
+        SparseMatrix() : rows(0), cols(0) {}
+
+        // matrices over caller-owned arrays, e.g. to pass to sparse_save. the arrays must outlive the matrix
+        template <typename T, typename I>
+        static SparseMatrix csr(size_t rows, size_t cols, const T* data, const I* indices, const I* indptr) {
+            return compressed("csr", rows, cols, rows, data, indices, indptr);
+        }
+
+        template <typename T, typename I>
+        static SparseMatrix csc(size_t rows, size_t cols, const T* data, const I* indices, const I* indptr) {
+            return compressed("csc", rows, cols, cols, data, indices, indptr);
+        }
+
+        template <typename T, typename I>
+        static SparseMatrix coo(size_t rows, size_t cols, size_t nnz, const T* data, const I* row, const I* col) {
+            SparseMatrix m("coo", rows, cols);
+            m.data = wrap(data, nnz, DType::of<T>());
+            m.row = wrap(row, nnz, DType::of<I>());
+            m.col = wrap(col, nnz, DType::of<I>());
+            return m;
+        }
+
+        size_t nnz() const { return data.num_vals; }
+
+        // element i of one of the index arrays, widened to int64
+        static int64_t index_at(const NpyArray& idx, size_t i) {
+            return idx.word_size == 8 ? idx.data<int64_t>()[i] : idx.data<int32_t>()[i];
+        }
+
+        std::string format;
+        size_t rows;
+        size_t cols;
+        NpyArray data;
+        NpyArray indices;
+        NpyArray indptr;
+        NpyArray row;
+        NpyArray col;
+
+      private:
+        SparseMatrix(const std::string& _format, size_t _rows, size_t _cols)
+            : format(_format), rows(_rows), cols(_cols) {}
+
+        static NpyArray wrap(const void* p, size_t n, const DType& dtype) {
+            NpyArray arr({n}, dtype.size, false, const_cast<void*>(p));
+            arr.dtype = dtype;
+            return arr;
+        }
+
+        template <typename T, typename I>
+        static SparseMatrix compressed(const char* format, size_t rows, size_t cols, size_t major, const T* data,
+                                       const I* indices, const I* indptr) {
+            SparseMatrix m(format, rows, cols);
+            size_t nnz = static_cast<size_t>(indptr[major]);
+            m.data = wrap(data, nnz, DType::of<T>());
+            m.indices = wrap(indices, nnz, DType::of<I>());
+            m.indptr = wrap(indptr, major + 1, DType::of<I>());
+            return m;
+        }
+    };
+
+    // load a matrix written by scipy.sparse.save_npz. with use_mmap, entries stored without compression
+    // (save_npz(..., compressed=False)) are memory-mapped rather than read, so large index arrays are not copied.
+    // throws if the entries are missing or inconsistent, or for formats other than csr, csc and coo
+    SparseMatrix sparse_load(std::string fname, bool use_mmap = false);
+
+    // save m as scipy.sparse.save_npz would, so that scipy.sparse.load_npz can read it back
+    void sparse_save(std::string fname, const SparseMatrix& m, bool compress = true);
+
+    // Asynchronous loads and saves, for keeping a deep queue of I/O going without a thread per file. Reads and writes
+    // from any number of calls are queued on an io_uring (or, where the kernel does not allow one, a small thread
+    // pool) and completed in batches. The callback forms are called on an internal thread with the result or with
+    // the exception the synchronous function would have thrown; callbacks must not throw or block for long. The
+    // data passed to a save must stay valid until the save completes.
+    typedef std::function<void(NpyArray arr, std::exception_ptr error)> LoadCallback;
+    typedef std::function<void(std::exception_ptr error)> SaveCallback;
+
+    void npy_load_async(std::string fname, LoadCallback callback);
+    void npz_load_async(std::string fname, std::string varname, LoadCallback callback);
+    void npy_save_async(std::string fname, const void* data, const Shape& shape, const DType& dtype,
+                        SaveCallback callback);
+    // each save rewrites the archive's directory, so saves to one archive run one at a time in the order they were
+    // made, on the thread pool
+    void npz_save_async(std::string zipname, std::string fname, const void* data, const Shape& shape,
+                        const DType& dtype, std::string mode, bool compress, SaveCallback callback);
+
+    std::future<NpyArray> npy_load_async(std::string fname);
+    std::future<NpyArray> npz_load_async(std::string fname, std::string varname);
+    std::future<void> npy_save_async(std::string fname, const void* data, const Shape& shape, const DType& dtype);
+    std::future<void> npz_save_async(std::string zipname, std::string fname, const void* data, const Shape& shape,
+                                     const DType& dtype, std::string mode = "w", bool compress = false);
+
+    template <typename T> std::future<void> npy_save_async(std::string fname, const T* data, const Shape& shape) {
+        return npy_save_async(fname, static_cast<const void*>(data), shape, DType::of<T>());
+    }
+
+    template <typename T>
+    std::future<void> npz_save_async(std::string zipname, std::string fname, const T* data, const Shape& shape,
+                                     std::string mode = "w", bool compress = false) {
+        return npz_save_async(zipname, fname, static_cast<const void*>(data), shape, DType::of<T>(), mode, compress);
+    }
+
+    // whether the asynchronous functions are using io_uring rather than the thread pool fallback
+    bool async_uses_io_uring();
+
+    // How npy_load_many spreads the files over threads. threads is the number of files loaded at once, counting the
+    // calling thread; 0 means one per hardware thread. use_mmap is passed on to npy_load; cache applies to loads that
+    // are not memory-mapped
+    struct LoadManyOptions {
+        unsigned threads;
+        bool use_mmap;
+        CachePolicy cache;
+        LoadManyOptions() : threads(0), use_mmap(false), cache(CachePolicy::Normal) {}
+    };
+
+    // the outcome of loading one file: the array, or what npy_load threw and its message
+    struct LoadResult {
+        NpyArray array;
+        std::exception_ptr error;
+        std::string message;
+        bool ok() const { return !error; }
+    };
+
+    // load many .npy files in parallel, returning one result per path in the same order. each thread starts on its
+    // own contiguous share of the paths and, when that runs out, steals half of what is left of the busiest share,
+    // so a few large files do not leave the other threads idle. a file that fails does not stop the others
+    std::vector<LoadResult> npy_load_many(const std::vector<std::string>& paths,
+                                          const LoadManyOptions& options = LoadManyOptions());
 
-        std::vector<char> dict;
-        dict += "{'descr': '";
-        dict += BigEndianTest();
-        dict += map_type(typeid(T));
-        dict += std::to_string(sizeof(T));
-        dict += "', 'fortran_order': False, 'shape': (";
-        dict += std::to_string(shape[0]);
-        for (size_t i = 1; i < shape.size(); i++) {
-            dict += ", ";
-            dict += std::to_string(shape[i]);
-        }
-        if (shape.size() == 1) dict += ",";
-        dict += "), }";
-        // pad with spaces so that preamble+dict is modulo 16 bytes. preamble is 10 bytes. dict needs to end with \n
-        int remainder = 16 - (10 + dict.size()) % 16;
-        dict.insert(dict.end(), remainder, ' ');
-        dict.back() = '\n';
-
-        std::vector<char> header;
-        header += (char)0x93; // magic number
-        header += "NUMPY";    // magic string
-        header += (char)0x01; // major version of numpy format
-        header += (char)0x00; // minor version of numpy format
-        header += (uint16_t)dict.size();
-        header.insert(header.end(), dict.begin(), dict.end());
-
-        return header;
+    // one array for npy_save_many: data in native order, as for npy_save(fname, data, shape, dtype)
+    struct SaveItem {
+        std::string fname;
+        const void* data;
+        Shape shape;
+        DType dtype;
+        SaveItem(const std::string& _fname, const void* _data, const Shape& _shape, const DType& _dtype)
+            : fname(_fname), data(_data), shape(_shape), dtype(_dtype) {}
+        template <typename T>
+        SaveItem(const std::string& _fname, const T* _data, const Shape& _shape)
+            : fname(_fname), data(_data), shape(_shape), dtype(DType::of<T>()) {}
+        size_t nbytes() const {
+            return std::accumulate(shape.begin(), shape.end(), dtype.size, std::multiplies<size_t>());
+        }
+    };
+
+    // when npy_save_many flushes the files to stable storage: never (the default, like npy_save), with an fdatasync
+    // of each file as it is written, or once after all of them are written (one syncfs per filesystem on Linux)
+    enum class SyncPolicy { None, EachFile, AtEnd };
+
+    // threads is the number of files written at once, counting the calling thread; 0 means one per hardware thread.
+    // save applies to every file, so by default each one is preallocated with fallocate.
+    //
+    // save.fsync and sync overlap; save.fsync wins. when it is set, each file is synced as it is published and sync
+    // adds nothing. when it is None, sync decides, and EachFile is the same as save.fsync = FsyncPolicy::Data. no
+    // file is ever synced twice
+    struct SaveManyOptions {
+        unsigned threads;
+        SaveOptions save;
+        SyncPolicy sync;
+        SaveManyOptions() : threads(0), sync(SyncPolicy::None) {}
+    };
+
+    // what npy_save_many wrote, including the time spent syncing
+    struct SaveManyStats {
+        size_t files;
+        size_t bytes; // array data, not counting headers
+        double seconds;
+        SaveManyStats() : files(0), bytes(0), seconds(0) {}
+        double bytes_per_second() const { return seconds > 0 ? bytes / seconds : 0; }
+    };
+
+    // write each item to its own new .npy file, several at a time, largest first. every item is attempted; if any
+    // fail, the error of the first failed item (in the order given) is thrown once the rest are done
+    SaveManyStats npy_save_many(const std::vector<SaveItem>& items,
+                                const SaveManyOptions& options = SaveManyOptions());
+
+    // write a new .npz holding every item (item.fname is the entry name, without .npy) in one go, several entries
+    // at a time. each entry is given a fixed offset up front, so stored entries are written in parallel straight to
+    // their place; compressed entries are deflated in parallel into memory and then written out the same way. the
+    // central directory is written once at the end. options.save.direct is ignored, as entries are not block
+    // aligned. there is only one file, so the sync policies EachFile and AtEnd both sync it once it is complete, as
+    // save.fsync = FsyncPolicy::Data would (a save.fsync that is set wins, as for npy_save_many)
+    SaveManyStats npz_save_many(std::string zipname, const std::vector<SaveItem>& items, bool compress = false,
+                                const SaveManyOptions& options = SaveManyOptions());
+
+    // Serialize to memory instead of a file, e.g. to send arrays over the network. data is in native order and the
+    // image is laid out in dtype's byte order, as for npy_save.
+    //
+    // npy_save_buffer and npz_save_buffer return the whole file image in a buffer reserved to its exact size up
+    // front. npy_save_sink and npz_save_sink hand the image to sink front to back in pieces, without building it;
+    // pieces are only valid during the call. npy_save_segments and npz_save_segments produce it as scatter output
+    // for writev or sendmsg: headers and anything transformed (byte-swapped or deflated) replace the contents of
+    // storage, while native-order stored data is referenced where it is, so the array itself is never copied. the
+    // segments are valid while storage and the arrays are, and storage must not be modified meanwhile
+    typedef std::function<void(const void* data, size_t size)> ByteSink;
+
+    std::vector<char> npy_save_buffer(const void* data, const Shape& shape, const DType& dtype);
+    void npy_save_sink(const ByteSink& sink, const void* data, const Shape& shape, const DType& dtype);
+    std::vector<Segment> npy_save_segments(const void* data, const Shape& shape, const DType& dtype,
+                                           std::vector<char>& storage);
+
+    // as npz_save_many would write the items to an .npz
+    std::vector<char> npz_save_buffer(const std::vector<SaveItem>& items, bool compress = false);
+    void npz_save_sink(const ByteSink& sink, const std::vector<SaveItem>& items, bool compress = false);
+    std::vector<Segment> npz_save_segments(const std::vector<SaveItem>& items, std::vector<char>& storage,
+                                           bool compress = false);
+
+    // random-access storage to load from. read_at must be thread-safe; data() is non-null if the bytes are in memory
+    class Source {
+      public:
+        virtual ~Source() {}
+        virtual size_t size() const = 0;
+        // read exactly n bytes at offset into dst, or throw
+        virtual void read_at(void* dst, size_t n, size_t offset) const = 0;
+        virtual const void* data() const { return nullptr; }
+    };
+
+    // storage to save to. write_at writes exactly n bytes at offset, or throws
+    class Target {
+      public:
+        virtual ~Target() {}
+        virtual void write_at(const void* src, size_t n, size_t offset) = 0;
+    };
+
+    // a file opened by path, read with pread, or mapped into memory with use_mmap
+    class FileSource : public Source {
+      public:
+        explicit FileSource(const std::string& fname, bool use_mmap = false);
+        ~FileSource();
+        size_t size() const { return size_; }
+        void read_at(void* dst, size_t n, size_t offset) const;
+        const void* data() const { return map_; }
+
+        FileSource(const FileSource&) = delete;
+        FileSource& operator=(const FileSource&) = delete;
+
+      private:
+        int fd_;
+        size_t size_;
+        void* map_;
+    };
+
+    // an open file descriptor, read with pread. the fd is borrowed and must stay open while the source is used
+    class FdSource : public Source {
+      public:
+        explicit FdSource(int fd);
+        size_t size() const { return size_; }
+        void read_at(void* dst, size_t n, size_t offset) const;
+
+      private:
+        int fd_;
+        size_t size_;
+    };
+
+    // bytes already in memory, kept alive by owner if one is given (as for npy_load_buffer)
+    class MemorySource : public Source {
+      public:
+        MemorySource(const void* data, size_t size, std::shared_ptr<const void> owner = nullptr)
+            : data_(static_cast<const char*>(data)), size_(size), owner_(owner) {}
+        size_t size() const { return size_; }
+        void read_at(void* dst, size_t n, size_t offset) const;
+        const void* data() const { return data_; }
+
+      private:
+        const char* data_;
+        size_t size_;
+        std::shared_ptr<const void> owner_;
+    };
+
+    // a new file (replacing any old one), written with pwrite
+    class FileTarget : public Target {
+      public:
+        explicit FileTarget(const std::string& fname);
+        ~FileTarget();
+        void write_at(const void* src, size_t n, size_t offset);
+
+        FileTarget(const FileTarget&) = delete;
+        FileTarget& operator=(const FileTarget&) = delete;
+
+      private:
+        int fd_;
+    };
+
+    // an open file descriptor, written with pwrite. the fd is borrowed
+    class FdTarget : public Target {
+      public:
+        explicit FdTarget(int fd) : fd_(fd) {}
+        void write_at(const void* src, size_t n, size_t offset);
+
+      private:
+        int fd_;
+    };
+
+    // a growable buffer, zero-filled where nothing has been written
+    class MemoryTarget : public Target {
+      public:
+        void write_at(const void* src, size_t n, size_t offset);
+        std::vector<char> buffer;
+    };
+
+    // load from a source. npz entries are loaded by up to threads threads at once (0 means one per hardware
+    // thread), each with its own ranged reads
+    NpyArray npy_load(std::shared_ptr<const Source> source);
+    npz_t npz_load(std::shared_ptr<const Source> source, unsigned threads = 1);
+    NpyArray npz_load(std::shared_ptr<const Source> source, std::string varname);
+
+    // save to a target, writing the same bytes as npy_save and npz_save_many front to back
+    void npy_save(Target& target, const void* data, const Shape& shape, const DType& dtype);
+    void npz_save(Target& target, const std::vector<SaveItem>& items, bool compress = false);
+
+    // Writes checkpoints in the background so that computation can carry on while they go to disk.
+    //
+    //   CheckpointWriter writer;                       // two staging buffers: double buffering
+    //   for (int step = 0;; ++step) {
+    //       simulate(state);
+    //       writer.save("ckpt_" + std::to_string(step) + ".npz", {SaveItem("u", u.data(), {nx, ny}), ...});
+    //   }
+    //   writer.wait();                                 // everything is on disk; rethrows a failed write
+    //
+    // save copies the arrays into a free staging buffer, blocking while every buffer is still waiting to be written
+    class CheckpointWriter {
+      public:
+        explicit CheckpointWriter(size_t buffers = 2, bool compress = false,
+                                  const SaveManyOptions& options = SaveManyOptions());
+        // waits for the queued checkpoints; errors are dropped, so call wait() first to see them
+        ~CheckpointWriter();
+
+        void save(const std::string& zipname, const std::vector<SaveItem>& items);
+        void wait();
+
+        CheckpointWriter(const CheckpointWriter&) = delete;
+        CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+      private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    // what an ArrayCache has done since it was created
+    struct ArrayCacheStats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t entries; // arrays held now
+        size_t bytes;   // and their total size
+        ArrayCacheStats() : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+    };
+
+    // LRU cache of decoded arrays keyed by file identity and entry name, holding at most budget bytes. returned arrays
+    // share data with the cache and must not be modified. thread-safe; shared() is a process-wide 1 GiB cache
+    class ArrayCache {
+      public:
+        explicit ArrayCache(size_t budget);
+        ~ArrayCache();
+
+        static ArrayCache& shared();
+
+        NpyArray npy_load(const std::string& fname);
+        NpyArray npz_load(const std::string& fname, const std::string& varname);
+
+        void set_budget(size_t budget);
+        void clear();
+        ArrayCacheStats stats() const;
+
+        ArrayCache(const ArrayCache&) = delete;
+        ArrayCache& operator=(const ArrayCache&) = delete;
+
+      private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    template <typename T> std::vector<char> create_npy_header(const Shape& shape) {
+        return create_npy_header(shape, DType::of<T>());
     }
 
 } // namespace cnpy
@@ -0,0 +1,441 @@
+// Copyright (C) 2011  Carl Rogers
+// Released under MIT License
+// license available in LICENSE file, or at
+// http://www.opensource.org/licenses/mit-license.php
+
+#include "npy_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define CNPY_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace {
+    using cnpy::io::Completion;
+
+    // one read or write, possibly split over several submissions by short transfers
+    struct Op {
+        int fd;
+        bool is_write;
+        std::vector<struct iovec> iov;
+        size_t first;  // the first piece not yet fully transferred
+        size_t offset; // file offset of the next byte
+        size_t total;  // bytes transferred so far
+        Completion done;
+    };
+
+    // account for n more bytes of op transferred, returning true once every piece is done
+    bool advance(Op& op, size_t n) {
+        op.total += n;
+        op.offset += n;
+        while (op.first < op.iov.size() && n >= op.iov[op.first].iov_len) n -= op.iov[op.first++].iov_len;
+        if (op.first < op.iov.size()) {
+            op.iov[op.first].iov_base = static_cast<char*>(op.iov[op.first].iov_base) + n;
+            op.iov[op.first].iov_len -= n;
+        }
+        return op.first == op.iov.size();
+    }
+
+    int pieces(const Op& op) { return static_cast<int>(std::min<size_t>(op.iov.size() - op.first, IOV_MAX)); }
+
+    // carry out op with blocking calls, returning what its completion gets
+    ssize_t run_blocking(Op& op) {
+        while (op.first < op.iov.size()) {
+            ssize_t n = op.is_write ? ::pwritev(op.fd, &op.iov[op.first], pieces(op), op.offset)
+                                    : ::preadv(op.fd, &op.iov[op.first], pieces(op), op.offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return -errno;
+            if (n == 0) return op.is_write ? -EIO : static_cast<ssize_t>(op.total);
+            advance(op, n);
+        }
+        return static_cast<ssize_t>(op.total);
+    }
+
+    class Pool {
+      public:
+        Pool() : stop_(false) {
+            unsigned n = std::min(8u, std::max(2u, std::thread::hardware_concurrency()));
+            for (unsigned i = 0; i < n; ++i) threads_.push_back(std::thread(&Pool::work, this));
+        }
+
+        // finishes the queued tasks first
+        ~Pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            for (std::thread& t : threads_) t.join();
+        }
+
+        void run(std::function<void()> f) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tasks_.push_back(std::move(f));
+            }
+            cv_.notify_one();
+        }
+
+      private:
+        void work() {
+            while (true) {
+                std::function<void()> f;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                    if (tasks_.empty()) return;
+                    f = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                f();
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<std::function<void()>> tasks_;
+        std::vector<std::thread> threads_;
+        bool stop_;
+    };
+
+    // hand a finished op to its completion on the pool
+    void finish(Pool& pool, Op* op, ssize_t res) {
+        pool.run([op, res] {
+            Completion done = std::move(op->done);
+            delete op;
+            done(res);
+        });
+    }
+
+#ifdef CNPY_HAVE_IO_URING
+    // An io_uring driven by one thread. Other threads queue ops and poke an eventfd; the ring thread keeps a read of
+    // that eventfd in flight so that it wakes for new work as well as for completions, moves queued ops into free
+    // submission slots, and submits and waits in a single io_uring_enter per round. If io_uring_enter fails for good,
+    // every op queued or in flight gets the error and the ring refuses further ops, which then go to the pool.
+    class Ring {
+      public:
+        // nullptr if the kernel (or a seccomp filter) does not allow io_uring
+        static Ring* create(Pool& pool) {
+            struct io_uring_params p;
+            memset(&p, 0, sizeof(p));
+            int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+            if (fd < 0) return nullptr;
+            Ring* ring = new Ring(pool, fd);
+            if (!ring->map(p)) {
+                delete ring;
+                return nullptr;
+            }
+            ring->thread_ = std::thread(&Ring::loop, ring);
+            return ring;
+        }
+
+        ~Ring() {
+            if (thread_.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stop_ = true;
+                }
+                wake();
+                thread_.join();
+            }
+            if (sqes_) munmap(sqes_, sqes_size_);
+            if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+            if (sq_ptr_) munmap(sq_ptr_, sq_size_);
+            if (event_fd_ >= 0) ::close(event_fd_);
+            ::close(ring_fd_);
+        }
+
+        // false once the ring has failed, leaving op to the caller
+        bool submit(Op* op) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (failed_) return false;
+                queue_.push_back(op);
+            }
+            wake();
+            return true;
+        }
+
+        bool failed() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return failed_;
+        }
+
+      private:
+        static const unsigned entries = 256;
+        static const uint64_t wake_tag = 0; // user_data of the eventfd read; ops use their address
+
+        Ring(Pool& pool, int fd)
+            : pool_(pool), ring_fd_(fd), event_fd_(-1), sq_ptr_(nullptr), cq_ptr_(nullptr), sqes_(nullptr),
+              sq_size_(0), cq_size_(0), sqes_size_(0), stop_(false), failed_(false), wake_armed_(false),
+              event_value_(0) {}
+
+        bool map(const struct io_uring_params& p) {
+            event_fd_ = eventfd(0, EFD_CLOEXEC);
+            if (event_fd_ < 0) return false;
+            sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+            bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+            if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+            sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                           IORING_OFF_SQ_RING);
+            if (sq_ptr_ == MAP_FAILED) {
+                sq_ptr_ = nullptr;
+                return false;
+            }
+            cq_ptr_ = single ? sq_ptr_
+                             : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                    IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED) {
+                cq_ptr_ = nullptr;
+                return false;
+            }
+            sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+            void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                              IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) return false;
+            sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+            char* sq = static_cast<char*>(sq_ptr_);
+            sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+            sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+            sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+            sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+            sq_entries_ = p.sq_entries;
+            char* cq = static_cast<char*>(cq_ptr_);
+            cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+            cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+            cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+            return true;
+        }
+
+        void wake() {
+            uint64_t one = 1;
+            while (::write(event_fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+            }
+        }
+
+        // fill the next submission slot; the caller has checked that there is one
+        void prep(uint8_t opcode, int fd, const struct iovec* iov, unsigned n, size_t offset, uint64_t user_data) {
+            unsigned tail = *sq_tail_;
+            unsigned index = tail & sq_mask_;
+            struct io_uring_sqe* sqe = &sqes_[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = opcode;
+            sqe->fd = fd;
+            sqe->off = offset;
+            sqe->addr = reinterpret_cast<uint64_t>(iov);
+            sqe->len = n;
+            sqe->user_data = user_data;
+            sq_array_[index] = index;
+            __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        }
+
+        void arm_wake() {
+            wake_armed_ = true;
+            event_iov_.iov_base = &event_value_;
+            event_iov_.iov_len = sizeof(event_value_);
+            prep(IORING_OP_READV, event_fd_, &event_iov_, 1, 0, wake_tag);
+        }
+
+        void loop() {
+            std::deque<Op*> ready; // ops waiting for a submission slot, including resubmitted short transfers
+            arm_wake();
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    ready.insert(ready.end(), queue_.begin(), queue_.end());
+                    queue_.clear();
+                    // the kernel writes into event_value_ when the eventfd read completes, so that has to happen
+                    // before the ring goes away
+                    if (stop_ && ready.empty() && in_flight_.empty() && !wake_armed_) return;
+                }
+                // one slot always stays free for re-arming the eventfd read
+                while (!ready.empty() && in_flight_.size() + 1 < sq_entries_) {
+                    Op* op = ready.front();
+                    ready.pop_front();
+                    prep(op->is_write ? IORING_OP_WRITEV : IORING_OP_READV, op->fd, &op->iov[op->first],
+                         pieces(*op), op->offset, reinterpret_cast<uint64_t>(op));
+                    in_flight_.insert(op);
+                }
+
+                unsigned to_submit = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+                long res = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    fail(ready, -errno);
+                    return;
+                }
+                reap(ready);
+            }
+        }
+
+        // handle every completion that is there, putting ops with more to transfer back on ready
+        void reap(std::deque<Op*>& ready) {
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                if (cqe.user_data == wake_tag) {
+                    wake_armed_ = false;
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!stop_ && !failed_) arm_wake();
+                    continue;
+                }
+                Op* op = reinterpret_cast<Op*>(cqe.user_data);
+                in_flight_.erase(op);
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    ready.push_front(op);
+                } else if (cqe.res < 0) {
+                    finish(pool_, op, cqe.res);
+                } else if (cqe.res == 0) {
+                    finish(pool_, op, op->is_write ? -EIO : static_cast<ssize_t>(op->total));
+                } else if (advance(*op, cqe.res)) {
+                    finish(pool_, op, static_cast<ssize_t>(op->total));
+                } else {
+                    ready.push_front(op);
+                }
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        }
+
+        // io_uring_enter failed with err: stop taking ops, then complete those that already finished with their
+        // results and every other queued or in-flight op with err. the ring thread exits afterwards
+        void fail(std::deque<Op*>& ready, int err) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+                ready.insert(ready.end(), queue_.begin(), queue_.end());
+                queue_.clear();
+            }
+            reap(ready);
+            for (Op* op : ready) finish(pool_, op, err);
+            ready.clear();
+            for (Op* op : in_flight_) finish(pool_, op, err);
+            in_flight_.clear();
+        }
+
+        Pool& pool_;
+        int ring_fd_;
+        int event_fd_;
+        void* sq_ptr_;
+        void* cq_ptr_;
+        struct io_uring_sqe* sqes_;
+        size_t sq_size_;
+        size_t cq_size_;
+        size_t sqes_size_;
+        unsigned* sq_head_;
+        unsigned* sq_tail_;
+        unsigned sq_mask_;
+        unsigned* sq_array_;
+        unsigned sq_entries_;
+        unsigned* cq_head_;
+        unsigned* cq_tail_;
+        unsigned cq_mask_;
+        struct io_uring_cqe* cqes_;
+
+        std::thread thread_;
+        mutable std::mutex mutex_;
+        std::deque<Op*> queue_;
+        bool stop_;
+        bool failed_;             // io_uring_enter failed and the ring thread has given up
+        std::set<Op*> in_flight_; // ops submitted and not completed, not counting the eventfd read
+        bool wake_armed_;         // whether the eventfd read is in flight
+        uint64_t event_value_;
+        struct iovec event_iov_;
+    };
+#else
+    class Ring {
+      public:
+        static Ring* create(Pool&) { return nullptr; }
+        bool submit(Op*) { return false; }
+        bool failed() const { return true; }
+    };
+#endif
+} // namespace
+
+struct cnpy::io::Engine::Impl {
+    Pool pool;
+    Ring* ring;
+};
+
+cnpy::io::Engine::Engine() : impl_(new Impl) {
+    impl_->ring = getenv("CNPY_NO_IO_URING") ? nullptr : Ring::create(impl_->pool);
+}
+
+cnpy::io::Engine::~Engine() {
+    // the ring hands its last completions to the pool, which runs everything queued before its threads exit
+    delete impl_->ring;
+}
+
+cnpy::io::Engine& cnpy::io::Engine::instance() {
+    // never destroyed: completions can still be running on the pool while static destructors run at exit
+    static Engine* engine = new Engine;
+    return *engine;
+}
+
+bool cnpy::io::Engine::uses_io_uring() const { return impl_->ring != nullptr && !impl_->ring->failed(); }
+
+void cnpy::io::Engine::run(std::function<void()> f) { impl_->pool.run(std::move(f)); }
+
+namespace {
+    void submit(Pool& pool, Ring* ring, Op* op) {
+        if (op->iov.empty()) {
+            finish(pool, op, 0);
+            return;
+        }
+        // a ring that has failed hands the op back, to be run on the pool like without io_uring
+        if (ring && ring->submit(op)) return;
+        pool.run([op] {
+            ssize_t res = run_blocking(*op);
+            Completion done = std::move(op->done);
+            delete op;
+            done(res);
+        });
+    }
+} // namespace
+
+void cnpy::io::Engine::read(int fd, void* buf, size_t nbytes, size_t offset, Completion done) {
+    Op* op = new Op();
+    op->fd = fd;
+    op->is_write = false;
+    if (nbytes > 0) {
+        struct iovec iov = {buf, nbytes};
+        op->iov.push_back(iov);
+    }
+    op->first = 0;
+    op->offset = offset;
+    op->total = 0;
+    op->done = std::move(done);
+    submit(impl_->pool, impl_->ring, op);
+}
+
+void cnpy::io::Engine::write(int fd, std::vector<struct iovec> iov, size_t offset, Completion done) {
+    Op* op = new Op();
+    op->fd = fd;
+    op->is_write = true;
+    for (const struct iovec& piece : iov)
+        if (piece.iov_len > 0) op->iov.push_back(piece);
+    op->first = 0;
+    op->offset = offset;
+    op->total = 0;
+    op->done = std::move(done);
+    submit(impl_->pool, impl_->ring, op);
+}
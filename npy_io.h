@@ -0,0 +1,60 @@
+// Copyright (C) 2011  Carl Rogers
+// Released under MIT License
+// license available in LICENSE file, or at
+// http://www.opensource.org/licenses/mit-license.php
+
+// Internal asynchronous I/O engine used by the *_async functions in cnpy.cpp. Not installed.
+
+#ifndef LIBCNPY_IO_H_
+#define LIBCNPY_IO_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace cnpy {
+    namespace io {
+
+        // called with the number of bytes transferred, or -errno
+        typedef std::function<void(ssize_t)> Completion;
+
+        // Process-wide engine that keeps many reads and writes in flight at once. On Linux it drives an io_uring
+        // (set up with raw syscalls, so liburing is not needed) from one thread that submits queued requests and
+        // reaps completions in batches. Where io_uring is unavailable (older kernels, seccomp filters) or the
+        // CNPY_NO_IO_URING environment variable is set, the same requests run as blocking pread/pwritev calls on a
+        // thread pool. Completions run on the pool, never on the submitting thread, and may submit more requests.
+        // The engine is created on first use and never destroyed, so requests still in flight at exit are dropped.
+        class Engine {
+          public:
+            static Engine& instance();
+
+            // read nbytes at offset of fd into buf. short reads are continued until nbytes have been read or the
+            // file ends, so done gets fewer than nbytes only at end of file
+            void read(int fd, void* buf, size_t nbytes, size_t offset, Completion done);
+
+            // write the pieces in iov at offset of fd, continuing short writes
+            void write(int fd, std::vector<struct iovec> iov, size_t offset, Completion done);
+
+            // run f on the thread pool, for work that computes or blocks
+            void run(std::function<void()> f);
+
+            bool uses_io_uring() const;
+
+            Engine(const Engine&) = delete;
+            Engine& operator=(const Engine&) = delete;
+
+          private:
+            Engine();
+            ~Engine();
+
+            struct Impl;
+            std::unique_ptr<Impl> impl_;
+        };
+
+    } // namespace io
+} // namespace cnpy
+
+#endif
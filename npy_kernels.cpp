@@ -0,0 +1,667 @@
+// Copyright (C) 2011  Carl Rogers
+// Released under MIT License
+// license available in LICENSE file, or at
+// http://www.opensource.org/licenses/mit-license.php
+
+#include "npy_kernels.h"
+#include "npy_io.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// x86 extensions beyond the compile target are used through target attributes, picked at run time
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CNPY_KERNELS_DISPATCH
+#include <immintrin.h>
+#include <tmmintrin.h>
+#endif
+
+namespace {
+
+#if defined(CNPY_KERNELS_DISPATCH)
+    // what this CPU supports, checked once. CNPY_NO_SIMD turns everything off, so the portable code can be tested
+    struct CpuFeatures {
+        bool ssse3;
+        bool f16c; // with the AVX state the conversions use
+        bool avx2;
+    };
+
+    const CpuFeatures& cpu() {
+        static const CpuFeatures features = []() -> CpuFeatures {
+            CpuFeatures f = {false, false, false};
+            if (getenv("CNPY_NO_SIMD")) return f;
+            __builtin_cpu_init();
+            f.ssse3 = __builtin_cpu_supports("ssse3");
+            f.f16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+            f.avx2 = __builtin_cpu_supports("avx2");
+            return f;
+        }();
+        return features;
+    }
+#endif
+
+    // edge of the square tiles the transpose works on; a 64x64 tile of 8-byte words is 32K
+    const size_t kTile = 64;
+
+    struct Word16 {
+        uint64_t lo, hi;
+    };
+
+    // dst[j * dst_ld + i] = src[i * src_ld + j] for a rows x cols tile
+    template <typename W>
+    void transpose_tile(const W* src, size_t src_ld, W* dst, size_t dst_ld, size_t rows, size_t cols) {
+        for (size_t i = 0; i < rows; ++i)
+            for (size_t j = 0; j < cols; ++j) dst[j * dst_ld + i] = src[i * src_ld + j];
+    }
+
+#if defined(__SSE2__)
+    // 4x4 register transposes, scalar code for the ragged edges
+    template <>
+    void transpose_tile<uint32_t>(const uint32_t* src, size_t src_ld, uint32_t* dst, size_t dst_ld, size_t rows,
+                                  size_t cols) {
+        size_t i = 0;
+        for (; i + 4 <= rows; i += 4) {
+            size_t j = 0;
+            for (; j + 4 <= cols; j += 4) {
+                __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 0) * src_ld + j));
+                __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 1) * src_ld + j));
+                __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 2) * src_ld + j));
+                __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 3) * src_ld + j));
+                __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+                __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+                __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+                __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (j + 0) * dst_ld + i), _mm_unpacklo_epi64(t0, t1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (j + 1) * dst_ld + i), _mm_unpackhi_epi64(t0, t1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (j + 2) * dst_ld + i), _mm_unpacklo_epi64(t2, t3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (j + 3) * dst_ld + i), _mm_unpackhi_epi64(t2, t3));
+            }
+            for (; j < cols; ++j)
+                for (size_t k = 0; k < 4; ++k) dst[j * dst_ld + i + k] = src[(i + k) * src_ld + j];
+        }
+        for (; i < rows; ++i)
+            for (size_t j = 0; j < cols; ++j) dst[j * dst_ld + i] = src[i * src_ld + j];
+    }
+
+    // 2x2 register transposes
+    template <>
+    void transpose_tile<uint64_t>(const uint64_t* src, size_t src_ld, uint64_t* dst, size_t dst_ld, size_t rows,
+                                  size_t cols) {
+        size_t i = 0;
+        for (; i + 2 <= rows; i += 2) {
+            size_t j = 0;
+            for (; j + 2 <= cols; j += 2) {
+                __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * src_ld + j));
+                __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 1) * src_ld + j));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + j * dst_ld + i), _mm_unpacklo_epi64(r0, r1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (j + 1) * dst_ld + i), _mm_unpackhi_epi64(r0, r1));
+            }
+            for (; j < cols; ++j) {
+                dst[j * dst_ld + i] = src[i * src_ld + j];
+                dst[j * dst_ld + i + 1] = src[(i + 1) * src_ld + j];
+            }
+        }
+        for (; i < rows; ++i)
+            for (size_t j = 0; j < cols; ++j) dst[j * dst_ld + i] = src[i * src_ld + j];
+    }
+#endif
+
+    void transpose_tile_bytes(const char* src, size_t src_ld, char* dst, size_t dst_ld, size_t rows, size_t cols,
+                              size_t word_size) {
+        for (size_t i = 0; i < rows; ++i)
+            for (size_t j = 0; j < cols; ++j)
+                memcpy(dst + (j * dst_ld + i) * word_size, src + (i * src_ld + j) * word_size, word_size);
+    }
+
+    template <typename W>
+    void transpose_tile_as(const char* src, size_t src_ld, char* dst, size_t dst_ld, size_t rows, size_t cols) {
+        transpose_tile(reinterpret_cast<const W*>(src), src_ld, reinterpret_cast<W*>(dst), dst_ld, rows, cols);
+    }
+
+    void transpose_tile_any(const char* src, size_t src_ld, char* dst, size_t dst_ld, size_t rows, size_t cols,
+                            size_t word_size) {
+        switch (word_size) {
+        case 1: transpose_tile_as<uint8_t>(src, src_ld, dst, dst_ld, rows, cols); break;
+        case 2: transpose_tile_as<uint16_t>(src, src_ld, dst, dst_ld, rows, cols); break;
+        case 4: transpose_tile_as<uint32_t>(src, src_ld, dst, dst_ld, rows, cols); break;
+        case 8: transpose_tile_as<uint64_t>(src, src_ld, dst, dst_ld, rows, cols); break;
+        case 16: transpose_tile_as<Word16>(src, src_ld, dst, dst_ld, rows, cols); break;
+        default: transpose_tile_bytes(src, src_ld, dst, dst_ld, rows, cols, word_size);
+        }
+    }
+
+    // --- dtype conversion ---
+
+    // element-wise cast, written so that the compiler can vectorize it
+    template <typename S, typename D> void convert_block(const S* src, D* dst, size_t n) {
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<D>(src[i]);
+    }
+
+#if defined(__SSE2__)
+    void convert_block(const double* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+            __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+            _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+        }
+        for (; i < n; ++i) dst[i] = static_cast<float>(src[i]);
+    }
+
+    void convert_block(const float* src, double* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128 v = _mm_loadu_ps(src + i);
+            _mm_storeu_pd(dst + i, _mm_cvtps_pd(v));
+            _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+        }
+        for (; i < n; ++i) dst[i] = src[i];
+    }
+
+    void convert_block(const int32_t* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+        for (; i < n; ++i) dst[i] = static_cast<float>(src[i]);
+    }
+
+    void convert_block(const int32_t* src, double* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_pd(dst + i, _mm_cvtepi32_pd(v));
+            _mm_storeu_pd(dst + i + 2, _mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v)));
+        }
+        for (; i < n; ++i) dst[i] = src[i];
+    }
+#endif
+
+    // whether every value of S is representable in D, so that no range check is needed
+    template <typename S, typename D> struct always_fits {
+        static const bool value =
+            std::is_same<D, bool>::value || std::is_floating_point<D>::value
+                ? (!std::is_floating_point<S>::value || sizeof(S) <= sizeof(D) || std::is_same<D, bool>::value)
+                : std::is_integral<S>::value &&
+                      (std::is_same<S, bool>::value ||
+                       (std::is_signed<S>::value == std::is_signed<D>::value && sizeof(S) <= sizeof(D)) ||
+                       (std::is_unsigned<S>::value && std::is_signed<D>::value && sizeof(S) < sizeof(D)));
+    };
+
+    // bool to integer: always fits (always_fits skips the check, but it is still instantiated)
+    template <typename S, typename D>
+    typename std::enable_if<std::is_same<S, bool>::value && std::is_integral<D>::value, bool>::type
+    in_range(const S*, size_t) {
+        return true;
+    }
+
+    // integer to integer
+    template <typename S, typename D>
+    typename std::enable_if<std::is_integral<S>::value && !std::is_same<S, bool>::value && std::is_integral<D>::value,
+                            bool>::type
+    in_range(const S* src, size_t n) {
+        // reduce to the extremes first; a branch-free loop the compiler can vectorize
+        S lo = src[0], hi = src[0];
+        for (size_t i = 1; i < n; ++i) {
+            lo = src[i] < lo ? src[i] : lo;
+            hi = src[i] > hi ? src[i] : hi;
+        }
+        if (std::is_signed<S>::value && lo < 0) {
+            if (std::is_unsigned<D>::value) return false;
+            if (static_cast<int64_t>(lo) < static_cast<int64_t>(std::numeric_limits<D>::min())) return false;
+        }
+        if (hi > 0 && static_cast<uint64_t>(hi) > static_cast<uint64_t>(std::numeric_limits<D>::max())) return false;
+        return true;
+    }
+
+    // floating point to integer: the truncated value must fit, NaN never does
+    template <typename S, typename D>
+    typename std::enable_if<std::is_floating_point<S>::value && std::is_integral<D>::value, bool>::type
+    in_range(const S* src, size_t n) {
+        const S upper = std::ldexp(S(1), std::numeric_limits<D>::digits);
+        const S lower = std::is_signed<D>::value ? -upper : S(-1);
+        const bool inclusive = std::is_signed<D>::value;
+        bool ok = true;
+        for (size_t i = 0; i < n; ++i) ok &= (inclusive ? src[i] >= lower : src[i] > lower) && src[i] < upper;
+        return ok;
+    }
+
+    // wider to narrower floating point: finite values must not overflow
+    template <typename S, typename D>
+    typename std::enable_if<std::is_floating_point<S>::value && std::is_floating_point<D>::value, bool>::type
+    in_range(const S* src, size_t n) {
+        const S limit = static_cast<S>(std::numeric_limits<D>::max());
+        const S inf = std::numeric_limits<S>::infinity();
+        bool ok = true;
+        for (size_t i = 0; i < n; ++i) {
+            S a = std::fabs(src[i]);
+            ok &= !(a > limit && a != inf);
+        }
+        return ok;
+    }
+
+    template <typename S, typename D>
+    typename std::enable_if<std::is_integral<S>::value && std::is_floating_point<D>::value, bool>::type
+    in_range(const S*, size_t) {
+        return true;
+    }
+
+    template <typename S, typename D> void convert_checked(const char* src, char* dst, size_t n) {
+        const S* s = reinterpret_cast<const S*>(src);
+        D* d = reinterpret_cast<D*>(dst);
+        if (n > 0 && !always_fits<S, D>::value && !in_range<S, D>(s, n))
+            throw std::range_error("convert: value out of range for the requested type");
+        convert_block(s, d, n);
+    }
+
+    // a bool source or destination never needs a range check
+    template <> void convert_checked<bool, bool>(const char* src, char* dst, size_t n) { memcpy(dst, src, n); }
+
+    template <typename D> void convert_to(const char* src, char kind, size_t size, char* dst, size_t n) {
+        switch (kind == 'f' ? 100 + size : kind == 'i' ? 200 + size : kind == 'u' ? 300 + size : 400 + size) {
+        case 104: return convert_checked<float, D>(src, dst, n);
+        case 108: return convert_checked<double, D>(src, dst, n);
+        case 201: return convert_checked<int8_t, D>(src, dst, n);
+        case 202: return convert_checked<int16_t, D>(src, dst, n);
+        case 204: return convert_checked<int32_t, D>(src, dst, n);
+        case 208: return convert_checked<int64_t, D>(src, dst, n);
+        case 301: return convert_checked<uint8_t, D>(src, dst, n);
+        case 302: return convert_checked<uint16_t, D>(src, dst, n);
+        case 304: return convert_checked<uint32_t, D>(src, dst, n);
+        case 308: return convert_checked<uint64_t, D>(src, dst, n);
+        case 401: return convert_checked<bool, D>(src, dst, n);
+        default: throw std::runtime_error("convert: unsupported source dtype");
+        }
+    }
+
+    // --- half precision and bfloat16 ---
+
+    inline uint32_t float_bits(float f) {
+        uint32_t x;
+        memcpy(&x, &f, 4);
+        return x;
+    }
+
+    inline float bits_float(uint32_t x) {
+        float f;
+        memcpy(&f, &x, 4);
+        return f;
+    }
+
+    float half_to_float_scalar(uint16_t h) {
+        uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+        uint32_t exp = (h >> 10) & 0x1f;
+        uint32_t mant = h & 0x3ff;
+        if (exp == 0x1f) return bits_float(sign | 0x7f800000 | (mant << 13)); // inf or NaN
+        if (exp != 0) return bits_float(sign | ((exp + 112) << 23) | (mant << 13));
+        if (mant == 0) return bits_float(sign);
+        // subnormal: normalize the mantissa
+        uint32_t e = 113;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            --e;
+        }
+        return bits_float(sign | (e << 23) | ((mant & 0x3ff) << 13));
+    }
+
+    uint16_t float_to_half_scalar(float f) {
+        uint32_t x = float_bits(f);
+        uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+        uint32_t a = x & 0x7fffffff;
+        if (a > 0x7f800000) return sign | 0x7e00 | ((a >> 13) & 0x3ff); // NaN, kept quiet
+        if (a >= 0x477ff000) return sign | 0x7c00;                      // rounds to 65520 or more: infinity
+        if (a >= 0x38800000) {
+            // normal: rebias the exponent, then round off the 13 low mantissa bits
+            uint32_t r = (a - 0x38000000) >> 13;
+            uint32_t rem = a & 0x1fff;
+            if (rem > 0x1000 || (rem == 0x1000 && (r & 1))) ++r;
+            return static_cast<uint16_t>(sign | r);
+        }
+        if (a <= 0x33000000) return sign; // 2^-25 or less rounds to zero
+        // subnormal: the result counts units of 2^-24
+        uint32_t e = a >> 23;
+        uint32_t m = (a & 0x7fffff) | 0x800000;
+        uint32_t shift = 126 - e;
+        uint32_t r = m >> shift;
+        uint32_t rem = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (r & 1))) ++r;
+        return static_cast<uint16_t>(sign | r);
+    }
+
+#if defined(CNPY_KERNELS_DISPATCH)
+    // eight values per instruction, rounding to nearest even like the scalar code. return the number converted
+    __attribute__((target("avx,f16c"))) size_t half_to_float_f16c(const uint16_t* src, float* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+        return i;
+    }
+
+    __attribute__((target("avx,f16c"))) size_t float_to_half_f16c(const float* src, uint16_t* dst, size_t n) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                             _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+        return i;
+    }
+#endif
+
+    // the smallest magnitude that rounds to infinity in half precision. below it, values up to half an ulp past the
+    // largest finite value (65504) round down to it, as in numpy's astype(float16)
+    const float kHalfOverflow = 65520.0f;
+
+    // convert through float32 a block at a time, for conversions to or from half precision
+    void convert_via_float(const char* src, char src_kind, size_t src_size, char* dst, char dst_kind, size_t dst_size,
+                           size_t n) {
+        const size_t block = 1024;
+        float buf[block];
+        for (size_t done = 0; done < n; done += block) {
+            size_t m = std::min(block, n - done);
+            const char* s = src + done * src_size;
+            char* d = dst + done * dst_size;
+            if (src_kind == 'f' && src_size == 2)
+                cnpy::kernels::half_to_float(reinterpret_cast<const uint16_t*>(s), buf, m);
+            else
+                cnpy::kernels::convert(s, src_kind, src_size, reinterpret_cast<char*>(buf), 'f', 4, m);
+            if (dst_kind == 'f' && dst_size == 2) {
+                bool ok = true;
+                for (size_t i = 0; i < m; ++i) {
+                    float a = std::fabs(buf[i]);
+                    ok &= !(a >= kHalfOverflow && a != std::numeric_limits<float>::infinity());
+                }
+                if (!ok) throw std::range_error("convert: value out of range for the requested type");
+                cnpy::kernels::float_to_half(buf, reinterpret_cast<uint16_t*>(d), m);
+            } else {
+                cnpy::kernels::convert(reinterpret_cast<const char*>(buf), 'f', 4, d, dst_kind, dst_size, m);
+            }
+        }
+    }
+
+    // --- byte swapping ---
+
+    inline uint16_t bswap(uint16_t v) { return static_cast<uint16_t>((v >> 8) | (v << 8)); }
+    inline uint32_t bswap(uint32_t v) { return __builtin_bswap32(v); }
+    inline uint64_t bswap(uint64_t v) { return __builtin_bswap64(v); }
+
+    template <typename W> void byteswap_scalar(char* data, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            W v;
+            memcpy(&v, data + i * sizeof(W), sizeof(W));
+            v = bswap(v);
+            memcpy(data + i * sizeof(W), &v, sizeof(W));
+        }
+    }
+
+#if defined(CNPY_KERNELS_DISPATCH)
+    // one pshufb reverses every W-byte word in a 16-byte register. returns the number of words swapped
+    template <typename W> __attribute__((target("ssse3"))) size_t byteswap_ssse3(char* data, size_t n) {
+        size_t i = 0;
+        char mask_bytes[16];
+        for (size_t b = 0; b < 16; ++b) {
+            size_t word = b - b % sizeof(W);
+            mask_bytes[b] = static_cast<char>(word + sizeof(W) - 1 - b % sizeof(W));
+        }
+        const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask_bytes));
+        const size_t per_vec = 16 / sizeof(W);
+        for (; i + 2 * per_vec <= n; i += 2 * per_vec) {
+            __m128i* p = reinterpret_cast<__m128i*>(data + i * sizeof(W));
+            __m128i a = _mm_loadu_si128(p);
+            __m128i b = _mm_loadu_si128(p + 1);
+            _mm_storeu_si128(p, _mm_shuffle_epi8(a, mask));
+            _mm_storeu_si128(p + 1, _mm_shuffle_epi8(b, mask));
+        }
+        return i;
+    }
+#endif
+
+    template <typename W> void byteswap_block(char* data, size_t n) {
+        size_t i = 0;
+#if defined(CNPY_KERNELS_DISPATCH)
+        if (cpu().ssse3) i = byteswap_ssse3<W>(data, n);
+#endif
+        byteswap_scalar<W>(data + i * sizeof(W), n - i);
+    }
+
+    // --- strided gather ---
+
+#if defined(CNPY_KERNELS_DISPATCH)
+    // vector gathers return the number of words they copied; there are none for 1 and 2 byte words
+    template <typename W> size_t gather_avx2(const char*, size_t, W*, size_t) { return 0; }
+
+    // eight 32-bit lanes per gather; indices are byte offsets, so the span of one batch must fit in an int
+    __attribute__((target("avx2"))) size_t gather_avx2(const char* src, size_t stride, uint32_t* dst, size_t n) {
+        if (stride * 8 > static_cast<size_t>(std::numeric_limits<int>::max())) return 0;
+        size_t i = 0;
+        int s = static_cast<int>(stride);
+        const __m256i offsets = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+        for (; i + 8 <= n; i += 8) {
+            __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src + i * stride), offsets, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+        }
+        return i;
+    }
+
+    __attribute__((target("avx2"))) size_t gather_avx2(const char* src, size_t stride, uint64_t* dst, size_t n) {
+        if (stride * 4 > static_cast<size_t>(std::numeric_limits<int>::max())) return 0;
+        size_t i = 0;
+        int s = static_cast<int>(stride);
+        const __m128i offsets = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+        for (; i + 4 <= n; i += 4) {
+            __m256i v = _mm256_i32gather_epi64(reinterpret_cast<const long long*>(src + i * stride), offsets, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+        }
+        return i;
+    }
+#endif
+
+    template <typename W> void gather_words(const char* src, size_t stride, W* dst, size_t n) {
+        size_t i = 0;
+#if defined(CNPY_KERNELS_DISPATCH)
+        if (cpu().avx2) i = gather_avx2(src, stride, dst, n);
+#endif
+        for (; i < n; ++i) memcpy(dst + i, src + i * stride, sizeof(W));
+    }
+
+} // namespace
+
+void cnpy::kernels::byteswap(char* data, size_t unit, size_t n) {
+    switch (unit) {
+    case 1: return;
+    case 2: return byteswap_block<uint16_t>(data, n);
+    case 4: return byteswap_block<uint32_t>(data, n);
+    case 8: return byteswap_block<uint64_t>(data, n);
+    default:
+        for (size_t i = 0; i < n; ++i) std::reverse(data + i * unit, data + (i + 1) * unit);
+    }
+}
+
+void cnpy::kernels::half_to_float(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(CNPY_KERNELS_DISPATCH)
+    if (cpu().f16c) i = half_to_float_f16c(src, dst, n);
+#endif
+    for (; i < n; ++i) dst[i] = half_to_float_scalar(src[i]);
+}
+
+void cnpy::kernels::float_to_half(const float* src, uint16_t* dst, size_t n) {
+    size_t i = 0;
+#if defined(CNPY_KERNELS_DISPATCH)
+    if (cpu().f16c) i = float_to_half_f16c(src, dst, n);
+#endif
+    for (; i < n; ++i) dst[i] = float_to_half_scalar(src[i]);
+}
+
+void cnpy::kernels::bfloat16_to_float(const uint16_t* src, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // interleaving zero words below each value shifts it into the top half of a 32-bit lane
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(zero, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(zero, v));
+    }
+#endif
+    for (; i < n; ++i) dst[i] = bits_float(static_cast<uint32_t>(src[i]) << 16);
+}
+
+void cnpy::kernels::float_to_bfloat16(const float* src, uint16_t* dst, size_t n) {
+    // integer only, so the compiler can vectorize it
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t x = float_bits(src[i]);
+        uint32_t rounded = (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+        uint32_t quiet_nan = (x >> 16) | 0x40;
+        dst[i] = static_cast<uint16_t>((x & 0x7fffffff) > 0x7f800000 ? quiet_nan : rounded);
+    }
+}
+
+void cnpy::kernels::gather(const char* src, size_t stride, size_t width, char* dst, size_t n) {
+    switch (width) {
+    case 1: return gather_words(src, stride, reinterpret_cast<uint8_t*>(dst), n);
+    case 2: return gather_words(src, stride, reinterpret_cast<uint16_t*>(dst), n);
+    case 4: return gather_words(src, stride, reinterpret_cast<uint32_t*>(dst), n);
+    case 8: return gather_words(src, stride, reinterpret_cast<uint64_t*>(dst), n);
+    default:
+        for (size_t i = 0; i < n; ++i) memcpy(dst + i * width, src + i * stride, width);
+    }
+}
+
+bool cnpy::kernels::can_convert(char kind, size_t size) {
+    switch (kind) {
+    case 'f': return size == 2 || size == 4 || size == 8;
+    case 'i':
+    case 'u': return size == 1 || size == 2 || size == 4 || size == 8;
+    case 'b': return size == 1;
+    default: return false;
+    }
+}
+
+void cnpy::kernels::convert(const char* src, char src_kind, size_t src_size, char* dst, char dst_kind,
+                            size_t dst_size, size_t n) {
+    if (src_kind == dst_kind && src_size == dst_size) {
+        memcpy(dst, src, n * src_size);
+        return;
+    }
+    if (!can_convert(src_kind, src_size)) throw std::runtime_error("convert: unsupported source dtype");
+    if ((src_kind == 'f' && src_size == 2) || (dst_kind == 'f' && dst_size == 2)) {
+        if (!can_convert(dst_kind, dst_size)) throw std::runtime_error("convert: unsupported destination dtype");
+        if (src_kind == 'f' && src_size == 2 && dst_kind == 'f' && dst_size == 4)
+            return half_to_float(reinterpret_cast<const uint16_t*>(src), reinterpret_cast<float*>(dst), n);
+        return convert_via_float(src, src_kind, src_size, dst, dst_kind, dst_size, n);
+    }
+    switch (dst_kind == 'f' ? 100 + dst_size : dst_kind == 'i' ? 200 + dst_size : dst_kind == 'u' ? 300 + dst_size
+                                                                                                 : 400 + dst_size) {
+    case 104: return convert_to<float>(src, src_kind, src_size, dst, n);
+    case 108: return convert_to<double>(src, src_kind, src_size, dst, n);
+    case 201: return convert_to<int8_t>(src, src_kind, src_size, dst, n);
+    case 202: return convert_to<int16_t>(src, src_kind, src_size, dst, n);
+    case 204: return convert_to<int32_t>(src, src_kind, src_size, dst, n);
+    case 208: return convert_to<int64_t>(src, src_kind, src_size, dst, n);
+    case 301: return convert_to<uint8_t>(src, src_kind, src_size, dst, n);
+    case 302: return convert_to<uint16_t>(src, src_kind, src_size, dst, n);
+    case 304: return convert_to<uint32_t>(src, src_kind, src_size, dst, n);
+    case 308: return convert_to<uint64_t>(src, src_kind, src_size, dst, n);
+    case 401: return convert_to<bool>(src, src_kind, src_size, dst, n);
+    default: throw std::runtime_error("convert: unsupported destination dtype");
+    }
+}
+
+void cnpy::kernels::reverse_axes(const char* src, char* dst, const std::vector<size_t>& shape, size_t row_begin,
+                                 size_t row_end, size_t word_size, unsigned threads) {
+    size_t ndims = shape.size();
+    size_t nrows = row_end - row_begin;
+    if (nrows == 0) return;
+    if (ndims < 2) {
+        memcpy(dst + row_begin * word_size, src, nrows * word_size);
+        return;
+    }
+
+    // element strides of the source (C order of shape) and destination (C order of the reversed shape)
+    std::vector<size_t> sstride(ndims), dstride(ndims);
+    sstride[ndims - 1] = 1;
+    for (size_t k = ndims - 1; k > 0; --k) sstride[k - 1] = sstride[k] * shape[k];
+    dstride[0] = 1;
+    for (size_t k = 1; k < ndims; ++k) dstride[k] = dstride[k - 1] * shape[k - 1];
+
+    // each middle index selects a 2-d plane spanned by the first and last axes; transpose it tile by tile
+    size_t cols = shape[ndims - 1];
+    size_t nmiddle = 1;
+    for (size_t k = 1; k + 1 < ndims; ++k) nmiddle *= shape[k];
+    size_t row_tiles = (nrows + kTile - 1) / kTile;
+    size_t col_tiles = (cols + kTile - 1) / kTile;
+    size_t ntasks = nmiddle * row_tiles * col_tiles;
+    if (ntasks == 0) return;
+
+    auto run_tile = [&](size_t task) {
+        size_t ct = task % col_tiles;
+        size_t rt = (task / col_tiles) % row_tiles;
+        size_t m = task / col_tiles / row_tiles;
+        size_t soff = 0, doff = 0;
+        for (size_t k = ndims - 1; k-- > 1;) {
+            size_t idx = m % shape[k];
+            m /= shape[k];
+            soff += idx * sstride[k];
+            doff += idx * dstride[k];
+        }
+        size_t i0 = rt * kTile, j0 = ct * kTile;
+        size_t rows = std::min(kTile, nrows - i0), ncols = std::min(kTile, cols - j0);
+        const char* s = src + (i0 * sstride[0] + soff + j0) * word_size;
+        char* d = dst + ((row_begin + i0) + doff + j0 * dstride[ndims - 1]) * word_size;
+        transpose_tile_any(s, sstride[0], d, dstride[ndims - 1], rows, ncols, word_size);
+    };
+
+    // only fan out when each thread gets at least a megabyte to move
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t nbytes = nrows * sstride[0] * word_size;
+    size_t nthreads = std::min<size_t>(threads, std::min(ntasks, std::max<size_t>(1, nbytes >> 20)));
+
+    if (nthreads <= 1) {
+        for (size_t task = 0; task < ntasks; ++task) run_tile(task);
+        return;
+    }
+
+    // the helpers run on the I/O engine's thread pool, which is started once per process, rather than on threads
+    // started for every chunk. the calling thread takes tiles as well, so it never depends on a helper getting a
+    // thread (this may itself run on the pool); helpers that start after the call is over find it closed and return
+    struct Shared {
+        std::atomic<size_t> next;
+        std::mutex mutex;
+        std::condition_variable idle;
+        unsigned active; // helpers taking tiles
+        bool closed;
+        Shared() : next(0), active(0), closed(false) {}
+    };
+    std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+    std::function<void(size_t)> tile = run_tile;
+    auto take_tiles = [shared, ntasks, &tile]() {
+        for (size_t task = shared->next++; task < ntasks; task = shared->next++) tile(task);
+    };
+    for (size_t t = 1; t < nthreads; ++t) {
+        cnpy::io::Engine::instance().run([shared, take_tiles]() {
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                if (shared->closed) return;
+                ++shared->active;
+            }
+            take_tiles();
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (--shared->active == 0) shared->idle.notify_all();
+        });
+    }
+    take_tiles();
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->closed = true;
+    shared->idle.wait(lock, [&shared] { return shared->active == 0; });
+}
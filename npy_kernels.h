@@ -0,0 +1,54 @@
+// Copyright (C) 2011  Carl Rogers
+// Released under MIT License
+// license available in LICENSE file, or at
+// http://www.opensource.org/licenses/mit-license.php
+
+// Internal data-movement kernels used by the loaders in cnpy.cpp. Not installed.
+
+#ifndef LIBCNPY_KERNELS_H_
+#define LIBCNPY_KERNELS_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace cnpy {
+    namespace kernels {
+
+        // Reverse the axis order of a C-order array with shape `shape`, writing into dst (a C-order array with the
+        // reversed shape, which is the Fortran-order layout of the original). src holds only rows [row_begin,
+        // row_end) of the slowest axis, so the conversion can run on each chunk as it is read. Work is tiled for
+        // cache reuse and split across up to `threads` threads (0 picks the hardware concurrency): the caller and
+        // helpers from the process-wide pool in npy_io.h, so no threads are started per call.
+        void reverse_axes(const char* src, char* dst, const std::vector<size_t>& shape, size_t row_begin,
+                          size_t row_end, size_t word_size, unsigned threads = 0);
+
+        // Reverse the byte order of each of the n `unit`-byte words in data, in place. 2, 4 and 8 byte words use an
+        // SSSE3 shuffle on CPUs that have it.
+        void byteswap(char* data, size_t unit, size_t n);
+
+        // Copy a `width`-byte item from each of n records `stride` bytes apart into the packed array dst. 4 and 8 byte
+        // items use AVX2 gathers on CPUs that have them.
+        void gather(const char* src, size_t stride, size_t width, char* dst, size_t n);
+
+        // IEEE half precision <-> float32 with round to nearest even. Uses F16C on CPUs that have it.
+        void half_to_float(const uint16_t* src, float* dst, size_t n);
+        void float_to_half(const float* src, uint16_t* dst, size_t n);
+
+        // bfloat16 <-> float32; narrowing rounds to nearest even and keeps NaNs quiet
+        void bfloat16_to_float(const uint16_t* src, float* dst, size_t n);
+        void float_to_bfloat16(const float* src, uint16_t* dst, size_t n);
+
+        // true if convert() handles numpy dtype kind ('f', 'i', 'u' or 'b') with this size in bytes. 'f' covers half,
+        // single and double precision
+        bool can_convert(char kind, size_t size);
+
+        // Convert n elements from one numeric dtype to another with C++ cast semantics. Narrowing conversions are
+        // range checked first and throw std::range_error if any value does not fit the destination type.
+        void convert(const char* src, char src_kind, size_t src_size, char* dst, char dst_kind, size_t dst_size,
+                     size_t n);
+
+    } // namespace kernels
+} // namespace cnpy
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef NPY_VIEW_H_
+#define NPY_VIEW_H_
+
+#include "cnpy.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace cnpy {
+
+    // Typed view of an N-dimensional array with element strides, so that slicing, transposing and reshaping do not
+    // copy. A view does not own its data: the NpyArray (or buffer) it was made from must outlive it.
+    //
+    //   NpyView<float, 2> m(arr);                      // throws unless arr holds float and has two dimensions
+    //   float x = m(3, 4);                             // checked with assert; m.at(3, 4) always checks
+    //   NpyView<float, 2> col = m.slice(1, Slice(4, 5)).transpose();
+    //   m.for_each_run([&](float* p, size_t n) { for (size_t i = 0; i < n; ++i) p[i] *= 2; });
+    template <typename T, size_t N> class NpyView {
+        static_assert(N > 0, "NpyView needs at least one dimension; use data<T>() for 0-d arrays");
+
+      public:
+        typedef T value_type;
+        typedef std::array<size_t, N> shape_type;
+        typedef std::array<ptrdiff_t, N> strides_type;
+
+        NpyView() : data_(nullptr) {
+            shape_.fill(0);
+            strides_.fill(0);
+        }
+
+        // strides are in elements, not bytes
+        NpyView(T* data, const shape_type& shape, const strides_type& strides)
+            : data_(data), shape_(shape), strides_(strides) {}
+
+        // view of all of arr, with strides following arr.fortran_order. throws unless arr holds T in native byte
+        // order and has N dimensions; works the same on in-memory and memory-mapped arrays
+        explicit NpyView(const NpyArray& arr) {
+            typedef typename std::remove_const<T>::type U;
+            if (arr.shape.size() != N)
+                throw std::runtime_error("NpyView: array has " + std::to_string(arr.shape.size()) +
+                                         " dimensions, not " + std::to_string(N));
+            data_ = const_cast<U*>(arr.checked_data<U>());
+            ptrdiff_t stride = 1;
+            for (size_t k = 0; k < N; ++k) {
+                size_t axis = arr.fortran_order ? k : N - 1 - k;
+                shape_[axis] = arr.shape[axis];
+                strides_[axis] = stride;
+                stride *= static_cast<ptrdiff_t>(arr.shape[axis]);
+            }
+        }
+
+        // a view of T converts to a view of const T
+        template <typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+        NpyView(const NpyView<U, N>& other) : data_(other.data()), shape_(other.shape()), strides_(other.strides()) {}
+
+        T* data() const { return data_; }
+        const shape_type& shape() const { return shape_; }
+        const strides_type& strides() const { return strides_; }
+        size_t shape(size_t axis) const { return shape_[axis]; }
+        ptrdiff_t stride(size_t axis) const { return strides_[axis]; }
+
+        size_t size() const {
+            size_t n = 1;
+            for (size_t k = 0; k < N; ++k) n *= shape_[k];
+            return n;
+        }
+
+        // true if the elements are packed in C order
+        bool is_contiguous() const {
+            ptrdiff_t expected = 1;
+            for (size_t k = N; k-- > 0;) {
+                if (shape_[k] != 1 && strides_[k] != expected) return false;
+                expected *= static_cast<ptrdiff_t>(shape_[k]);
+            }
+            return true;
+        }
+
+        template <typename... I> T& operator()(I... idx) const {
+            static_assert(sizeof...(I) == N, "NpyView: wrong number of indices");
+            const size_t ix[N] = {static_cast<size_t>(idx)...};
+            ptrdiff_t offset = 0;
+            for (size_t k = 0; k < N; ++k) {
+                assert(ix[k] < shape_[k]);
+                offset += static_cast<ptrdiff_t>(ix[k]) * strides_[k];
+            }
+            return data_[offset];
+        }
+
+        // operator() that throws std::out_of_range instead of asserting
+        template <typename... I> T& at(I... idx) const {
+            static_assert(sizeof...(I) == N, "NpyView: wrong number of indices");
+            const size_t ix[N] = {static_cast<size_t>(idx)...};
+            for (size_t k = 0; k < N; ++k)
+                if (ix[k] >= shape_[k])
+                    throw std::out_of_range("NpyView: index " + std::to_string(ix[k]) + " out of range for axis " +
+                                            std::to_string(k) + " with size " + std::to_string(shape_[k]));
+            return (*this)(idx...);
+        }
+
+        // the sub-view at index i of the first axis, or for a 1-d view the element itself
+        template <size_t M = N> typename std::enable_if<(M > 1), NpyView<T, M - 1>>::type operator[](size_t i) const {
+            assert(i < shape_[0]);
+            NpyView<T, N - 1> sub;
+            sub.data_ = data_ + static_cast<ptrdiff_t>(i) * strides_[0];
+            for (size_t k = 1; k < N; ++k) {
+                sub.shape_[k - 1] = shape_[k];
+                sub.strides_[k - 1] = strides_[k];
+            }
+            return sub;
+        }
+
+        template <size_t M = N> typename std::enable_if<M == 1, T&>::type operator[](size_t i) const {
+            assert(i < shape_[0]);
+            return data_[static_cast<ptrdiff_t>(i) * strides_[0]];
+        }
+
+        // the elements selected by s along one axis, with the same meaning as in npy_load_slice
+        NpyView slice(size_t axis, const Slice& s) const {
+            if (axis >= N) throw std::out_of_range("NpyView: no axis " + std::to_string(axis));
+            if (s.step == 0) throw std::runtime_error("NpyView: slice step must be positive");
+            size_t stop = std::min(s.stop, shape_[axis]);
+            size_t n = s.start < stop ? (stop - s.start + s.step - 1) / s.step : 0;
+            NpyView v(*this);
+            if (n > 0) v.data_ += static_cast<ptrdiff_t>(s.start) * strides_[axis];
+            v.shape_[axis] = n;
+            v.strides_[axis] = strides_[axis] * static_cast<ptrdiff_t>(s.step);
+            return v;
+        }
+
+        // one Slice per leading axis; missing trailing axes are taken whole
+        NpyView slice(const std::vector<Slice>& selection) const {
+            if (selection.size() > N) throw std::runtime_error("NpyView: more slices than dimensions");
+            NpyView v(*this);
+            for (size_t k = 0; k < selection.size(); ++k) v = v.slice(k, selection[k]);
+            return v;
+        }
+
+        // reversed axes, so a Fortran-ordered array becomes a C-contiguous view of the same memory
+        NpyView transpose() const {
+            NpyView v(*this);
+            for (size_t k = 0; k < N; ++k) {
+                v.shape_[k] = shape_[N - 1 - k];
+                v.strides_[k] = strides_[N - 1 - k];
+            }
+            return v;
+        }
+
+        // axis k of the result is axis axes[k] of this view
+        NpyView transpose(const std::array<size_t, N>& axes) const {
+            NpyView v(*this);
+            std::array<bool, N> seen;
+            seen.fill(false);
+            for (size_t k = 0; k < N; ++k) {
+                if (axes[k] >= N || seen[axes[k]]) throw std::runtime_error("NpyView: axes are not a permutation");
+                seen[axes[k]] = true;
+                v.shape_[k] = shape_[axes[k]];
+                v.strides_[k] = strides_[axes[k]];
+            }
+            return v;
+        }
+
+        // the same elements in C order with another shape. only contiguous views can be reshaped without a copy
+        template <size_t M> NpyView<T, M> reshape(const std::array<size_t, M>& shape) const {
+            size_t n = 1;
+            for (size_t k = 0; k < M; ++k) n *= shape[k];
+            if (n != size()) throw std::runtime_error("NpyView: reshape must keep the number of elements");
+            if (!is_contiguous()) throw std::runtime_error("NpyView: only contiguous views can be reshaped");
+            std::array<ptrdiff_t, M> strides;
+            ptrdiff_t stride = 1;
+            for (size_t k = M; k-- > 0;) {
+                strides[k] = stride;
+                stride *= static_cast<ptrdiff_t>(shape[k]);
+            }
+            return NpyView<T, M>(data_, shape, strides);
+        }
+
+        // call f(p, n) for each run of n unit-stride elements p[0] ... p[n - 1], visiting elements in C order.
+        // trailing axes are merged while they are contiguous, so a contiguous view is a single run and the loop over
+        // a run in f can be vectorized. if the last axis is not unit-stride, every run is one element
+        template <typename F> void for_each_run(F f) const {
+            walk([&f](T* p, size_t n, ptrdiff_t step) {
+                if (step == 1) {
+                    f(p, n);
+                } else {
+                    for (size_t i = 0; i < n; ++i) f(p + static_cast<ptrdiff_t>(i) * step, 1);
+                }
+            });
+        }
+
+        // call f(x) for every element in C order
+        template <typename F> void for_each(F f) const {
+            walk([&f](T* p, size_t n, ptrdiff_t step) {
+                if (step == 1) {
+                    for (size_t i = 0; i < n; ++i) f(p[i]);
+                } else {
+                    for (size_t i = 0; i < n; ++i) f(p[static_cast<ptrdiff_t>(i) * step]);
+                }
+            });
+        }
+
+      private:
+        template <typename U, size_t M> friend class NpyView;
+
+        // call g(p, n, step) for runs of n elements step apart, in C order, merging the innermost axes that can be
+        // walked with a single step
+        template <typename G> void walk(G g) const {
+            if (size() == 0) return;
+            size_t inner = N - 1; // axes [inner, N) form one run
+            size_t run = shape_[N - 1];
+            ptrdiff_t step = strides_[N - 1];
+            while (inner > 0) {
+                size_t k = inner - 1;
+                if (run == 1) {
+                    step = strides_[k];
+                } else if (shape_[k] != 1 && strides_[k] != step * static_cast<ptrdiff_t>(run)) {
+                    break;
+                }
+                run *= shape_[k];
+                inner = k;
+            }
+
+            // odometer over the outer axes [0, inner)
+            std::array<size_t, N> idx;
+            idx.fill(0);
+            T* p = data_;
+            while (true) {
+                g(p, run, step);
+                size_t k = inner;
+                while (k > 0) {
+                    --k;
+                    if (++idx[k] < shape_[k]) {
+                        p += strides_[k];
+                        break;
+                    }
+                    p -= static_cast<ptrdiff_t>(idx[k] - 1) * strides_[k];
+                    idx[k] = 0;
+                    if (k == 0) return;
+                }
+                if (inner == 0) return;
+            }
+        }
+
+        T* data_;
+        shape_type shape_;
+        strides_type strides_;
+    };
+
+    // the unit-stride runs of a view as segments for npy_save/npz_save, merging runs that are adjacent in memory
+    template <typename T, size_t N> std::vector<Segment> segments_of(const NpyView<T, N>& view) {
+        std::vector<Segment> segments;
+        view.for_each_run([&segments](T* p, size_t n) {
+            const char* end = segments.empty() ? nullptr
+                                               : static_cast<const char*>(segments.back().data) + segments.back().size;
+            if (end == reinterpret_cast<const char*>(p))
+                segments.back().size += n * sizeof(T);
+            else
+                segments.push_back(Segment(p, n * sizeof(T)));
+        });
+        return segments;
+    }
+
+    // save the elements of a view in its C order, writing straight from the viewed memory
+    template <typename T, size_t N>
+    void npy_save(std::string fname, const NpyView<T, N>& view, std::string mode = "w") {
+        typedef typename std::remove_const<T>::type U;
+        npy_save(fname, segments_of(view), Shape(view.shape().begin(), view.shape().end()), DType::of<U>(), mode);
+    }
+
+    template <typename T, size_t N>
+    void npz_save(std::string zipname, std::string fname, const NpyView<T, N>& view, std::string mode = "w",
+                  bool compress = false) {
+        typedef typename std::remove_const<T>::type U;
+        npz_save(zipname, fname, segments_of(view), Shape(view.shape().begin(), view.shape().end()), DType::of<U>(),
+                 mode, compress);
+    }
+
+} // namespace cnpy
+
+#endif
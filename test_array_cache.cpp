@@ -0,0 +1,93 @@
+// test_array_cache.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("repeated loads are served from the cache", "[array_cache]") {
+    std::vector<float> table(10000, 1.5f);
+    cnpy::npz_save("test_array_cache.npz", "table", table.data(), {100, 100}, "w", true);
+    cnpy::npy_save("test_array_cache.npy", table);
+
+    cnpy::ArrayCache cache(1 << 20);
+    cnpy::NpyArray first = cache.npz_load("test_array_cache.npz", "table");
+    cnpy::NpyArray second = cache.npz_load("test_array_cache.npz", "table");
+    REQUIRE(second.data<float>() == first.data<float>());
+    REQUIRE(second.as_vec<float>() == table);
+    // the same file's .npy is another array
+    REQUIRE(cache.npy_load("test_array_cache.npy").as_vec<float>() == table);
+
+    cnpy::ArrayCacheStats stats = cache.stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 2);
+    REQUIRE(stats.entries == 2);
+    REQUIRE(stats.bytes == 2 * table.size() * sizeof(float));
+
+    // a rewritten file is a different file
+    std::vector<float> other(50, 2.0f);
+    cnpy::npz_save("test_array_cache.npz", "table", other.data(), {50}, "w");
+    REQUIRE(cache.npz_load("test_array_cache.npz", "table").as_vec<float>() == other);
+    REQUIRE(cache.stats().misses == 3);
+
+    REQUIRE_THROWS_AS(cache.npz_load("test_array_cache.npz", "missing"), std::runtime_error);
+    REQUIRE_THROWS_AS(cache.npy_load("test_array_cache_missing.npy"), std::runtime_error);
+
+    cache.clear();
+    REQUIRE(cache.stats().entries == 0);
+    REQUIRE(cache.stats().bytes == 0);
+    std::remove("test_array_cache.npz");
+    std::remove("test_array_cache.npy");
+}
+
+TEST_CASE("the least recently used arrays are evicted to stay within budget", "[array_cache]") {
+    std::vector<double> data(1000, 3.0); // 8000 bytes per array
+    for (int i = 0; i < 3; ++i) cnpy::npz_save("test_array_cache.npz", "a" + std::to_string(i), data, i ? "a" : "w");
+
+    cnpy::ArrayCache cache(20000);
+    cache.npz_load("test_array_cache.npz", "a0");
+    cache.npz_load("test_array_cache.npz", "a1");
+    cache.npz_load("test_array_cache.npz", "a0"); // a1 is now the least recently used
+    cache.npz_load("test_array_cache.npz", "a2");
+    cnpy::ArrayCacheStats stats = cache.stats();
+    REQUIRE(stats.evictions == 1);
+    REQUIRE(stats.entries == 2);
+    cache.npz_load("test_array_cache.npz", "a0");
+    REQUIRE(cache.stats().hits == 2);
+    cache.npz_load("test_array_cache.npz", "a1");
+    REQUIRE(cache.stats().misses == 4);
+
+    // an array bigger than the budget is not kept
+    cache.set_budget(4000);
+    REQUIRE(cache.stats().entries == 0);
+    cache.npz_load("test_array_cache.npz", "a0");
+    REQUIRE(cache.stats().entries == 0);
+    std::remove("test_array_cache.npz");
+}
+
+TEST_CASE("the shared cache is safe to use from several threads", "[array_cache]") {
+    std::vector<int> data(5000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int>(i);
+    cnpy::npz_save("test_array_cache.npz", "x", data);
+    cnpy::npz_save("test_array_cache.npz", "y", data, "a", true);
+
+    cnpy::ArrayCache& cache = cnpy::ArrayCache::shared();
+    cache.clear();
+    cnpy::ArrayCacheStats before = cache.stats();
+    std::vector<std::thread> threads;
+    std::vector<int> ok(4, 1);
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            for (int i = 0; i < 50; ++i)
+                if (cache.npz_load("test_array_cache.npz", i % 2 ? "x" : "y").as_vec<int>() != data) ok[t] = 0;
+        }));
+    }
+    for (std::thread& thread : threads) thread.join();
+    REQUIRE(ok == std::vector<int>(4, 1));
+    cnpy::ArrayCacheStats after = cache.stats();
+    REQUIRE(after.hits + after.misses - before.hits - before.misses == 200);
+    REQUIRE(after.entries == 2);
+    cache.clear();
+    std::remove("test_array_cache.npz");
+}
@@ -0,0 +1,95 @@
+// test_async.cpp
+#include "cnpy.h"
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("many .npy files save and load concurrently", "[cnpy][async]") {
+    INFO("io_uring: " << cnpy::async_uses_io_uring());
+    const size_t nfiles = 64;
+    std::vector<std::vector<int32_t>> data(nfiles);
+    std::vector<std::future<void>> saves;
+    for (size_t f = 0; f < nfiles; ++f) {
+        data[f].resize(1000 + f * 997);
+        for (size_t i = 0; i < data[f].size(); ++i) data[f][i] = static_cast<int32_t>(f * 100000 + i);
+        std::string name = "test_async_" + std::to_string(f) + ".npy";
+        if (f % 2)
+            saves.push_back(cnpy::npy_save_async(name, data[f].data(), {data[f].size()}));
+        else
+            saves.push_back(
+                cnpy::npy_save_async(name, data[f].data(), {data[f].size() / 2, 2}, cnpy::DType('i', 4, '>')));
+    }
+    for (std::future<void>& s : saves) s.get();
+
+    std::vector<std::future<cnpy::NpyArray>> loads;
+    for (size_t f = 0; f < nfiles; ++f)
+        loads.push_back(cnpy::npy_load_async("test_async_" + std::to_string(f) + ".npy"));
+    for (size_t f = 0; f < nfiles; ++f) {
+        cnpy::NpyArray arr = loads[f].get();
+        REQUIRE(arr.dtype == cnpy::DType::of<int32_t>());
+        REQUIRE(arr.num_vals == data[f].size());
+        REQUIRE(std::vector<int32_t>(arr.data<int32_t>(), arr.data<int32_t>() + arr.num_vals) == data[f]);
+        std::remove(("test_async_" + std::to_string(f) + ".npy").c_str());
+    }
+
+    REQUIRE_THROWS(cnpy::npy_load_async("test_async_missing.npy").get());
+}
+
+TEST_CASE("headers longer than the first read and empty arrays", "[cnpy][async]") {
+    const std::string filename = "test_async_wide.npy";
+    std::vector<cnpy::Field> fields;
+    for (size_t i = 0; i < 400; ++i)
+        fields.push_back(cnpy::Field("column_" + std::to_string(i), cnpy::DType::of<uint8_t>(), i));
+    cnpy::DType wide = cnpy::DType::structured(fields, fields.size());
+    std::vector<uint8_t> records(3 * fields.size());
+    for (size_t i = 0; i < records.size(); ++i) records[i] = static_cast<uint8_t>(i * 31);
+    cnpy::npy_save(filename, records.data(), {3}, wide);
+    REQUIRE(cnpy::create_npy_header({3}, wide).size() > 4096);
+
+    // the callback runs on another thread, so it only records what it got
+    std::atomic<bool> called(false);
+    cnpy::NpyArray got;
+    std::exception_ptr failure;
+    cnpy::npy_load_async(filename, [&](cnpy::NpyArray arr, std::exception_ptr error) {
+        got = arr;
+        failure = error;
+        called = true;
+    });
+    while (!called) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    REQUIRE_FALSE(failure);
+    REQUIRE(got.dtype == wide);
+    REQUIRE(got.field<uint8_t>("column_399")[2] == static_cast<uint8_t>((2 * 400 + 399) * 31));
+
+    cnpy::npy_save_async(filename, records.data(), {0, 5}).get();
+    cnpy::NpyArray empty = cnpy::npy_load_async(filename).get();
+    REQUIRE(empty.shape == cnpy::Shape({0, 5}));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npz saves to one archive keep their order", "[cnpy][async]") {
+    const std::string filename = "test_async.npz";
+    std::vector<double> a(5000), b(300);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = i * 0.5;
+    for (size_t i = 0; i < b.size(); ++i) b[i] = -static_cast<double>(i);
+    std::vector<std::future<void>> saves;
+    saves.push_back(cnpy::npz_save_async(filename, "a", a.data(), {a.size()}, "w"));
+    saves.push_back(cnpy::npz_save_async(filename, "b", b.data(), {b.size()}, "a", true));
+    for (int k = 0; k < 8; ++k)
+        saves.push_back(cnpy::npz_save_async(filename, "c" + std::to_string(k), &a[k], {1}, "a"));
+    for (std::future<void>& s : saves) s.get();
+
+    std::future<cnpy::NpyArray> stored = cnpy::npz_load_async(filename, "a");
+    std::future<cnpy::NpyArray> deflated = cnpy::npz_load_async(filename, "b");
+    std::future<cnpy::NpyArray> last = cnpy::npz_load_async(filename, "c7");
+    REQUIRE(stored.get().as_vec<double>() == a);
+    REQUIRE(deflated.get().as_vec<double>() == b);
+    REQUIRE(last.get().as_vec<double>() == std::vector<double>{a[7]});
+    REQUIRE_THROWS(cnpy::npz_load_async(filename, "missing").get());
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,104 @@
+// test_atomic_save.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// the number of files in the current directory whose names start with prefix
+static size_t count_files(const std::string& prefix) {
+    size_t n = 0;
+    DIR* dir = opendir(".");
+    REQUIRE(dir);
+    while (struct dirent* entry = readdir(dir))
+        if (std::string(entry->d_name).compare(0, prefix.size(), prefix) == 0) ++n;
+    closedir(dir);
+    return n;
+}
+
+TEST_CASE("atomic saves replace the file in one step", "[cnpy][atomic]") {
+    const std::string filename = "test_atomic.npy";
+    std::vector<double> before(1000, 1.0), after(2000, 2.0);
+    cnpy::npy_save(filename, before);
+
+    // a reader that already has the file open keeps seeing the old contents
+    FILE* reader = fopen(filename.c_str(), "rb");
+    REQUIRE(reader);
+
+    for (cnpy::FsyncPolicy fsync : {cnpy::FsyncPolicy::None, cnpy::FsyncPolicy::Data, cnpy::FsyncPolicy::Full}) {
+        cnpy::SaveOptions options;
+        options.atomic = true;
+        options.fsync = fsync;
+        options.direct = fsync == cnpy::FsyncPolicy::Full;
+        cnpy::npy_save(filename, after.data(), {after.size()}, cnpy::DType::of<double>(), options);
+        REQUIRE(cnpy::npy_load(filename).as_vec<double>() == after);
+    }
+    fseek(reader, 0, SEEK_END);
+    REQUIRE(static_cast<size_t>(ftell(reader)) == cnpy::create_npy_header<double>({1000}).size() + 8000);
+    fclose(reader);
+
+    // nothing is left behind, including after a failed save
+    cnpy::SaveOptions options;
+    options.atomic = true;
+    REQUIRE_THROWS(cnpy::npy_save("no_such_directory/" + filename, after.data(), {2000}, cnpy::DType::of<double>(),
+                                  options));
+    REQUIRE(count_files(".test_atomic") == 0);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("atomic npz saves keep the existing entries", "[cnpy][atomic]") {
+    const std::string filename = "test_atomic.npz";
+    std::vector<int> a = {1, 2, 3}, b = {4, 5};
+    cnpy::SaveOptions options;
+    options.atomic = true;
+    options.fsync = cnpy::FsyncPolicy::Data;
+    cnpy::npz_save(filename, "a", a.data(), {3}, cnpy::DType::of<int>(), "w", false, options);
+    cnpy::npz_save(filename, "b", b.data(), {2}, cnpy::DType::of<int>(), "a", true, options);
+    cnpy::npz_save(filename, "c", b.data(), {2}, cnpy::DType::of<int>(), "a", false, cnpy::SaveOptions());
+
+    cnpy::npz_t npz = cnpy::npz_load(filename);
+    REQUIRE(npz.size() == 3);
+    REQUIRE(npz["a"].as_vec<int>() == a);
+    REQUIRE(npz["b"].as_vec<int>() == b);
+    REQUIRE(npz["c"].as_vec<int>() == b);
+
+    // batch writers publish the same way
+    cnpy::SaveManyOptions many;
+    many.save = options;
+    cnpy::npz_save_many(filename, {cnpy::SaveItem("x", a.data(), {3})}, false, many);
+    REQUIRE(cnpy::npz_load(filename).size() == 1);
+    cnpy::npy_save_many({cnpy::SaveItem("test_atomic_many.npy", b.data(), {2})}, many);
+    REQUIRE(cnpy::npy_load("test_atomic_many.npy").as_vec<int>() == b);
+    REQUIRE(count_files(".test_atomic") == 0);
+    std::remove(filename.c_str());
+    std::remove("test_atomic_many.npy");
+}
+
+TEST_CASE("atomic saves keep the replaced file's permissions", "[cnpy][atomic]") {
+    const std::string filename = "test_atomic_mode.npy";
+    std::vector<double> data(100, 3.0);
+    cnpy::npy_save(filename, data);
+    REQUIRE(chmod(filename.c_str(), 0600) == 0);
+
+    cnpy::SaveOptions options;
+    options.atomic = true;
+    cnpy::npy_save(filename, data.data(), {data.size()}, cnpy::DType::of<double>(), options);
+    struct stat st;
+    REQUIRE(stat(filename.c_str(), &st) == 0);
+    REQUIRE((st.st_mode & 07777) == 0600);
+    REQUIRE(st.st_uid == getuid());
+    REQUIRE(cnpy::npy_load(filename).as_vec<double>() == data);
+
+    cnpy::npz_save("test_atomic_mode.npz", "a", data.data(), {data.size()}, cnpy::DType::of<double>(), "w", false,
+                   options);
+    REQUIRE(chmod("test_atomic_mode.npz", 0640) == 0);
+    cnpy::npz_save("test_atomic_mode.npz", "b", data.data(), {data.size()}, cnpy::DType::of<double>(), "a", false,
+                   options);
+    REQUIRE(stat("test_atomic_mode.npz", &st) == 0);
+    REQUIRE((st.st_mode & 07777) == 0640);
+    std::remove(filename.c_str());
+    std::remove("test_atomic_mode.npz");
+}
@@ -0,0 +1,120 @@
+// test_backend.cpp
+#include "cnpy.h"
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// a stand-in for a remote store: ranged reads only, counted
+class CountingSource : public cnpy::Source {
+  public:
+    explicit CountingSource(const std::vector<char>& bytes) : bytes_(bytes), reads(0) {}
+    size_t size() const { return bytes_.size(); }
+    void read_at(void* dst, size_t n, size_t offset) const {
+        if (offset + n > bytes_.size()) throw std::runtime_error("CountingSource: read past the end");
+        memcpy(dst, bytes_.data() + offset, n);
+        ++reads;
+    }
+    std::vector<char> bytes_;
+    mutable std::atomic<size_t> reads;
+};
+
+static std::vector<float> ramp(size_t n) {
+    std::vector<float> v(n);
+    for (size_t i = 0; i < n; ++i) v[i] = static_cast<float>(i % 101);
+    return v;
+}
+
+TEST_CASE("arrays load from a custom source with ranged reads", "[backend]") {
+    std::vector<float> a = ramp(5000);
+    std::vector<int> b(700, -3);
+    std::vector<cnpy::SaveItem> items = {cnpy::SaveItem("a", a.data(), {50, 100}),
+                                         cnpy::SaveItem("b", b.data(), {700})};
+    for (bool compress : {false, true}) {
+        std::shared_ptr<CountingSource> source =
+            std::make_shared<CountingSource>(cnpy::npz_save_buffer(items, compress));
+        cnpy::npz_t arrays = cnpy::npz_load(source, 4);
+        REQUIRE(source->reads > 0);
+        REQUIRE(arrays["a"].shape == cnpy::Shape({50, 100}));
+        REQUIRE(arrays["a"].as_vec<float>() == a);
+        REQUIRE(arrays["b"].as_vec<int>() == b);
+        REQUIRE(cnpy::npz_load(source, "b").as_vec<int>() == b);
+        REQUIRE_THROWS_AS(cnpy::npz_load(source, "c"), std::runtime_error);
+    }
+
+    std::shared_ptr<CountingSource> npy =
+        std::make_shared<CountingSource>(cnpy::npy_save_buffer(a.data(), {5000}, cnpy::DType::of<float>()));
+    REQUIRE(cnpy::npy_load(npy).as_vec<float>() == a);
+}
+
+TEST_CASE("file and fd sources", "[backend]") {
+    std::vector<float> a = ramp(3000);
+    cnpy::npy_save("test_backend.npy", a);
+
+    cnpy::NpyArray read = cnpy::npy_load(std::make_shared<cnpy::FileSource>("test_backend.npy"));
+    REQUIRE(read.as_vec<float>() == a);
+
+    // a mapped file is viewed in place and stays mapped for as long as the array does
+    std::shared_ptr<cnpy::FileSource> mapped = std::make_shared<cnpy::FileSource>("test_backend.npy", true);
+    REQUIRE(mapped->data() != nullptr);
+    cnpy::NpyArray view = cnpy::npy_load(mapped);
+    const char* base = static_cast<const char*>(mapped->data());
+    REQUIRE(view.data<char>() > base);
+    REQUIRE(view.data<char>() < base + mapped->size());
+    mapped.reset();
+    REQUIRE(view.as_vec<float>() == a);
+
+    int fd = open("test_backend.npy", O_RDONLY);
+    REQUIRE(cnpy::npy_load(std::make_shared<cnpy::FdSource>(fd)).as_vec<float>() == a);
+    close(fd);
+    std::remove("test_backend.npy");
+
+    REQUIRE_THROWS_AS(cnpy::FileSource("test_backend_missing.npy"), std::runtime_error);
+}
+
+TEST_CASE("targets receive the same bytes as the buffer savers", "[backend]") {
+    std::vector<float> a = ramp(2000);
+    std::vector<cnpy::SaveItem> items = {cnpy::SaveItem("a", a.data(), {2000})};
+
+    cnpy::MemoryTarget memory;
+    cnpy::npy_save(memory, a.data(), {2000}, cnpy::DType::of<float>());
+    REQUIRE(memory.buffer == cnpy::npy_save_buffer(a.data(), {2000}, cnpy::DType::of<float>()));
+
+    {
+        cnpy::FileTarget file("test_backend.npz");
+        cnpy::npz_save(file, items, true);
+    }
+    REQUIRE(cnpy::npz_load("test_backend.npz", "a").as_vec<float>() == a);
+
+    int fd = open("test_backend.npz", O_WRONLY | O_TRUNC);
+    cnpy::FdTarget target(fd);
+    cnpy::npz_save(target, items);
+    close(fd);
+    REQUIRE(cnpy::npz_load("test_backend.npz", "a").as_vec<float>() == a);
+    std::remove("test_backend.npz");
+}
+
+TEST_CASE("FileTarget creates files like npy_save does", "[backend]") {
+    std::vector<float> a = ramp(10);
+    mode_t old = umask(0);
+    {
+        cnpy::FileTarget file("test_backend_target.npy");
+        cnpy::npy_save(file, a.data(), {10}, cnpy::DType::of<float>());
+    }
+    cnpy::npy_save("test_backend_path.npy", a);
+    umask(old);
+    struct stat target, path;
+    REQUIRE(stat("test_backend_target.npy", &target) == 0);
+    REQUIRE(stat("test_backend_path.npy", &path) == 0);
+    REQUIRE((target.st_mode & 0777) == 0666);
+    REQUIRE((target.st_mode & 0777) == (path.st_mode & 0777));
+    std::remove("test_backend_target.npy");
+    std::remove("test_backend_path.npy");
+}
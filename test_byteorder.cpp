@@ -0,0 +1,145 @@
+// test_byteorder.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    // read back the raw bytes of the data section of a .npy file
+    std::vector<unsigned char> raw_data(const std::string& fname, size_t nbytes) {
+        FILE* fp = fopen(fname.c_str(), "rb");
+        REQUIRE(fp);
+        fseek(fp, -static_cast<long>(nbytes), SEEK_END);
+        std::vector<unsigned char> out(nbytes);
+        REQUIRE(fread(out.data(), 1, nbytes, fp) == nbytes);
+        fclose(fp);
+        return out;
+    }
+} // namespace
+
+TEST_CASE("big-endian .npy files are swapped to native order on load", "[cnpy][byteorder]") {
+    const std::string filename = "test_byteorder_f8.npy";
+    std::vector<double> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i * 1.25 - 7.0;
+    cnpy::npy_save(filename, data.data(), {10, 100}, cnpy::DType('f', 8, '>'));
+
+    // the file really holds big-endian words
+    std::vector<unsigned char> raw = raw_data(filename, 8 * data.size());
+    uint64_t bits;
+    memcpy(&bits, &data[1], 8);
+    REQUIRE(raw[8 + 7] == (bits & 0xff));
+
+    cnpy::NpyArray arr = cnpy::npy_load(filename);
+    REQUIRE(arr.dtype == cnpy::DType::of<double>());
+    REQUIRE(arr.as_vec<double>() == data);
+
+    cnpy::NpyArray fortran = cnpy::npy_load(filename, cnpy::MemoryOrder::Fortran);
+    REQUIRE(fortran.checked_data<double>()[1] == data[100]);
+
+    cnpy::NpyArray narrow = cnpy::npy_load_as<float>(filename);
+    REQUIRE(narrow.checked_data<float>()[3] == static_cast<float>(data[3]));
+
+    std::vector<double> dst(data.size());
+    cnpy::npy_load_into(filename, dst.data(), {10, 100});
+    REQUIRE(dst == data);
+
+    cnpy::NpyArray slice = cnpy::npy_load_slice(filename, {cnpy::Slice(2, 4), cnpy::Slice(10, 20, 5)});
+    REQUIRE(slice.checked_data<double>()[1] == data[215]);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("every word size is swapped, including the ragged tail", "[cnpy][byteorder]") {
+    const std::string filename = "test_byteorder_words.npy";
+    // 37 words: whole vector blocks plus a scalar tail
+    std::vector<uint16_t> u2(37);
+    std::vector<uint32_t> u4(37);
+    std::vector<uint64_t> u8(37);
+    for (size_t i = 0; i < 37; ++i) {
+        u2[i] = static_cast<uint16_t>(0x0102 + i * 0x1111);
+        u4[i] = static_cast<uint32_t>(0x01020304 + i * 0x11111111u);
+        u8[i] = 0x0102030405060708ull + i * 0x1111111111111111ull;
+    }
+
+    cnpy::npy_save(filename, u2.data(), {37}, cnpy::DType('u', 2, '>'));
+    std::vector<unsigned char> raw = raw_data(filename, 2 * 37);
+    REQUIRE(raw[2 * 36] == (u2[36] >> 8));
+    REQUIRE(cnpy::npy_load(filename).as_vec<uint16_t>() == u2);
+
+    cnpy::npy_save(filename, u4.data(), {37}, cnpy::DType('u', 4, '>'));
+    raw = raw_data(filename, 4 * 37);
+    REQUIRE(raw[4 * 20] == (u4[20] >> 24));
+    REQUIRE(cnpy::npy_load(filename).as_vec<uint32_t>() == u4);
+
+    cnpy::npy_save(filename, u8.data(), {37}, cnpy::DType('u', 8, '>'));
+    raw = raw_data(filename, 8 * 37);
+    REQUIRE(raw[8 * 5] == (u8[5] >> 56));
+    REQUIRE(cnpy::npy_load(filename).as_vec<uint64_t>() == u8);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("big-endian mmap arrays keep their byte order until as_native", "[cnpy][byteorder]") {
+    const std::string filename = "test_byteorder_i4.npy";
+    std::vector<int32_t> data = {1, -2, 0x01020304, 70000};
+    cnpy::npy_save(filename, data.data(), {data.size()}, cnpy::DType('i', 4, '>'));
+
+    cnpy::NpyArray mapped = cnpy::npy_load(filename, true);
+    REQUIRE(mapped.dtype.byte_order == '>');
+    REQUIRE_THROWS(mapped.checked_data<int32_t>());
+    cnpy::NpyArray native = cnpy::as_native(mapped);
+    REQUIRE(native.as_vec<int32_t>() == data);
+    REQUIRE(mapped.dtype.byte_order == '>');
+
+    // appending keeps the file's byte order
+    std::vector<int32_t> more = {5};
+    cnpy::npy_save(filename, more.data(), {1}, cnpy::DType('i', 4, '>'), "a");
+    REQUIRE_THROWS(cnpy::npy_save(filename, more.data(), {1}, "a"));
+    REQUIRE(cnpy::npy_load(filename).as_vec<int32_t>().back() == 5);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("appending matches byte orders by layout", "[cnpy][byteorder]") {
+    const std::string filename = "test_byteorder_u1.npy";
+    // numpy writes single-byte and order-less dtypes with '|'
+    std::vector<uint8_t> bytes = {1, 2, 3};
+    cnpy::npy_save(filename, bytes.data(), {bytes.size()}, cnpy::DType('u', 1, '|'));
+    REQUIRE(cnpy::npy_load(filename).dtype.str() == "|u1");
+    std::vector<uint8_t> more = {4, 5};
+    cnpy::npy_save(filename, more.data(), {more.size()}, "a");
+    REQUIRE(cnpy::npy_load(filename).as_vec<uint8_t>() == std::vector<uint8_t>({1, 2, 3, 4, 5}));
+
+    std::vector<int32_t> ints = {1, 2};
+    cnpy::npy_save(filename, ints.data(), {ints.size()}, cnpy::DType('i', 4, '='));
+    cnpy::npy_save(filename, ints.data(), {ints.size()}, "a");
+    REQUIRE(cnpy::npy_load(filename).as_vec<int32_t>() == std::vector<int32_t>({1, 2, 1, 2}));
+    REQUIRE_THROWS(cnpy::npy_save(filename, ints.data(), {ints.size()}, cnpy::DType('u', 4), "a"));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("big-endian npz entries load natively", "[cnpy][byteorder]") {
+    const std::string filename = "test_byteorder.npz";
+    std::vector<std::complex<double>> z = {{1, 2}, {-3.5, 4}};
+    std::vector<uint16_t> u(5000);
+    for (size_t i = 0; i < u.size(); ++i) u[i] = static_cast<uint16_t>(i * 13);
+    cnpy::npz_save(filename, "z", z.data(), {z.size()}, cnpy::DType('c', 16, '>'), "w");
+    cnpy::npz_save(filename, "u", u.data(), {100, 50}, cnpy::DType('u', 2, '>'), "a", true);
+
+    cnpy::npz_t npz = cnpy::npz_load(filename);
+    REQUIRE(npz["z"].as_vec<std::complex<double>>() == z);
+    REQUIRE(npz["u"].dtype == cnpy::DType::of<uint16_t>());
+    REQUIRE(npz["u"].as_vec<uint16_t>() == u);
+
+    cnpy::NpyArray rows = cnpy::npz_load_rows(filename, "u", 10, 12);
+    REQUIRE(rows.checked_data<uint16_t>()[0] == u[500]);
+    cnpy::NpzSeekIndex index(filename, "u", 1024);
+    REQUIRE(index.dtype().byte_order == '>');
+    REQUIRE(index.load_rows(99, 100).checked_data<uint16_t>()[49] == u.back());
+
+    std::vector<uint16_t> dst(u.size());
+    cnpy::npz_load_into(filename, "u", dst.data(), {100, 50});
+    REQUIRE(dst == u);
+    std::remove(filename.c_str());
+}
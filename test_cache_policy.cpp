@@ -0,0 +1,83 @@
+// test_cache_policy.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <linux/magic.h>
+#include <sys/vfs.h>
+#endif
+
+// the fraction of fname's pages in the page cache, or -1 where that cannot be told (tmpfs keeps every page)
+static double cached_fraction(const std::string& fname) {
+#ifdef __linux__
+    struct statfs fs;
+    if (statfs(fname.c_str(), &fs) != 0 || fs.f_type == TMPFS_MAGIC) return -1;
+    int fd = open(fname.c_str(), O_RDONLY);
+    off_t size = lseek(fd, 0, SEEK_END);
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    size_t page = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> resident((size + page - 1) / page);
+    mincore(p, size, resident.data());
+    munmap(p, size);
+    size_t n = 0;
+    for (unsigned char r : resident) n += r & 1;
+    return static_cast<double>(n) / resident.size();
+#else
+    return -1;
+#endif
+}
+
+TEST_CASE("streamed saves and loads leave little in the page cache", "[cnpy][cache]") {
+    const std::string filename = "test_cache_policy.npy";
+    std::vector<int32_t> data(12 << 20); // 48 MiB, several writeback windows
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int32_t>(i * 7);
+
+    cnpy::SaveOptions options;
+    options.cache = cnpy::CachePolicy::Stream;
+    cnpy::npy_save(filename, data.data(), {data.size() / 4, 4}, cnpy::DType::of<int32_t>(), options);
+    double cached = cached_fraction(filename);
+    if (cached >= 0) REQUIRE(cached < 0.5);
+
+    cnpy::NpyArray arr = cnpy::npy_load(filename, cnpy::CachePolicy::Stream);
+    REQUIRE(arr.shape == cnpy::Shape({data.size() / 4, 4}));
+    REQUIRE(arr.as_vec<int32_t>() == data);
+    cached = cached_fraction(filename);
+    if (cached >= 0) REQUIRE(cached < 0.5);
+
+    cnpy::LoadManyOptions many;
+    many.cache = cnpy::CachePolicy::Stream;
+    REQUIRE(cnpy::npy_load_many({filename}, many)[0].array.num_vals == data.size());
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("streamed npz saves and loads", "[cnpy][cache]") {
+    const std::string filename = "test_cache_policy.npz";
+    std::vector<double> a(3 << 20), b(1000);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = i * 0.5;
+    for (size_t i = 0; i < b.size(); ++i) b[i] = -static_cast<double>(i);
+
+    cnpy::SaveOptions options;
+    options.cache = cnpy::CachePolicy::Stream;
+    cnpy::npz_save(filename, "a", a.data(), {a.size()}, cnpy::DType::of<double>(), "w", false, options);
+    cnpy::npz_save(filename, "b", b.data(), {b.size()}, cnpy::DType::of<double>(), "a", true, options);
+    REQUIRE(cnpy::npz_load(filename, "a", cnpy::CachePolicy::Stream).as_vec<double>() == a);
+    cnpy::npz_t npz = cnpy::npz_load(filename, cnpy::CachePolicy::Stream);
+    REQUIRE(npz["b"].as_vec<double>() == b);
+
+    cnpy::SaveManyOptions many;
+    many.save = options;
+    std::vector<cnpy::SaveItem> items = {cnpy::SaveItem("a", a.data(), {a.size()}),
+                                         cnpy::SaveItem("b", b.data(), {b.size()})};
+    for (bool compress : {false, true}) {
+        cnpy::npz_save_many(filename, items, compress, many);
+        REQUIRE(cnpy::npz_load(filename, "a").as_vec<double>() == a);
+    }
+    std::remove(filename.c_str());
+}
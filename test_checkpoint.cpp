@@ -0,0 +1,48 @@
+// test_checkpoint.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST_CASE("checkpoints hold the arrays as they were when saved", "[cnpy][checkpoint]") {
+    std::vector<float> field(200000);
+    std::vector<int64_t> step(1);
+    std::vector<std::string> names;
+    {
+        cnpy::CheckpointWriter writer(2, false);
+        for (int64_t s = 0; s < 6; ++s) {
+            for (size_t i = 0; i < field.size(); ++i) field[i] = s + i * 1e-3f;
+            step[0] = s;
+            names.push_back("test_checkpoint_" + std::to_string(s) + ".npz");
+            writer.save(names.back(), {cnpy::SaveItem("field", field.data(), {400, 500}),
+                                       cnpy::SaveItem("step", step.data(), {1})});
+            // the writer has its own copy, so the arrays can change straight away
+            for (size_t i = 0; i < field.size(); ++i) field[i] = -1;
+        }
+        writer.wait();
+    }
+
+    for (int64_t s = 0; s < 6; ++s) {
+        cnpy::npz_t npz = cnpy::npz_load(names[s]);
+        REQUIRE(npz["step"].as_vec<int64_t>()[0] == s);
+        REQUIRE(npz["field"].shape == cnpy::Shape({400, 500}));
+        REQUIRE(npz["field"].data<float>()[12345] == s + 12345 * 1e-3f);
+        std::remove(names[s].c_str());
+    }
+}
+
+TEST_CASE("a failed background write is reported once", "[cnpy][checkpoint]") {
+    std::vector<double> x = {1, 2, 3};
+    cnpy::CheckpointWriter writer(1, true);
+    writer.save("no_such_directory/test_checkpoint.npz", {cnpy::SaveItem("x", x.data(), {3})});
+    REQUIRE_THROWS(writer.wait());
+
+    writer.save("test_checkpoint_ok.npz", {cnpy::SaveItem("x", x.data(), {3})});
+    writer.wait();
+    REQUIRE(cnpy::npz_load("test_checkpoint_ok.npz", "x").as_vec<double>() == x);
+    std::remove("test_checkpoint_ok.npz");
+
+    REQUIRE_THROWS(cnpy::CheckpointWriter(0));
+}
@@ -0,0 +1,71 @@
+// test_direct_save.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+    size_t file_size(const std::string& fname) {
+        struct stat st;
+        REQUIRE(stat(fname.c_str(), &st) == 0);
+        return static_cast<size_t>(st.st_size);
+    }
+} // namespace
+
+TEST_CASE("the raw fd save path writes a normal .npy file", "[cnpy][direct]") {
+    const std::string filename = "test_direct_save_plain.npy";
+    std::vector<double> data(12345);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i / 3.0;
+    cnpy::npy_save(filename, data.data(), {data.size()}, cnpy::DType::of<double>(), cnpy::SaveOptions());
+    REQUIRE(file_size(filename) == cnpy::create_npy_header<double>({data.size()}).size() + data.size() * 8);
+    REQUIRE(cnpy::npy_load(filename).as_vec<double>() == data);
+
+    // appending keeps the header the size it was
+    cnpy::npy_save(filename, data.data(), {data.size()}, "a");
+    cnpy::NpyArray arr = cnpy::npy_load(filename);
+    REQUIRE(arr.shape == cnpy::Shape{2 * data.size()});
+    REQUIRE(arr.data<double>()[data.size() + 5] == data[5]);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("O_DIRECT saves pad the header to a block and handle unaligned tails", "[cnpy][direct]") {
+    const std::string filename = "test_direct_save.npy";
+    cnpy::SaveOptions options;
+    options.direct = true;
+
+    // block-aligned memory is written in place, apart from the partial last block
+    const size_t n = 3 * 1024 * 1024 + 77;
+    float* aligned = nullptr;
+    REQUIRE(posix_memalign(reinterpret_cast<void**>(&aligned), 4096, n * sizeof(float)) == 0);
+    for (size_t i = 0; i < n; ++i) aligned[i] = static_cast<float>(i % 1000) - 0.5f;
+    cnpy::npy_save(filename, aligned, {n}, cnpy::DType::of<float>(), options);
+    REQUIRE(file_size(filename) == 4096 + n * sizeof(float));
+    cnpy::NpyArray arr = cnpy::npy_load(filename, true);
+    REQUIRE(arr.data_offset == 4096);
+    REQUIRE(arr.data<float>()[n - 1] == aligned[n - 1]);
+    REQUIRE(arr.as_vec<float>() == std::vector<float>(aligned, aligned + n));
+
+    // unaligned memory and segments go through the bounce buffer
+    std::vector<cnpy::Segment> segments = {cnpy::Segment(reinterpret_cast<char*>(aligned) + 12, 40000),
+                                           cnpy::Segment(aligned, 8)};
+    cnpy::npy_save(filename, segments, {5001}, cnpy::DType::of<double>(), options);
+    REQUIRE(file_size(filename) == 4096 + 40008);
+    cnpy::NpyArray mixed = cnpy::npy_load(filename);
+    REQUIRE(memcmp(mixed.data<char>(), reinterpret_cast<char*>(aligned) + 12, 40000) == 0);
+    REQUIRE(memcmp(mixed.data<char>() + 40000, aligned, 8) == 0);
+
+    // rows appended to the padded file land after it
+    cnpy::npy_save(filename, aligned, {3}, cnpy::DType::of<double>(), "a");
+    REQUIRE(cnpy::npy_load(filename).shape == cnpy::Shape{5004});
+
+    std::vector<int16_t> small = {1, -2, 3};
+    cnpy::npy_save(filename, small.data(), {small.size()}, cnpy::DType('i', 2, '>'), options);
+    REQUIRE(cnpy::npy_load(filename).as_vec<int16_t>() == small);
+    free(aligned);
+    std::remove(filename.c_str());
+}
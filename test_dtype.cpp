@@ -0,0 +1,95 @@
+// test_dtype.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("type traits map C++ types to numpy dtypes", "[cnpy][dtype]") {
+    REQUIRE(cnpy::npy_type<float>::kind == 'f');
+    REQUIRE(cnpy::npy_type<int8_t>::kind == 'i');
+    REQUIRE(cnpy::npy_type<uint16_t>::kind == 'u');
+    REQUIRE(cnpy::npy_type<bool>::kind == 'b');
+    REQUIRE(cnpy::npy_type<std::complex<double>>::kind == 'c');
+
+    REQUIRE(cnpy::DType::of<int32_t>().str() == "<i4");
+    REQUIRE(cnpy::DType::of<double>().str() == "<f8");
+    REQUIRE(cnpy::dtype_of(typeid(signed char)) == cnpy::DType('i', 1));
+    REQUIRE(cnpy::dtype_of(typeid(std::complex<float>)) == cnpy::DType('c', 8));
+    REQUIRE(cnpy::dtype_of(typeid(std::string)).kind == '?');
+}
+
+TEST_CASE("loaded arrays carry the dtype from the header", "[cnpy][dtype]") {
+    const std::string filename = "test_dtype.npy";
+    std::vector<int32_t> ints = {1, -2, 3};
+    cnpy::npy_save(filename, ints.data(), {ints.size()}, "w");
+    cnpy::NpyArray a = cnpy::npy_load(filename);
+    REQUIRE(a.dtype == cnpy::DType::of<int32_t>());
+    REQUIRE(a.checked_data<int32_t>()[1] == -2);
+    REQUIRE_THROWS_AS(a.checked_data<float>(), std::runtime_error);
+    REQUIRE_THROWS_AS(a.checked_data<uint32_t>(), std::runtime_error);
+
+    // same word size, different kind
+    std::vector<float> floats = {1.5f, 2.5f, 3.5f};
+    cnpy::npy_save(filename, floats.data(), {floats.size()}, "w");
+    cnpy::NpyArray b = cnpy::npy_load(filename, true);
+    REQUIRE(b.dtype == cnpy::DType::of<float>());
+    REQUIRE(b.checked_data<float>()[2] == 3.5f);
+    REQUIRE_THROWS_AS(b.checked_data<int32_t>(), std::runtime_error);
+
+    // appending requires the same dtype
+    REQUIRE_THROWS_AS(cnpy::npy_save(filename, ints.data(), {ints.size()}, "a"), std::runtime_error);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npz entries and untyped saves keep their dtype", "[cnpy][dtype]") {
+    const std::string filename = "test_dtype.npz";
+    std::vector<uint8_t> bytes = {0, 1, 255};
+    bool flag_data[3] = {true, false, true};
+    cnpy::npz_save(filename, "bytes", bytes.data(), {bytes.size()}, "w");
+    cnpy::npz_save(filename, "flags", flag_data, {3}, "a", true);
+    std::vector<int16_t> raw = {-7, 8};
+    cnpy::npz_save(filename, "raw", static_cast<const void*>(raw.data()), {raw.size()}, cnpy::DType('i', 2), "a");
+
+    cnpy::npz_t npz = cnpy::npz_load(filename);
+    REQUIRE(npz["bytes"].dtype == cnpy::DType::of<uint8_t>());
+    REQUIRE(npz["flags"].dtype.kind == 'b');
+    REQUIRE(npz["flags"].checked_data<bool>()[2]);
+    REQUIRE(npz["raw"].checked_data<int16_t>()[0] == -7);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("0-d arrays round trip", "[cnpy][dtype]") {
+    const std::string filename = "test_dtype_scalar.npy";
+    double value = 42.0;
+    cnpy::npy_save(filename, &value, cnpy::Shape(), "w");
+    cnpy::NpyArray a = cnpy::npy_load(filename);
+    REQUIRE(a.shape.empty());
+    REQUIRE(a.num_vals == 1);
+    REQUIRE(a.checked_data<double>()[0] == 42.0);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("new_npz_mmap accepts every mapped type", "[cnpy][dtype]") {
+    const std::string filename = "test_dtype_mmap.npz";
+    std::vector<cnpy::ShapeAndType> shapes = {
+        cnpy::ShapeAndType({4}, typeid(bool), "mask"),
+        cnpy::ShapeAndType({2, 2}, typeid(std::complex<double>), "z"),
+        cnpy::ShapeAndType({3}, typeid(signed char), "small"),
+    };
+    cnpy::npz_t npz = cnpy::new_npz_mmap(filename, shapes, false);
+    REQUIRE(npz["mask"].dtype == cnpy::DType::of<bool>());
+    REQUIRE(npz["z"].dtype == cnpy::DType('c', 16));
+    REQUIRE(npz["small"].dtype == cnpy::DType('i', 1));
+    npz["z"].checked_data<std::complex<double>>()[3] = std::complex<double>(1, 2);
+    npz.clear();
+    REQUIRE(cnpy::npz_load(filename, "z").data<std::complex<double>>()[3] == std::complex<double>(1, 2));
+
+    struct Unmapped {};
+    std::vector<cnpy::ShapeAndType> bad = {cnpy::ShapeAndType({1}, typeid(Unmapped), "x")};
+    REQUIRE_THROWS_AS(cnpy::new_npz_mmap(filename, bad, false), std::runtime_error);
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,64 @@
+// test_gather_write.cpp
+#include "cnpy.h"
+#include "npy_view.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST_CASE("segments are saved as one array", "[cnpy][segments]") {
+    const std::string filename = "test_gather_write.npy";
+    // more segments than one writev call takes
+    std::vector<int64_t> data(5000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int64_t>(i) * 7;
+    std::vector<cnpy::Segment> segments;
+    for (size_t i = 0; i < data.size(); i += 2) segments.push_back(cnpy::Segment(&data[i], 2 * sizeof(int64_t)));
+    cnpy::npy_save(filename, segments, {1000, 5}, cnpy::DType::of<int64_t>());
+    REQUIRE(cnpy::npy_load(filename).as_vec<int64_t>() == data);
+
+    cnpy::npy_save(filename, segments, {1000, 5}, cnpy::DType::of<int64_t>(), "a");
+    cnpy::NpyArray twice = cnpy::npy_load(filename);
+    REQUIRE(twice.shape == cnpy::Shape({2000, 5}));
+    REQUIRE(twice.data<int64_t>()[9999] == data.back());
+
+    // big-endian output swaps elements even when segments split them
+    std::vector<cnpy::Segment> ragged = {cnpy::Segment(data.data(), 3), cnpy::Segment(
+                                                                           reinterpret_cast<char*>(data.data()) + 3,
+                                                                           data.size() * 8 - 3)};
+    cnpy::npy_save(filename, ragged, {data.size()}, cnpy::DType('i', 8, '>'));
+    REQUIRE(cnpy::npy_load(filename).as_vec<int64_t>() == data);
+
+    REQUIRE_THROWS(cnpy::npy_save(filename, segments, {4999}, cnpy::DType::of<int64_t>()));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("views of non-contiguous data save without a staging copy", "[cnpy][segments]") {
+    const std::string filename = "test_gather_write.npz";
+    std::vector<float> grid(200 * 30);
+    for (size_t i = 0; i < grid.size(); ++i) grid[i] = i * 0.25f;
+    cnpy::NpyView<const float, 2> v(grid.data(), {{200, 30}}, {{30, 1}});
+    cnpy::NpyView<const float, 2> cols = v.slice(1, cnpy::Slice(10, 14));
+    REQUIRE(cnpy::segments_of(cols).size() == 200);
+    REQUIRE(cnpy::segments_of(v.slice(0, cnpy::Slice(5, 9))).size() == 1);
+
+    cnpy::npz_save(filename, "cols", cols, "w");
+    cnpy::npz_save(filename, "deflated", cols, "a", true);
+    cnpy::npz_save(filename, "transposed", v.transpose(), "a", true);
+
+    cnpy::npz_t npz = cnpy::npz_load(filename);
+    for (const char* name : {"cols", "deflated"}) {
+        cnpy::NpyArray arr = npz[name];
+        REQUIRE(arr.shape == cnpy::Shape({200, 4}));
+        cnpy::NpyView<float, 2> back(arr);
+        for (size_t i = 0; i < 200; ++i)
+            for (size_t j = 0; j < 4; ++j) REQUIRE(back(i, j) == cols(i, j));
+    }
+    cnpy::NpyView<float, 2> t(npz["transposed"]);
+    REQUIRE(t.shape(0) == 30);
+    REQUIRE(t(7, 123) == v(123, 7));
+
+    // the streamed deflate output also works with ranged reads
+    REQUIRE(cnpy::npz_load_rows(filename, "deflated", 199, 200).data<float>()[3] == v(199, 13));
+    std::remove(filename.c_str());
+}
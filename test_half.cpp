@@ -0,0 +1,130 @@
+// test_half.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    uint32_t bits_of(float f) {
+        uint32_t x;
+        memcpy(&x, &f, 4);
+        return x;
+    }
+
+    float float_of(uint32_t x) {
+        float f;
+        memcpy(&f, &x, 4);
+        return f;
+    }
+} // namespace
+
+TEST_CASE("float16 conversion rounds like IEEE 754", "[cnpy][half]") {
+    REQUIRE(cnpy::to_float16(1.0f).bits == 0x3c00);
+    REQUIRE(cnpy::to_float16(-2.0f).bits == 0xc000);
+    REQUIRE(cnpy::to_float16(0.1f).bits == 0x2e66);
+    REQUIRE(cnpy::to_float16(65504.0f).bits == 0x7bff);
+    REQUIRE(cnpy::to_float16(65519.0f).bits == 0x7bff);
+    REQUIRE(cnpy::to_float16(65520.0f).bits == 0x7c00);
+    REQUIRE(cnpy::to_float16(std::ldexp(1.0f, -24)).bits == 0x0001);
+    REQUIRE(cnpy::to_float16(std::ldexp(1.0f, -25)).bits == 0x0000);
+    REQUIRE(cnpy::to_float16(std::ldexp(3.0f, -26)).bits == 0x0001);
+    REQUIRE((cnpy::to_float16(std::numeric_limits<float>::quiet_NaN()).bits & 0x7c00) == 0x7c00);
+    REQUIRE((cnpy::to_float16(std::numeric_limits<float>::quiet_NaN()).bits & 0x03ff) != 0);
+    REQUIRE(cnpy::to_float(cnpy::float16{0x0001}) == std::ldexp(1.0f, -24));
+    REQUIRE(cnpy::to_float(cnpy::float16{0xfc00}) == -std::numeric_limits<float>::infinity());
+
+    // every half value survives a round trip through float32, in the vector and scalar paths alike
+    std::vector<cnpy::float16> all(1 << 16);
+    for (size_t i = 0; i < all.size(); ++i) all[i].bits = static_cast<uint16_t>(i);
+    std::vector<float> wide(all.size());
+    cnpy::to_float(all.data(), wide.data(), all.size());
+    std::vector<cnpy::float16> back(all.size());
+    cnpy::to_float16(wide.data(), back.data(), wide.size());
+    for (size_t i = 0; i < all.size(); ++i) {
+        if (std::isnan(wide[i])) continue;
+        REQUIRE(back[i].bits == all[i].bits);
+        REQUIRE(bits_of(cnpy::to_float(all[i])) == bits_of(wide[i]));
+    }
+
+    // values between representable halves
+    std::vector<float> probe;
+    for (uint32_t x = 0x33000000; x < 0x47800000; x += 0x1357) probe.push_back(float_of(x));
+    std::vector<cnpy::float16> narrow(probe.size());
+    cnpy::to_float16(probe.data(), narrow.data(), probe.size());
+    for (size_t i = 0; i < probe.size(); ++i) REQUIRE(narrow[i].bits == cnpy::to_float16(probe[i]).bits);
+}
+
+TEST_CASE("bfloat16 conversion", "[cnpy][half]") {
+    REQUIRE(cnpy::to_bfloat16(1.0f).bits == 0x3f80);
+    REQUIRE(cnpy::to_bfloat16(float_of(0x3f808000)).bits == 0x3f80); // tie, even
+    REQUIRE(cnpy::to_bfloat16(float_of(0x3f818000)).bits == 0x3f82); // tie, odd
+    REQUIRE(cnpy::to_bfloat16(float_of(0x3f808001)).bits == 0x3f81);
+    REQUIRE(std::isnan(cnpy::to_float(cnpy::to_bfloat16(float_of(0x7f800001)))));
+    REQUIRE(cnpy::to_float(cnpy::bfloat16{0xc040}) == -3.0f);
+
+    std::vector<cnpy::bfloat16> all(1 << 16);
+    for (size_t i = 0; i < all.size(); ++i) all[i].bits = static_cast<uint16_t>(i);
+    std::vector<float> wide(all.size());
+    cnpy::to_float(all.data(), wide.data(), all.size());
+    std::vector<cnpy::bfloat16> back(all.size());
+    cnpy::to_bfloat16(wide.data(), back.data(), wide.size());
+    for (size_t i = 0; i < all.size(); ++i) {
+        REQUIRE(bits_of(wide[i]) == static_cast<uint32_t>(i) << 16);
+        if (!std::isnan(wide[i])) REQUIRE(back[i].bits == all[i].bits);
+    }
+}
+
+TEST_CASE("float16 arrays save as <f2 and widen on load", "[cnpy][half]") {
+    const std::string filename = "test_half.npy";
+    std::vector<float> weights(1000);
+    for (size_t i = 0; i < weights.size(); ++i) weights[i] = std::sin(i * 0.01f) * 100.0f;
+    std::vector<cnpy::float16> compact(weights.size());
+    cnpy::to_float16(weights.data(), compact.data(), weights.size());
+    cnpy::npy_save(filename, compact.data(), {10, 100}, "w");
+
+    cnpy::NpyArray stored = cnpy::npy_load(filename);
+    REQUIRE(stored.dtype.str() == "<f2");
+    REQUIRE(stored.checked_data<cnpy::float16>()[5].bits == compact[5].bits);
+
+    cnpy::NpyArray f32 = cnpy::npy_load_as<float>(filename);
+    cnpy::NpyArray f64 = cnpy::npy_load_as<double>(filename);
+    for (size_t i = 0; i < weights.size(); ++i) {
+        REQUIRE(f32.data<float>()[i] == cnpy::to_float(compact[i]));
+        REQUIRE(f64.data<double>()[i] == cnpy::to_float(compact[i]));
+    }
+    REQUIRE(cnpy::npy_load_as<int16_t>(filename).data<int16_t>()[157] ==
+            static_cast<int16_t>(cnpy::to_float(compact[157])));
+
+    // narrowing on load is range checked
+    std::vector<double> doubles(weights.begin(), weights.end());
+    cnpy::npy_save(filename, doubles.data(), {doubles.size()}, "w");
+    REQUIRE(cnpy::npy_load_as<cnpy::float16>(filename).data<cnpy::float16>()[999].bits == compact[999].bits);
+    doubles[3] = 1e5;
+    cnpy::npy_save(filename, doubles.data(), {doubles.size()}, "w");
+    REQUIRE_THROWS_AS(cnpy::npy_load_as<cnpy::float16>(filename), std::range_error);
+
+    // finite values short of 65520 round to the largest half, 65504; 65520 itself rounds to infinity
+    std::vector<float> edge = {65519.0f, -65519.0f, 65504.0f};
+    cnpy::npy_save(filename, edge.data(), {edge.size()}, "w");
+    cnpy::NpyArray rounded = cnpy::npy_load_as<cnpy::float16>(filename);
+    REQUIRE(rounded.data<cnpy::float16>()[0].bits == 0x7bff);
+    REQUIRE(rounded.data<cnpy::float16>()[1].bits == 0xfbff);
+    REQUIRE(rounded.data<cnpy::float16>()[2].bits == 0x7bff);
+    edge[0] = 65520.0f;
+    cnpy::npy_save(filename, edge.data(), {edge.size()}, "w");
+    REQUIRE_THROWS_AS(cnpy::npy_load_as<cnpy::float16>(filename), std::range_error);
+
+    std::vector<cnpy::bfloat16> brain(weights.size());
+    cnpy::to_bfloat16(weights.data(), brain.data(), weights.size());
+    cnpy::npy_save(filename, brain.data(), {brain.size()}, "w");
+    cnpy::NpyArray b = cnpy::npy_load(filename);
+    REQUIRE(b.dtype.str() == "<V2");
+    REQUIRE(b.checked_data<cnpy::bfloat16>()[10].bits == brain[10].bits);
+    std::remove(filename.c_str());
+}
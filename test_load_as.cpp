@@ -0,0 +1,69 @@
+// test_load_as.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("npy_load_as converts float64 to float32 and back", "[cnpy][load_as]") {
+    const std::string filename = "test_load_as_f8.npy";
+    std::vector<double> data(5003);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i * 0.1 - 200.0;
+    cnpy::npy_save(filename, data.data(), {data.size()}, "w");
+
+    cnpy::NpyArray arr = cnpy::npy_load_as<float>(filename);
+    REQUIRE(arr.word_size == sizeof(float));
+    REQUIRE(arr.shape == std::vector<size_t>{data.size()});
+    const float* f = arr.data<float>();
+    for (size_t i = 0; i < data.size(); ++i) REQUIRE(f[i] == static_cast<float>(data[i]));
+
+    std::vector<float> narrow(f, f + data.size());
+    cnpy::npy_save(filename, narrow.data(), {narrow.size()}, "w");
+    cnpy::NpyArray wide = cnpy::npy_load_as<double>(filename);
+    for (size_t i = 0; i < narrow.size(); ++i) REQUIRE(wide.data<double>()[i] == static_cast<double>(narrow[i]));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npy_load_as range checks narrowing conversions", "[cnpy][load_as]") {
+    const std::string filename = "test_load_as_range.npy";
+    std::vector<int64_t> ok = {-5, 0, 7, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min()};
+    cnpy::npy_save(filename, ok.data(), {ok.size()}, "w");
+    std::vector<int32_t> expected(ok.begin(), ok.end());
+    REQUIRE(cnpy::npy_load_as<int32_t>(filename).as_vec<int32_t>() == expected);
+    REQUIRE_THROWS_AS(cnpy::npy_load_as<uint32_t>(filename), std::range_error);
+
+    std::vector<int64_t> big = {1, int64_t(1) << 40};
+    cnpy::npy_save(filename, big.data(), {big.size()}, "w");
+    REQUIRE_THROWS_AS(cnpy::npy_load_as<int32_t>(filename), std::range_error);
+    REQUIRE(cnpy::npy_load_as<double>(filename).as_vec<double>() == std::vector<double>{1.0, 1099511627776.0});
+
+    std::vector<double> huge = {1.0, 1e300, std::numeric_limits<double>::infinity()};
+    cnpy::npy_save(filename, huge.data(), {huge.size()}, "w");
+    REQUIRE_THROWS_AS(cnpy::npy_load_as<float>(filename), std::range_error);
+
+    std::vector<double> fractional = {-1.5, 2.75, 255.9};
+    cnpy::npy_save(filename, fractional.data(), {fractional.size()}, "w");
+    REQUIRE(cnpy::npy_load_as<int16_t>(filename).as_vec<int16_t>() == std::vector<int16_t>{-1, 2, 255});
+    REQUIRE_THROWS_AS(cnpy::npy_load_as<uint8_t>(filename), std::range_error);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npz_load_as converts stored and compressed entries", "[cnpy][npz][load_as]") {
+    const std::string filename = "test_load_as.npz";
+    std::vector<int32_t> data(2000000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int32_t>(i) - 1000000;
+    for (bool compress : {false, true}) {
+        cnpy::npz_save(filename, "x", data.data(), {1000, 2000}, "w", compress);
+        cnpy::NpyArray arr = cnpy::npz_load_as<double>(filename, "x");
+        REQUIRE(arr.shape == std::vector<size_t>{1000, 2000});
+        const double* p = arr.data<double>();
+        bool same = true;
+        for (size_t i = 0; i < data.size(); ++i) same &= p[i] == data[i];
+        REQUIRE(same);
+        REQUIRE_THROWS_AS(cnpy::npz_load_as<int16_t>(filename, "x"), std::range_error);
+    }
+    std::remove(filename.c_str());
+}
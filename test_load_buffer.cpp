@@ -0,0 +1,75 @@
+// test_load_buffer.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+static std::vector<char> read_file(const std::string& fname) {
+    std::ifstream in(fname, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static bool points_into(const cnpy::NpyArray& arr, const std::vector<char>& buf) {
+    const char* p = arr.data<char>();
+    return p >= buf.data() && p + arr.num_bytes() <= buf.data() + buf.size();
+}
+
+TEST_CASE("npy_load_buffer returns a view of the buffer", "[load_buffer]") {
+    std::vector<double> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i * 0.5;
+    cnpy::npy_save("test_load_buffer.npy", data.data(), {10, 100});
+    std::vector<char> buf = read_file("test_load_buffer.npy");
+    std::remove("test_load_buffer.npy");
+
+    cnpy::NpyArray arr = cnpy::npy_load_buffer(buf.data(), buf.size());
+    REQUIRE(arr.shape == cnpy::Shape({10, 100}));
+    REQUIRE(points_into(arr, buf));
+    REQUIRE(arr.as_vec<double>() == data);
+
+    REQUIRE_THROWS_AS(cnpy::npy_load_buffer(buf.data(), buf.size() - 1), std::runtime_error);
+    REQUIRE_THROWS_AS(cnpy::npy_load_buffer(buf.data(), 8), std::runtime_error);
+}
+
+TEST_CASE("the owner keeps the buffer alive", "[load_buffer]") {
+    std::vector<int> data = {1, 2, 3, 4, 5};
+    cnpy::npy_save("test_load_buffer.npy", data);
+    std::shared_ptr<std::vector<char>> buf = std::make_shared<std::vector<char>>(read_file("test_load_buffer.npy"));
+    std::remove("test_load_buffer.npy");
+
+    cnpy::NpyArray arr = cnpy::npy_load_buffer(buf->data(), buf->size(), buf);
+    std::weak_ptr<std::vector<char>> alive = buf;
+    buf.reset();
+    REQUIRE_FALSE(alive.expired());
+    REQUIRE(arr.as_vec<int>() == data);
+    arr = cnpy::NpyArray();
+    REQUIRE(alive.expired());
+}
+
+TEST_CASE("npz_load_buffer views stored entries and inflates deflated ones", "[load_buffer]") {
+    std::vector<float> a(4096);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = static_cast<float>(i);
+    std::vector<int> b(300, 7);
+    for (bool compress : {false, true}) {
+        std::remove("test_load_buffer.npz");
+        cnpy::npz_save("test_load_buffer.npz", "a", a.data(), {64, 64}, "w", compress);
+        cnpy::npz_save("test_load_buffer.npz", "b", b, "a", compress);
+        std::vector<char> buf = read_file("test_load_buffer.npz");
+        std::remove("test_load_buffer.npz");
+
+        cnpy::npz_t arrays = cnpy::npz_load_buffer(buf.data(), buf.size());
+        REQUIRE(arrays.size() == 2);
+        REQUIRE(arrays["a"].shape == cnpy::Shape({64, 64}));
+        REQUIRE(arrays["a"].as_vec<float>() == a);
+        REQUIRE(arrays["b"].as_vec<int>() == b);
+        REQUIRE(points_into(arrays["a"], buf) == !compress);
+
+        cnpy::NpyArray one = cnpy::npz_load_buffer(buf.data(), buf.size(), "b");
+        REQUIRE(one.as_vec<int>() == b);
+        REQUIRE_THROWS_AS(cnpy::npz_load_buffer(buf.data(), buf.size(), "c"), std::runtime_error);
+        REQUIRE_THROWS_AS(cnpy::npz_load_buffer(buf.data(), buf.size() / 2), std::runtime_error);
+    }
+}
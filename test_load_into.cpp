@@ -0,0 +1,71 @@
+// test_load_into.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("npy_load_into reads directly into the caller's buffer", "[cnpy][load_into]") {
+    const std::string filename = "test_load_into.npy";
+    std::vector<size_t> shape = {3, 4};
+    std::vector<double> data(12);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i * 0.5;
+    cnpy::npy_save(filename, data.data(), shape, "w");
+
+    std::vector<double> dst(12, -1.0);
+    cnpy::NpyArray arr = cnpy::npy_load_into(filename, dst.data(), dst.size() * sizeof(double));
+    REQUIRE(arr.shape == shape);
+    REQUIRE(arr.word_size == sizeof(double));
+    REQUIRE(arr.data<double>() == dst.data());
+    REQUIRE(!arr.data_holder);
+    REQUIRE(dst == data);
+
+    std::vector<double> typed(12);
+    cnpy::npy_load_into(filename, typed.data(), shape);
+    REQUIRE(typed == data);
+
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npy_load_into rejects mismatched headers before writing", "[cnpy][load_into]") {
+    const std::string filename = "test_load_into_mismatch.npy";
+    std::vector<int> data = {1, 2, 3, 4, 5, 6};
+    cnpy::npy_save(filename, data.data(), {2, 3}, "w");
+
+    std::vector<int> dst(6, 42);
+    REQUIRE_THROWS_AS(cnpy::npy_load_into(filename, dst.data(), 5 * sizeof(int)), std::runtime_error);
+    REQUIRE_THROWS_AS(cnpy::npy_load_into(filename, dst.data(), {3, 2}), std::runtime_error);
+    std::vector<double> wrong(6);
+    REQUIRE_THROWS_AS(cnpy::npy_load_into(filename, wrong.data(), {2, 3}), std::runtime_error);
+    for (int v : dst) REQUIRE(v == 42);
+
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npz_load_into handles stored and compressed entries", "[cnpy][npz][load_into]") {
+    const std::string filename = "test_load_into.npz";
+    std::vector<float> a(1000);
+    std::vector<int> b(300000);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = static_cast<float>(i) * 1.5f;
+    for (size_t i = 0; i < b.size(); ++i) b[i] = static_cast<int>(i % 97);
+
+    for (bool compress : {false, true}) {
+        cnpy::npz_save(filename, "a", a.data(), {10, 100}, "w", compress);
+        cnpy::npz_save(filename, "b", b.data(), {b.size()}, "a", compress);
+
+        std::vector<int> dst_b(b.size());
+        cnpy::NpyArray arr_b = cnpy::npz_load_into(filename, "b", dst_b.data(), dst_b.size() * sizeof(int));
+        REQUIRE(arr_b.shape == std::vector<size_t>{b.size()});
+        REQUIRE(dst_b == b);
+
+        std::vector<float> dst_a(a.size());
+        cnpy::npz_load_into(filename, "a", dst_a.data(), {10, 100});
+        REQUIRE(dst_a == a);
+
+        REQUIRE_THROWS_AS(cnpy::npz_load_into(filename, "missing", dst_a.data(), dst_a.size() * sizeof(float)),
+                          std::runtime_error);
+    }
+
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,56 @@
+// test_load_many.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("npy_load_many returns the files in order", "[cnpy][load_many]") {
+    std::vector<std::string> paths;
+    for (size_t f = 0; f < 50; ++f) {
+        // a few large files among many small ones, so that the threads have to steal
+        std::vector<int64_t> data(f % 10 == 0 ? 200000 : 10 + f);
+        for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int64_t>(f * 1000000 + i);
+        paths.push_back("test_load_many_" + std::to_string(f) + ".npy");
+        cnpy::npy_save(paths.back(), data);
+    }
+
+    for (unsigned threads : {1u, 3u, 0u, 64u}) {
+        cnpy::LoadManyOptions options;
+        options.threads = threads;
+        options.use_mmap = threads == 3;
+        std::vector<cnpy::LoadResult> results = cnpy::npy_load_many(paths, options);
+        REQUIRE(results.size() == paths.size());
+        for (size_t f = 0; f < paths.size(); ++f) {
+            REQUIRE(results[f].ok());
+            REQUIRE(results[f].array.num_vals == (f % 10 == 0 ? 200000 : 10 + f));
+            REQUIRE(results[f].array.data<int64_t>()[5] == static_cast<int64_t>(f * 1000000 + 5));
+        }
+    }
+    for (const std::string& path : paths) std::remove(path.c_str());
+    REQUIRE(cnpy::npy_load_many(std::vector<std::string>()).empty());
+}
+
+TEST_CASE("npy_load_many reports failures per file", "[cnpy][load_many]") {
+    std::vector<double> data = {1.5, 2.5};
+    cnpy::npy_save("test_load_many_good.npy", data);
+    std::ofstream("test_load_many_bad.npy") << "not an npy file";
+
+    std::vector<std::string> paths = {"test_load_many_good.npy", "test_load_many_missing.npy",
+                                      "test_load_many_bad.npy", "test_load_many_good.npy"};
+    cnpy::LoadManyOptions options;
+    options.threads = 2;
+    std::vector<cnpy::LoadResult> results = cnpy::npy_load_many(paths, options);
+    REQUIRE(results[0].ok());
+    REQUIRE(results[0].array.as_vec<double>() == data);
+    REQUIRE_FALSE(results[1].ok());
+    REQUIRE(results[1].message.find("test_load_many_missing.npy") != std::string::npos);
+    REQUIRE_FALSE(results[2].ok());
+    REQUIRE_FALSE(results[2].message.empty());
+    REQUIRE_THROWS(std::rethrow_exception(results[2].error));
+    REQUIRE(results[3].ok());
+    std::remove("test_load_many_good.npy");
+    std::remove("test_load_many_bad.npy");
+}
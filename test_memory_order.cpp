@@ -0,0 +1,138 @@
+// test_memory_order.cpp
+#include "cnpy.h"
+#include "npy_kernels.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// save data (laid out in the given order) with a header recording that order
+template <typename T>
+static void save_with_order(const std::string& filename, const std::vector<T>& data, const std::vector<size_t>& shape,
+                            bool fortran_order) {
+    std::vector<char> header = cnpy::create_npy_header<T>(shape);
+    if (fortran_order) {
+        std::string s(header.begin(), header.end());
+        s.replace(s.find("False"), 5, "True ");
+        header.assign(s.begin(), s.end());
+    }
+    FILE* fp = std::fopen(filename.c_str(), "wb");
+    std::fwrite(header.data(), 1, header.size(), fp);
+    std::fwrite(data.data(), sizeof(T), data.size(), fp);
+    std::fclose(fp);
+}
+
+// element (i, j, k) of a 3-d array in either layout
+static size_t offset3(const std::vector<size_t>& shape, size_t i, size_t j, size_t k, bool fortran_order) {
+    return fortran_order ? i + shape[0] * (j + shape[1] * k) : (i * shape[1] + j) * shape[2] + k;
+}
+
+template <typename T> static void check_round_trip(const std::vector<size_t>& shape) {
+    const std::string filename = "test_memory_order.npy";
+    std::vector<T> f_data(shape[0] * shape[1] * shape[2]), c_data(f_data.size());
+    for (size_t i = 0; i < shape[0]; ++i)
+        for (size_t j = 0; j < shape[1]; ++j)
+            for (size_t k = 0; k < shape[2]; ++k) {
+                T v = static_cast<T>((i * 131 + j * 17 + k) % 251);
+                f_data[offset3(shape, i, j, k, true)] = v;
+                c_data[offset3(shape, i, j, k, false)] = v;
+            }
+
+    save_with_order(filename, f_data, shape, true);
+    cnpy::NpyArray as_c = cnpy::npy_load(filename, cnpy::MemoryOrder::C);
+    REQUIRE(as_c.fortran_order == false);
+    REQUIRE(as_c.shape == shape);
+    REQUIRE(as_c.as_vec<T>() == c_data);
+    REQUIRE(cnpy::npy_load(filename, cnpy::MemoryOrder::AsStored).as_vec<T>() == f_data);
+
+    // LoadOptions combines the order with the other options
+    cnpy::LoadOptions options;
+    options.order = cnpy::MemoryOrder::C;
+    options.cache = cnpy::CachePolicy::Stream;
+    cnpy::NpyArray streamed = cnpy::npy_load(filename, options);
+    REQUIRE(streamed.fortran_order == false);
+    REQUIRE(streamed.as_vec<T>() == c_data);
+    options.mmap = true;
+    cnpy::NpyArray mapped = cnpy::npy_load(filename, options);
+    REQUIRE(mapped.fortran_order == true);
+    REQUIRE(mapped.as_vec<T>() == f_data);
+
+    save_with_order(filename, c_data, shape, false);
+    cnpy::NpyArray as_f = cnpy::npy_load(filename, cnpy::MemoryOrder::Fortran);
+    REQUIRE(as_f.fortran_order == true);
+    REQUIRE(as_f.as_vec<T>() == f_data);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npy_load converts between Fortran and C order", "[cnpy][order]") {
+    check_round_trip<double>({3, 4, 5});
+    check_round_trip<float>({67, 5, 130});
+    check_round_trip<short>({1, 70, 9});
+    check_round_trip<unsigned char>({65, 2, 65});
+}
+
+TEST_CASE("npy_load transposes large 2-d arrays in chunks", "[cnpy][order]") {
+    const std::string filename = "test_memory_order_big.npy";
+    const size_t rows = 1500, cols = 1100; // > 8 MB of doubles, so several chunks
+    std::vector<double> f_data(rows * cols);
+    for (size_t j = 0; j < cols; ++j)
+        for (size_t i = 0; i < rows; ++i) f_data[i + rows * j] = i * 10000.0 + j;
+    save_with_order(filename, f_data, {rows, cols}, true);
+
+    cnpy::NpyArray arr = cnpy::npy_load(filename, cnpy::MemoryOrder::C);
+    const double* p = arr.data<double>();
+    bool ok = true;
+    for (size_t i = 0; i < rows && ok; ++i)
+        for (size_t j = 0; j < cols; ++j)
+            if (p[i * cols + j] != i * 10000.0 + j) ok = false;
+    REQUIRE(ok);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npz_load returns the requested order for stored and compressed entries", "[cnpy][npz][order]") {
+    const std::string npy = "test_memory_order_src.npy";
+    const std::string npz = "test_memory_order.npz";
+    std::vector<size_t> shape = {6, 7, 8};
+    std::vector<int> f_data(6 * 7 * 8), c_data(f_data.size());
+    for (size_t i = 0; i < 6; ++i)
+        for (size_t j = 0; j < 7; ++j)
+            for (size_t k = 0; k < 8; ++k) {
+                f_data[offset3(shape, i, j, k, true)] = static_cast<int>(i * 100 + j * 10 + k);
+                c_data[offset3(shape, i, j, k, false)] = static_cast<int>(i * 100 + j * 10 + k);
+            }
+
+    for (bool compress : {false, true}) {
+        cnpy::npz_save(npz, "c", c_data.data(), shape, "w", compress);
+        cnpy::npz_save(npz, "vec", c_data.data(), {c_data.size()}, "a", compress);
+
+        cnpy::NpyArray f = cnpy::npz_load(npz, "c", cnpy::MemoryOrder::Fortran);
+        REQUIRE(f.fortran_order == true);
+        REQUIRE(f.as_vec<int>() == f_data);
+
+        cnpy::LoadOptions options;
+        options.order = cnpy::MemoryOrder::Fortran;
+        options.cache = cnpy::CachePolicy::Stream;
+        REQUIRE(cnpy::npz_load(npz, "c", options).as_vec<int>() == f_data);
+        REQUIRE(cnpy::npz_load(npz, options)["c"].as_vec<int>() == f_data);
+
+        cnpy::npz_t all = cnpy::npz_load(npz, cnpy::MemoryOrder::Fortran);
+        REQUIRE(all["c"].as_vec<int>() == f_data);
+        REQUIRE(all["vec"].fortran_order == true);
+        REQUIRE(all["vec"].as_vec<int>() == c_data);
+    }
+    std::remove(npy.c_str());
+    std::remove(npz.c_str());
+}
+
+TEST_CASE("reverse_axes gives the same result on several threads", "[cnpy][order]") {
+    std::vector<size_t> shape = {300, 7, 900};
+    std::vector<float> src(300 * 7 * 900);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<float>(i);
+    std::vector<float> one(src.size()), many(src.size());
+    const char* s = reinterpret_cast<const char*>(src.data());
+    cnpy::kernels::reverse_axes(s, reinterpret_cast<char*>(one.data()), shape, 0, 300, sizeof(float), 1);
+    cnpy::kernels::reverse_axes(s, reinterpret_cast<char*>(many.data()), shape, 0, 300, sizeof(float), 4);
+    REQUIRE(one == many);
+    // element (i, j, k) of the source lands at (k, j, i) of the reversed array
+    REQUIRE(one[(899 * 7 + 3) * 300 + 5] == src[(5 * 7 + 3) * 900 + 899]);
+}
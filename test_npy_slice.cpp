@@ -0,0 +1,76 @@
+// test_npy_slice.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// write a .npy with the given memory order whose element at multi-index (i, j, k) holds 100 * i + 10 * j + k
+static void write_indexed(const std::string& filename, const std::vector<size_t>& shape, bool fortran_order) {
+    std::vector<int> data(shape[0] * shape[1] * shape[2]);
+    for (size_t i = 0; i < shape[0]; ++i)
+        for (size_t j = 0; j < shape[1]; ++j)
+            for (size_t k = 0; k < shape[2]; ++k) {
+                size_t pos = fortran_order ? i + shape[0] * (j + shape[1] * k) : (i * shape[1] + j) * shape[2] + k;
+                data[pos] = static_cast<int>(100 * i + 10 * j + k);
+            }
+    std::vector<char> header = cnpy::create_npy_header<int>(shape);
+    if (fortran_order) {
+        std::string s(header.begin(), header.end());
+        s.replace(s.find("False"), 5, "True ");
+        header.assign(s.begin(), s.end());
+    }
+    FILE* fp = std::fopen(filename.c_str(), "wb");
+    std::fwrite(header.data(), 1, header.size(), fp);
+    std::fwrite(data.data(), sizeof(int), data.size(), fp);
+    std::fclose(fp);
+}
+
+static void check_slice(const std::string& filename, bool fortran_order, const std::vector<cnpy::Slice>& sel,
+                        const std::vector<size_t>& expected_shape) {
+    cnpy::NpyArray arr = cnpy::npy_load_slice(filename, sel);
+    REQUIRE(arr.shape == expected_shape);
+    REQUIRE(arr.fortran_order == fortran_order);
+    const int* p = arr.data<int>();
+    for (size_t i = 0; i < expected_shape[0]; ++i)
+        for (size_t j = 0; j < expected_shape[1]; ++j)
+            for (size_t k = 0; k < expected_shape[2]; ++k) {
+                size_t pos = fortran_order ? i + expected_shape[0] * (j + expected_shape[1] * k)
+                                           : (i * expected_shape[1] + j) * expected_shape[2] + k;
+                size_t si = (sel.size() > 0 ? sel[0].start : 0) + i * (sel.size() > 0 ? sel[0].step : 1);
+                size_t sj = (sel.size() > 1 ? sel[1].start : 0) + j * (sel.size() > 1 ? sel[1].step : 1);
+                size_t sk = (sel.size() > 2 ? sel[2].start : 0) + k * (sel.size() > 2 ? sel[2].step : 1);
+                REQUIRE(p[pos] == static_cast<int>(100 * si + 10 * sj + sk));
+            }
+}
+
+TEST_CASE("npy_load_slice reads row ranges and strided hyperslabs", "[cnpy][slice]") {
+    const std::string filename = "test_npy_slice.npy";
+    std::vector<size_t> shape = {7, 5, 6};
+    for (bool fortran_order : {false, true}) {
+        write_indexed(filename, shape, fortran_order);
+        check_slice(filename, fortran_order, {cnpy::Slice(2, 5)}, {3, 5, 6});
+        check_slice(filename, fortran_order, {cnpy::Slice(1, 7, 3), cnpy::Slice(0, 5, 2)}, {2, 3, 6});
+        check_slice(filename, fortran_order, {cnpy::Slice::all(), cnpy::Slice(1, 4), cnpy::Slice(5, 100)}, {7, 3, 1});
+        check_slice(filename, fortran_order, {cnpy::Slice(0, 7, 2), cnpy::Slice::all(), cnpy::Slice(1, 6, 2)},
+                    {4, 5, 3});
+        check_slice(filename, fortran_order, {}, {7, 5, 6});
+    }
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npy_load_slice handles empty selections and rejects bad ones", "[cnpy][slice]") {
+    const std::string filename = "test_npy_slice_edge.npy";
+    write_indexed(filename, {4, 3, 2}, false);
+
+    cnpy::NpyArray empty = cnpy::npy_load_slice(filename, {cnpy::Slice(3, 3)});
+    REQUIRE(empty.shape == std::vector<size_t>{0, 3, 2});
+    REQUIRE(empty.num_bytes() == 0);
+
+    REQUIRE_THROWS_AS(cnpy::npy_load_slice(filename, {cnpy::Slice(0, 1, 0)}), std::runtime_error);
+    REQUIRE_THROWS_AS(cnpy::npy_load_slice(filename, {cnpy::Slice::all(), cnpy::Slice::all(), cnpy::Slice::all(),
+                                                      cnpy::Slice::all()}),
+                      std::runtime_error);
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,108 @@
+// test_npy_view.cpp
+#include "cnpy.h"
+#include "npy_view.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("views index C and Fortran arrays by their logical shape", "[cnpy][view]") {
+    const std::string filename = "test_npy_view.npy";
+    std::vector<int32_t> data(3 * 4 * 5);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int32_t>(i);
+    cnpy::npy_save(filename, data.data(), {3, 4, 5});
+
+    for (bool use_mmap : {false, true}) {
+        cnpy::NpyArray arr = cnpy::npy_load(filename, use_mmap);
+        cnpy::NpyView<int32_t, 3> v(arr);
+        REQUIRE(v.size() == 60);
+        REQUIRE(v.is_contiguous());
+        REQUIRE(v.stride(0) == 20);
+        REQUIRE(v(2, 1, 3) == 2 * 20 + 1 * 5 + 3);
+        REQUIRE(v[1][2][4] == 34);
+        REQUIRE(v.at(0, 3, 4) == 19);
+        REQUIRE_THROWS_AS(v.at(0, 4, 0), std::out_of_range);
+        REQUIRE_THROWS((cnpy::NpyView<int32_t, 2>(arr)));
+        REQUIRE_THROWS((cnpy::NpyView<float, 3>(arr)));
+    }
+
+    // the same memory read as Fortran order has its first axis fastest
+    cnpy::NpyArray arr = cnpy::npy_load(filename);
+    arr.fortran_order = true;
+    cnpy::NpyView<const int32_t, 3> f(arr);
+    REQUIRE(f(2, 1, 3) == 2 + 1 * 3 + 3 * 12);
+    REQUIRE_FALSE(f.is_contiguous());
+    REQUIRE(f.transpose().is_contiguous());
+    REQUIRE(f.transpose()(3, 1, 2) == f(2, 1, 3));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("slice, transpose and reshape do not copy", "[cnpy][view]") {
+    std::vector<double> data(6 * 8);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i;
+    cnpy::NpyArray arr({6, 8}, cnpy::DType::of<double>(), false);
+    std::copy(data.begin(), data.end(), arr.data<double>());
+    cnpy::NpyView<double, 2> m(arr);
+
+    cnpy::NpyView<double, 2> s = m.slice({cnpy::Slice(1, 6, 2), cnpy::Slice(2, 100, 3)});
+    REQUIRE(s.shape(0) == 3);
+    REQUIRE(s.shape(1) == 2);
+    REQUIRE(&s(0, 0) == &m(1, 2));
+    REQUIRE(s(2, 1) == 5 * 8 + 5);
+    REQUIRE(m.slice(0, cnpy::Slice(7, 9)).size() == 0);
+
+    cnpy::NpyView<double, 2> t = m.transpose({1, 0});
+    REQUIRE(t.shape(0) == 8);
+    REQUIRE(&t(3, 5) == &m(5, 3));
+    REQUIRE_THROWS(m.transpose({0, 0}));
+
+    cnpy::NpyView<double, 3> r = m.reshape<3>({{2, 3, 8}});
+    REQUIRE(&r(1, 2, 7) == &m(5, 7));
+    REQUIRE(m.slice(0, cnpy::Slice(2, 4)).reshape<1>({{16}})[15] == 3 * 8 + 7);
+    REQUIRE_THROWS(s.reshape<1>({{6}}));
+    REQUIRE_THROWS(m.reshape<1>({{47}}));
+
+    // writes through a view land in the array
+    t(7, 0) = -1;
+    REQUIRE(arr.data<double>()[7] == -1);
+}
+
+TEST_CASE("run iteration merges contiguous axes", "[cnpy][view]") {
+    std::vector<float> data(4 * 5 * 6);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<float>(i);
+    cnpy::NpyView<float, 3> v(data.data(), {{4, 5, 6}}, {{30, 6, 1}});
+
+    std::vector<size_t> runs;
+    v.for_each_run([&](float*, size_t n) { runs.push_back(n); });
+    REQUIRE(runs == std::vector<size_t>{120});
+
+    // rows of a column slice are separate runs, visited in order
+    runs.clear();
+    std::vector<float> seen;
+    v.slice(2, cnpy::Slice(1, 4)).for_each_run([&](float* p, size_t n) {
+        runs.push_back(n);
+        seen.insert(seen.end(), p, p + n);
+    });
+    REQUIRE(runs.size() == 20);
+    REQUIRE(runs[0] == 3);
+    REQUIRE(seen[3] == 7.0f);
+    REQUIRE(seen.back() == 117.0f);
+
+    // a transposed view walks elements in its own C order
+    std::vector<float> order;
+    v.slice(0, cnpy::Slice(0, 1)).transpose().for_each([&](float x) { order.push_back(x); });
+    REQUIRE(order.size() == 30);
+    REQUIRE(order[1] == 6.0f);
+    REQUIRE(order[5] == 1.0f);
+
+    double sum = 0;
+    cnpy::NpyView<const float, 3> c = v;
+    c.slice(1, cnpy::Slice(0, 5, 2)).for_each([&](float x) { sum += x; });
+    float expected = 0;
+    for (size_t i = 0; i < 4; ++i)
+        for (size_t j = 0; j < 5; j += 2)
+            for (size_t k = 0; k < 6; ++k) expected += v(i, j, k);
+    REQUIRE(sum == expected);
+}
@@ -0,0 +1,70 @@
+// test_npz_ranged.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static std::vector<double> make_rows(size_t rows, size_t cols) {
+    std::vector<double> data(rows * cols);
+    unsigned state = 12345;
+    for (size_t i = 0; i < data.size(); ++i) {
+        // mix a little noise into a ramp so deflate emits many blocks
+        state = state * 1103515245u + 12345u;
+        data[i] = static_cast<double>(i / cols) + ((state >> 16) % 4) * 0.25;
+    }
+    return data;
+}
+
+TEST_CASE("npz_load_rows reads a row range from stored and deflated entries", "[cnpy][npz][ranged]") {
+    const std::string filename = "test_npz_rows.npz";
+    const size_t rows = 2000, cols = 16;
+    std::vector<double> data = make_rows(rows, cols);
+
+    for (bool compress : {false, true}) {
+        cnpy::npz_save(filename, "small", data.data(), {4, cols}, "w", compress);
+        cnpy::npz_save(filename, "big", data.data(), {rows, cols}, "a", compress);
+
+        cnpy::NpyArray head = cnpy::npz_load_rows(filename, "big", 0, 10);
+        REQUIRE(head.shape == std::vector<size_t>{10, cols});
+        REQUIRE(head.as_vec<double>() == std::vector<double>(data.begin(), data.begin() + 10 * cols));
+
+        cnpy::NpyArray mid = cnpy::npz_load_rows(filename, "big", 1500, 1510);
+        REQUIRE(mid.as_vec<double>() ==
+                std::vector<double>(data.begin() + 1500 * cols, data.begin() + 1510 * cols));
+
+        cnpy::NpyArray clamped = cnpy::npz_load_rows(filename, "big", 1995, 5000);
+        REQUIRE(clamped.shape == std::vector<size_t>{5, cols});
+    }
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("NpzSeekIndex resumes inflation from access points", "[cnpy][npz][ranged]") {
+    const std::string filename = "test_npz_seek_index.npz";
+    const size_t rows = 20000, cols = 8;
+    std::vector<double> data = make_rows(rows, cols);
+    cnpy::npz_save(filename, "other", data.data(), {100, cols}, "w", true);
+    cnpy::npz_save(filename, "big", data.data(), {rows, cols}, "a", true);
+
+    cnpy::NpzSeekIndex index(filename, "big", 64 * 1024);
+    REQUIRE(index.shape() == std::vector<size_t>{rows, cols});
+    REQUIRE(index.num_points() > 4);
+
+    for (size_t begin : {0, 1, 7777, 12345, 19990}) {
+        cnpy::NpyArray arr = index.load_rows(begin, begin + 10);
+        REQUIRE(arr.as_vec<double>() ==
+                std::vector<double>(data.begin() + begin * cols, data.begin() + (begin + 10) * cols));
+    }
+
+    double value;
+    index.read((rows * cols - 1) * sizeof(double), &value, sizeof(double));
+    REQUIRE(value == data.back());
+    REQUIRE_THROWS_AS(index.read(rows * cols * sizeof(double), &value, sizeof(double)), std::runtime_error);
+
+    cnpy::npz_save(filename, "stored", data.data(), {rows, cols}, "a", false);
+    cnpy::NpzSeekIndex stored(filename, "stored");
+    REQUIRE(stored.load_rows(5, 6).as_vec<double>() ==
+            std::vector<double>(data.begin() + 5 * cols, data.begin() + 6 * cols));
+    std::remove(filename.c_str());
+}
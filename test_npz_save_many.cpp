@@ -0,0 +1,63 @@
+// test_npz_save_many.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST_CASE("npz_save_many writes every entry and one central directory", "[cnpy][npz_save_many]") {
+    const std::string filename = "test_npz_save_many.npz";
+    std::vector<std::vector<double>> arrays(30);
+    std::vector<cnpy::SaveItem> items;
+    for (size_t f = 0; f < arrays.size(); ++f) {
+        arrays[f].resize(f % 8 == 0 ? 50000 : 2 * f + 2);
+        for (size_t i = 0; i < arrays[f].size(); ++i) arrays[f][i] = f * 0.5 + (i % 17);
+        items.push_back(cnpy::SaveItem("layer" + std::to_string(f) + "/weights", arrays[f].data(),
+                                       {arrays[f].size() / 2, 2}));
+    }
+    std::vector<uint16_t> be = {1, 2, 65535};
+    items.push_back(cnpy::SaveItem("big_endian", be.data(), {3}, cnpy::DType('u', 2, '>')));
+    items.push_back(cnpy::SaveItem("empty", be.data(), {0, 4}));
+
+    for (bool compress : {false, true}) {
+        cnpy::SaveManyOptions options;
+        options.threads = 4;
+        options.sync = compress ? cnpy::SyncPolicy::AtEnd : cnpy::SyncPolicy::None;
+        cnpy::SaveManyStats stats = cnpy::npz_save_many(filename, items, compress, options);
+        REQUIRE(stats.files == items.size());
+
+        cnpy::npz_t npz = cnpy::npz_load(filename);
+        REQUIRE(npz.size() == items.size());
+        for (size_t f = 0; f < arrays.size(); ++f) {
+            cnpy::NpyArray& arr = npz["layer" + std::to_string(f) + "/weights"];
+            REQUIRE(arr.shape == cnpy::Shape({arrays[f].size() / 2, 2}));
+            REQUIRE(arr.as_vec<double>() == arrays[f]);
+        }
+        REQUIRE(npz["big_endian"].dtype == cnpy::DType::of<uint16_t>());
+        REQUIRE(npz["big_endian"].as_vec<uint16_t>() == be);
+        REQUIRE(npz["empty"].num_vals == 0);
+
+        // the archive can be added to like any other
+        cnpy::npz_save(filename, "extra", be.data(), {3}, "a");
+        REQUIRE(cnpy::npz_load(filename, "extra").as_vec<uint16_t>() == be);
+        REQUIRE(cnpy::npz_load(filename, "layer9/weights").as_vec<double>() == arrays[9]);
+    }
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("npz_save_many rejects duplicate names and handles empty lists", "[cnpy][npz_save_many]") {
+    const std::string filename = "test_npz_save_many_dup.npz";
+    double x = 1;
+    std::vector<cnpy::SaveItem> items = {cnpy::SaveItem("a", &x, {1}), cnpy::SaveItem("a", &x, {1})};
+    REQUIRE_THROWS(cnpy::npz_save_many(filename, items));
+
+    REQUIRE(cnpy::npz_save_many(filename, std::vector<cnpy::SaveItem>()).files == 0);
+    // just the end of central directory record
+    FILE* fp = fopen(filename.c_str(), "rb");
+    REQUIRE(fp);
+    fseek(fp, 0, SEEK_END);
+    REQUIRE(ftell(fp) == 22);
+    fclose(fp);
+    std::remove(filename.c_str());
+}
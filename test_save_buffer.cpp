@@ -0,0 +1,99 @@
+// test_save_buffer.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static std::vector<char> read_file(const std::string& fname) {
+    std::ifstream in(fname, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static cnpy::ByteSink append_to(std::vector<char>& out) {
+    return [&out](const void* p, size_t n) {
+        out.insert(out.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+    };
+}
+
+static std::vector<char> gather(const std::vector<cnpy::Segment>& segments) {
+    std::vector<char> out;
+    for (const cnpy::Segment& seg : segments)
+        out.insert(out.end(), static_cast<const char*>(seg.data), static_cast<const char*>(seg.data) + seg.size);
+    return out;
+}
+
+TEST_CASE("npy images in memory match npy_save", "[save_buffer]") {
+    std::vector<double> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i * 0.25;
+    cnpy::DType dtype = cnpy::DType::of<double>();
+    cnpy::npy_save("test_save_buffer.npy", data.data(), {10, 100}, dtype, "w");
+    std::vector<char> file = read_file("test_save_buffer.npy");
+    std::remove("test_save_buffer.npy");
+
+    std::vector<char> image = cnpy::npy_save_buffer(data.data(), {10, 100}, dtype);
+    REQUIRE(image == file);
+    REQUIRE(image.capacity() == image.size());
+
+    std::vector<char> sunk;
+    cnpy::npy_save_sink(append_to(sunk), data.data(), {10, 100}, dtype);
+    REQUIRE(sunk == file);
+
+    // the header in storage, then the data where it is
+    std::vector<char> storage;
+    std::vector<cnpy::Segment> segments = cnpy::npy_save_segments(data.data(), {10, 100}, dtype, storage);
+    REQUIRE(segments.size() == 2);
+    REQUIRE(segments[0].data == storage.data());
+    REQUIRE(segments[1].data == data.data());
+    REQUIRE(gather(segments) == file);
+}
+
+TEST_CASE("byte-swapped npy segments are copied into storage", "[save_buffer]") {
+    std::vector<int> data = {1, 2, 3, 0x01020304};
+    cnpy::DType swapped = cnpy::DType::of<int>();
+    swapped.byte_order = swapped.byte_order == '<' ? '>' : '<';
+    std::vector<char> storage;
+    std::vector<cnpy::Segment> segments = cnpy::npy_save_segments(data.data(), {4}, swapped, storage);
+    REQUIRE(segments.size() == 1);
+    REQUIRE(storage.size() == segments[0].size);
+
+    std::vector<char> image = gather(segments);
+    REQUIRE(image == cnpy::npy_save_buffer(data.data(), {4}, swapped));
+    cnpy::NpyArray arr = cnpy::npy_load_buffer(image.data(), image.size());
+    REQUIRE(arr.as_vec<int>() == data);
+}
+
+TEST_CASE("npz images in memory match npz_save_many", "[save_buffer]") {
+    std::vector<float> a(4096);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = static_cast<float>(i % 17);
+    std::vector<int> b(300, 7);
+    std::vector<cnpy::SaveItem> items = {cnpy::SaveItem("a", a.data(), {64, 64}), cnpy::SaveItem("b", b.data(), {300})};
+    for (bool compress : {false, true}) {
+        cnpy::npz_save_many("test_save_buffer.npz", items, compress);
+        std::vector<char> file = read_file("test_save_buffer.npz");
+        std::remove("test_save_buffer.npz");
+
+        std::vector<char> image = cnpy::npz_save_buffer(items, compress);
+        REQUIRE(image == file);
+        REQUIRE(image.capacity() == image.size());
+
+        std::vector<char> sunk;
+        cnpy::npz_save_sink(append_to(sunk), items, compress);
+        REQUIRE(sunk == file);
+
+        std::vector<char> storage;
+        std::vector<cnpy::Segment> segments = cnpy::npz_save_segments(items, storage, compress);
+        REQUIRE(gather(segments) == file);
+        bool references_a = false;
+        for (const cnpy::Segment& seg : segments) references_a = references_a || seg.data == a.data();
+        REQUIRE(references_a == !compress);
+        REQUIRE(storage.size() == file.size() - (compress ? 0 : a.size() * sizeof(float) + b.size() * sizeof(int)));
+
+        cnpy::npz_t arrays = cnpy::npz_load_buffer(image.data(), image.size());
+        REQUIRE(arrays["a"].as_vec<float>() == a);
+        REQUIRE(arrays["b"].as_vec<int>() == b);
+    }
+    REQUIRE_THROWS_AS(cnpy::npz_save_buffer({items[0], items[0]}), std::runtime_error);
+}
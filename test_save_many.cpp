@@ -0,0 +1,66 @@
+// test_save_many.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("npy_save_many writes every item to its own file", "[cnpy][save_many]") {
+    std::vector<std::vector<float>> arrays(40);
+    std::vector<cnpy::SaveItem> items;
+    size_t bytes = 0;
+    for (size_t f = 0; f < arrays.size(); ++f) {
+        arrays[f].resize(f % 7 == 0 ? 99999 : 3 * f + 3);
+        for (size_t i = 0; i < arrays[f].size(); ++i) arrays[f][i] = f + i * 0.25f;
+        items.push_back(cnpy::SaveItem("test_save_many_" + std::to_string(f) + ".npy", arrays[f].data(),
+                                       {arrays[f].size() / 3, 3}));
+        bytes += arrays[f].size() * sizeof(float);
+    }
+    // one big-endian item goes through the byte-swapping path
+    std::vector<int16_t> shorts = {1, -2, 300};
+    items.push_back(cnpy::SaveItem("test_save_many_be.npy", shorts.data(), {3}, cnpy::DType('i', 2, '>')));
+    bytes += 6;
+
+    for (cnpy::SyncPolicy sync : {cnpy::SyncPolicy::None, cnpy::SyncPolicy::EachFile, cnpy::SyncPolicy::AtEnd}) {
+        cnpy::SaveManyOptions options;
+        options.threads = 4;
+        options.sync = sync;
+        cnpy::SaveManyStats stats = cnpy::npy_save_many(items, options);
+        REQUIRE(stats.files == items.size());
+        REQUIRE(stats.bytes == bytes);
+        REQUIRE(stats.seconds >= 0);
+
+        for (size_t f = 0; f < arrays.size(); ++f) {
+            cnpy::NpyArray arr = cnpy::npy_load(items[f].fname);
+            REQUIRE(arr.shape == cnpy::Shape({arrays[f].size() / 3, 3}));
+            REQUIRE(arr.as_vec<float>() == arrays[f]);
+        }
+        cnpy::NpyArray be = cnpy::npy_load("test_save_many_be.npy");
+        REQUIRE(be.dtype == cnpy::DType::of<int16_t>());
+        REQUIRE(be.as_vec<int16_t>() == shorts);
+    }
+    for (const cnpy::SaveItem& item : items) std::remove(item.fname.c_str());
+    REQUIRE(cnpy::npy_save_many(std::vector<cnpy::SaveItem>()).files == 0);
+}
+
+TEST_CASE("npy_save_many writes the other items when one fails", "[cnpy][save_many]") {
+    std::vector<double> data = {1, 2, 3};
+    std::vector<cnpy::SaveItem> items = {
+        cnpy::SaveItem("test_save_many_a.npy", data.data(), {3}),
+        cnpy::SaveItem("no_such_directory/test_save_many.npy", data.data(), {3}),
+        cnpy::SaveItem("test_save_many_b.npy", data.data(), {3}),
+    };
+    std::string message;
+    try {
+        cnpy::npy_save_many(items);
+    } catch (const std::runtime_error& e) {
+        message = e.what();
+    }
+    REQUIRE(message.find("no_such_directory") != std::string::npos);
+    REQUIRE(cnpy::npy_load("test_save_many_a.npy").as_vec<double>() == data);
+    REQUIRE(cnpy::npy_load("test_save_many_b.npy").as_vec<double>() == data);
+    std::remove("test_save_many_a.npy");
+    std::remove("test_save_many_b.npy");
+}
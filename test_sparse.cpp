@@ -0,0 +1,92 @@
+// test_sparse.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST_CASE("CSR matrices save in the save_npz layout", "[cnpy][sparse]") {
+    const std::string filename = "test_sparse_csr.npz";
+    // [[1, 0, 2, 0], [0, 0, 0, 0], [0, 3, 0, 4]]
+    std::vector<double> data = {1, 2, 3, 4};
+    std::vector<int32_t> indices = {0, 2, 1, 3};
+    std::vector<int32_t> indptr = {0, 2, 2, 4};
+    cnpy::sparse_save(filename, cnpy::SparseMatrix::csr(3, 4, data.data(), indices.data(), indptr.data()));
+
+    // the raw entries are what scipy.sparse.load_npz expects
+    cnpy::npz_t npz = cnpy::npz_load(filename);
+    REQUIRE(npz.size() == 5);
+    REQUIRE(npz["format"].shape.empty());
+    REQUIRE(npz["format"].as_strings()[0] == "csr");
+    REQUIRE(npz["shape"].as_vec<int64_t>() == std::vector<int64_t>({3, 4}));
+    REQUIRE(npz["indptr"].dtype == cnpy::DType::of<int32_t>());
+
+    cnpy::SparseMatrix m = cnpy::sparse_load(filename);
+    REQUIRE(m.format == "csr");
+    REQUIRE(m.rows == 3);
+    REQUIRE(m.cols == 4);
+    REQUIRE(m.nnz() == 4);
+    REQUIRE(m.data.as_vec<double>() == data);
+    REQUIRE(cnpy::SparseMatrix::index_at(m.indices, 3) == 3);
+    REQUIRE(cnpy::SparseMatrix::index_at(m.indptr, 2) == 2);
+
+    // a CSC matrix is the transpose's CSR arrays
+    cnpy::sparse_save(filename, cnpy::SparseMatrix::csc(4, 3, data.data(), indices.data(), indptr.data()), false);
+    cnpy::SparseMatrix t = cnpy::sparse_load(filename);
+    REQUIRE(t.format == "csc");
+    REQUIRE(t.rows == 4);
+    REQUIRE(t.indptr.num_vals == 4);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("uncompressed sparse files with int64 indices are memory-mapped", "[cnpy][sparse]") {
+    const std::string filename = "test_sparse_coo.npz";
+    const size_t nnz = 10000;
+    std::vector<float> data(nnz);
+    std::vector<int64_t> row(nnz), col(nnz);
+    for (size_t i = 0; i < nnz; ++i) {
+        data[i] = i * 0.5f;
+        row[i] = static_cast<int64_t>(i) * 300000;
+        col[i] = static_cast<int64_t>(nnz - i);
+    }
+    size_t rows = static_cast<size_t>(3) << 31;
+    cnpy::sparse_save(filename, cnpy::SparseMatrix::coo(rows, nnz + 1, nnz, data.data(), row.data(), col.data()),
+                      false);
+
+    cnpy::SparseMatrix m = cnpy::sparse_load(filename, true);
+    REQUIRE(m.format == "coo");
+    REQUIRE(m.rows == rows);
+    REQUIRE(m.nnz() == nnz);
+    REQUIRE(m.row.mmap_file);
+    REQUIRE(m.col.mmap_file);
+    REQUIRE(m.row.dtype == cnpy::DType::of<int64_t>());
+    REQUIRE(cnpy::SparseMatrix::index_at(m.row, 9999) == 9999 * 300000LL);
+    REQUIRE(cnpy::SparseMatrix::index_at(m.col, 1) == 9999);
+    REQUIRE(m.data.checked_data<float>()[7] == 3.5f);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("inconsistent sparse matrices are rejected", "[cnpy][sparse]") {
+    const std::string filename = "test_sparse_bad.npz";
+    std::vector<double> data = {1, 2};
+    std::vector<int32_t> indices = {0, 1};
+    std::vector<int32_t> indptr = {1, 1, 2};
+    REQUIRE_THROWS(cnpy::sparse_save(filename, cnpy::SparseMatrix::csr(2, 2, data.data(), indices.data(),
+                                                                        indptr.data())));
+    std::vector<uint32_t> unsigned_indices = {0, 1};
+    std::vector<uint32_t> unsigned_indptr = {0, 1, 2};
+    REQUIRE_THROWS(cnpy::sparse_save(filename, cnpy::SparseMatrix::csr(2, 2, data.data(), unsigned_indices.data(),
+                                                                        unsigned_indptr.data())));
+
+    // a bsr matrix as scipy would save it
+    cnpy::npz_save(filename, "data", data.data(), {2, 1, 1}, "w");
+    cnpy::npz_save(filename, "format", std::vector<std::string>{"bsr"}, "a");
+    int64_t shape[2] = {2, 2};
+    cnpy::npz_save(filename, "shape", shape, {2}, "a");
+    REQUIRE_THROWS(cnpy::sparse_load(filename));
+
+    cnpy::npz_save(filename, "nothing", data.data(), {2}, "w");
+    REQUIRE_THROWS(cnpy::sparse_load(filename));
+    std::remove(filename.c_str());
+}
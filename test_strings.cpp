@@ -0,0 +1,71 @@
+// test_strings.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_CASE("byte strings save as 'S' and read back without copies", "[cnpy][strings]") {
+    const std::string filename = "test_strings_s.npy";
+    std::vector<std::string> labels = {"cat", "", "giraffe", "ox"};
+    cnpy::npy_save(filename, labels);
+
+    cnpy::NpyArray arr = cnpy::npy_load(filename);
+    REQUIRE(arr.dtype.str() == "|S7");
+    REQUIRE(arr.shape == cnpy::Shape{4});
+    REQUIRE(arr.as_strings() == labels);
+    REQUIRE(arr.bytes_at(2) == std::string("giraffe"));
+    REQUIRE(arr.bytes_at(1).empty());
+    REQUIRE_THROWS(arr.unicode_at(0));
+
+    cnpy::NpyArray mapped = cnpy::npy_load(filename, true);
+    cnpy::BytesRef ref = mapped.bytes_at(3);
+    REQUIRE(ref.data() == mapped.data<char>() + 3 * 7);
+    REQUIRE(ref.str() == "ox");
+
+    // appending needs the same width
+    cnpy::npy_save(filename, std::vector<std::string>{"emu", "yak"}, "a");
+    REQUIRE_THROWS(cnpy::npy_save(filename, std::vector<std::string>{"platypus"}, "a"));
+    REQUIRE(cnpy::npy_load(filename).as_strings().back() == "yak");
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("unicode strings save as UCS-4 'U'", "[cnpy][strings]") {
+    const std::string filename = "test_strings_u.npz";
+    std::vector<std::string> names = {"h\xc3\xa9llo", "\xe6\x97\xa5\xe6\x9c\xac", "a\xf0\x9f\x98\x80", "plain"};
+    cnpy::npz_save(filename, "names", names, "w", true, 'U');
+    cnpy::npz_save(filename, "ids", std::vector<std::string>{"A1", "B2"}, "a");
+
+    cnpy::npz_t npz = cnpy::npz_load(filename);
+    REQUIRE(npz["names"].dtype.str() == "<U5");
+    REQUIRE(npz["names"].word_size == 20);
+    REQUIRE(npz["names"].unicode_at(1) == std::u32string(U"日本"));
+    REQUIRE(npz["names"].unicode_at(2).size() == 2);
+    REQUIRE(npz["names"].as_strings() == names);
+    REQUIRE(npz["ids"].as_strings() == std::vector<std::string>({"A1", "B2"}));
+
+    REQUIRE_THROWS(cnpy::npz_save(filename, "bad", std::vector<std::string>{"\xff"}, "a", false, 'U'));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("big-endian and 0-d string arrays", "[cnpy][strings]") {
+    const std::string filename = "test_strings_be.npy";
+    std::vector<char32_t> be = {U'a', U'b', 0};
+    cnpy::npy_save(filename, be.data(), cnpy::Shape{1}, cnpy::DType('U', 12, '>'));
+
+    cnpy::NpyArray mapped = cnpy::npy_load(filename, true);
+    REQUIRE(mapped.dtype.str() == ">U3");
+    REQUIRE_THROWS(mapped.unicode_at(0));
+    REQUIRE(mapped.as_strings()[0] == "ab");
+    REQUIRE(cnpy::npy_load(filename).unicode_at(0) == std::u32string(U"ab"));
+
+    // a numpy scalar string, np.array(b'abc')
+    const char value[3] = {'a', 'b', 'c'};
+    cnpy::npy_save(filename, value, cnpy::Shape(), cnpy::DType('S', 3, '|'));
+    cnpy::NpyArray scalar = cnpy::npy_load(filename);
+    REQUIRE(scalar.shape.empty());
+    REQUIRE(scalar.as_strings() == std::vector<std::string>{"abc"});
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,152 @@
+// test_structured.cpp
+#include "cnpy.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    // write an .npy file with a hand-written header dict, as numpy would produce it
+    void write_npy(const std::string& fname, std::string dict, const std::vector<char>& data) {
+        dict += std::string(16 - (10 + dict.size() + 1) % 16, ' ') + "\n";
+        FILE* fp = fopen(fname.c_str(), "wb");
+        REQUIRE(fp);
+        fwrite("\x93NUMPY\x01\x00", 1, 8, fp);
+        uint16_t len = static_cast<uint16_t>(dict.size());
+        fwrite(&len, 2, 1, fp);
+        fwrite(dict.data(), 1, dict.size(), fp);
+        fwrite(data.data(), 1, data.size(), fp);
+        fclose(fp);
+    }
+
+    struct Particle {
+        float x;
+        int64_t id;
+        double v[3];
+    };
+} // namespace
+
+TEST_CASE("structured descrs are parsed into a field table", "[cnpy][structured]") {
+    const std::string filename = "test_structured_parse.npy";
+    std::vector<char> data(3 * 12);
+    for (int i = 0; i < 3; ++i) {
+        float x = i + 0.5f;
+        int64_t id = 100 + i;
+        memcpy(&data[i * 12], &x, 4);
+        memcpy(&data[i * 12 + 4], &id, 8);
+    }
+    write_npy(filename, "{'descr': [('x', '<f4'), ('id', '<i8')], 'fortran_order': False, 'shape': (3,), }", data);
+
+    for (bool use_mmap : {false, true}) {
+        cnpy::NpyArray arr = cnpy::npy_load(filename, use_mmap);
+        REQUIRE(arr.shape == cnpy::Shape{3});
+        REQUIRE(arr.dtype.is_structured());
+        REQUIRE(arr.word_size == 12);
+        REQUIRE(arr.dtype.fields->size() == 2);
+        REQUIRE(arr.dtype.field("id").offset == 4);
+        REQUIRE(arr.dtype.field("id").dtype == cnpy::DType::of<int64_t>());
+
+        cnpy::FieldView<float> x = arr.field<float>("x");
+        cnpy::FieldView<int64_t> id = arr.field<int64_t>("id");
+        REQUIRE(x.size() == 3);
+        REQUIRE(x.stride() == 12);
+        REQUIRE(x[2] == 2.5f);
+        REQUIRE(id[1] == 101);
+        REQUIRE_THROWS(arr.field<double>("x"));
+        REQUIRE_THROWS(arr.field<float>("y"));
+    }
+
+    // writes through an mmap view land in the file
+    {
+        cnpy::NpyArray mapped = cnpy::npy_load(filename, true);
+        mapped.field<int64_t>("id").set(0, -9);
+    }
+    REQUIRE(cnpy::npy_load(filename).field<int64_t>("id")[0] == -9);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("C++ structs save with a generated descr", "[cnpy][structured]") {
+    const std::string filename = "test_structured_save.npy";
+    cnpy::DType dtype = cnpy::DType::structured(
+        {CNPY_FIELD(Particle, x), CNPY_FIELD(Particle, id), CNPY_FIELD(Particle, v)}, sizeof(Particle));
+    REQUIRE(dtype.descr() == "[('x', '<f4'), ('', '|V4'), ('id', '<i8'), ('v', '<f8', (3,))]");
+
+    std::vector<Particle> ps(50);
+    for (size_t i = 0; i < ps.size(); ++i) {
+        ps[i].x = i * 2.0f;
+        ps[i].id = static_cast<int64_t>(i) * 1000;
+        for (int k = 0; k < 3; ++k) ps[i].v[k] = i + k * 0.25;
+    }
+    cnpy::npy_save(filename, ps.data(), {10, 5}, dtype);
+
+    cnpy::NpyArray arr = cnpy::npy_load(filename);
+    REQUIRE(arr.dtype == dtype);
+    REQUIRE(arr.shape == cnpy::Shape({10, 5}));
+    REQUIRE(memcmp(arr.data<char>(), ps.data(), ps.size() * sizeof(Particle)) == 0);
+
+    cnpy::FieldView<double> v = arr.field<double>("v");
+    REQUIRE(v.width() == 3);
+    REQUIRE(v.get(7, 2) == ps[7].v[2]);
+
+    cnpy::NpyArray ids = cnpy::gather_field(arr, "id");
+    REQUIRE(ids.shape == cnpy::Shape({10, 5}));
+    REQUIRE(ids.checked_data<int64_t>()[49] == 49000);
+    cnpy::NpyArray vs = cnpy::gather_field(arr, "v");
+    REQUIRE(vs.shape == cnpy::Shape({10, 5, 3}));
+    REQUIRE(vs.checked_data<double>()[3 * 11 + 1] == ps[11].v[1]);
+    cnpy::NpyArray xs = cnpy::gather_field(arr, "x");
+    for (size_t i = 0; i < ps.size(); ++i) {
+        REQUIRE(xs.checked_data<float>()[i] == ps[i].x);
+        REQUIRE(ids.checked_data<int64_t>()[i] == ps[i].id);
+    }
+
+    // appending needs the same record layout
+    cnpy::npy_save(filename, ps.data(), {1, 5}, dtype, "a");
+    REQUIRE(cnpy::npy_load(filename).shape == cnpy::Shape({11, 5}));
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("nested and big-endian structured fields", "[cnpy][structured]") {
+    const std::string filename = "test_structured_nested.npz";
+    std::vector<char> record(2 + 4 + 2 * 8);
+    record[0] = 7;
+    record[1] = -1;
+    // big-endian int32 0x01020304
+    record[2] = 1, record[3] = 2, record[4] = 3, record[5] = 4;
+    double pos[2] = {1.5, -2.5};
+    memcpy(&record[6], pos, 16);
+    std::vector<char> data;
+    for (int i = 0; i < 4; ++i) data.insert(data.end(), record.begin(), record.end());
+
+    const std::string npy = "test_structured_nested.npy";
+    write_npy(npy,
+              "{'descr': [('tag', '|i1'), ('', '|V1'), ('n', '>i4'), ('p', [('a', '<f8'), ('b', '<f8')])], "
+              "'fortran_order': False, 'shape': (4,), }",
+              data);
+    cnpy::NpyArray mapped = cnpy::npy_load(npy, true);
+    REQUIRE(mapped.dtype.size == 22);
+    REQUIRE_FALSE(mapped.dtype.is_native());
+    REQUIRE(mapped.dtype.field("p").dtype.is_structured());
+    REQUIRE(mapped.dtype.field("p").offset == 6);
+    REQUIRE_THROWS(mapped.field<int32_t>("n"));
+    REQUIRE(cnpy::gather_field(mapped, "n").checked_data<int32_t>()[3] == 0x01020304);
+
+    cnpy::NpyArray loaded = cnpy::npy_load(npy);
+    REQUIRE(loaded.dtype.is_native());
+    REQUIRE(loaded.field<int32_t>("n")[1] == 0x01020304);
+    REQUIRE(loaded.field<int8_t>("tag")[0] == 7);
+    cnpy::NpyArray p = cnpy::gather_field(loaded, "p");
+    REQUIRE(p.field<double>("b")[2] == -2.5);
+
+    // saving the big-endian layout swaps only the '>' field back
+    cnpy::npz_save(filename, "rec", loaded.data<char>(), loaded.shape, mapped.dtype, "w", true);
+    cnpy::NpyArray again = cnpy::npz_load(filename, "rec");
+    REQUIRE(again.field<int32_t>("n")[0] == 0x01020304);
+    REQUIRE_THROWS(again.field<double>("a"));
+    REQUIRE(cnpy::gather_field(again, "p").field<double>("a")[3] == 1.5);
+    std::remove(npy.c_str());
+    std::remove(filename.c_str());
+}